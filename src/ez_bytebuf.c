@@ -1,19 +1,32 @@
 #include "ez_bytebuf.h"
 
+#include "ez_log.h"
 #include "ez_malloc.h"
 
+#include <errno.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define BYTEBUF_GROW_MIN 64
+/* r/w 是 32 位的, EZ_ALIGN 向上取整后也不能超过 UINT32_MAX */
+#define BYTEBUF_CAP_MAX (UINT32_MAX & ~(EZ_ALIGNVOID - 1))
+
 bytebuf_t* new_bytebuf(size_t size)
 {
     bytebuf_t* b = ez_malloc(sizeof(bytebuf_t));
     b->r = b->w = 0;
     b->data = ez_malloc(EZ_ALIGN(size));
     b->cap = EZ_ALIGN(size);
+    b->flags = 0;
     return b;
 }
 
 void free_bytebuf(bytebuf_t* b)
 {
-    ez_free(b->data);
+    if (b->flags & BYTEBUF_F_MIRROR)
+        munmap(b->data, b->cap * 2);
+    else
+        ez_free(b->data);
     ez_free(b);
 }
 
@@ -25,126 +38,226 @@ void bytebuf_reset(bytebuf_t* b)
 
 void bytebuf_resize(bytebuf_t* b, size_t size)
 {
-    void* data = ez_realloc(b->data, EZ_ALIGN(size));
+    void* data;
+
+    if (b->flags & (BYTEBUF_F_FIXED | BYTEBUF_F_RING))
+        return;
+    if (size < b->w)
+        size = b->w;
+    if (size > BYTEBUF_CAP_MAX)
+        size = BYTEBUF_CAP_MAX;
+    data = ez_realloc(b->data, EZ_ALIGN(size));
     b->data = (uint8_t*)data;
     b->cap = EZ_ALIGN(size);
 }
 
-void bytebuf_write_int8(bytebuf_t* b, int8_t val)
-{
-    b->data[b->w] = val;
-    b->w++;
-}
+static void bytebuf_ring_fold(bytebuf_t* b);
 
-void bytebuf_read_int8(bytebuf_t* b, int8_t* val)
+int bytebuf_grow(bytebuf_t* b, size_t n)
 {
-    *val = b->data[b->r];
-    b->r++;
-}
+    size_t need = (size_t)b->w + n, cap;
 
-// big Endian 写入
-void bytebuf_write_int16(bytebuf_t* b, int16_t val)
-{
-    b->data[b->w + 0] = (uint8_t)((val >> 8) & 0xff);
-    b->data[b->w + 1] = (uint8_t)((val)&0xff);
-    b->w += 2;
+    if (b->flags & BYTEBUF_F_MIRROR) {
+        bytebuf_ring_fold(b);
+        return bytebuf_writeable_size(b) >= n ? 0 : -1;
+    }
+
+    if ((b->flags & (BYTEBUF_F_FIXED | BYTEBUF_F_RING)) || need > BYTEBUF_CAP_MAX)
+        return -1;
+    if (need <= b->cap)
+        return 0;
+    // 小的时候翻倍, 摊还 O(1); 大了以后按固定增量, 避免一次多占一倍内存.
+    if (need <= BYTEBUF_GROW_MAX) {
+        for (cap = BYTEBUF_GROW_MIN; cap < need; cap <<= 1)
+            ;
+    } else {
+        cap = (need + BYTEBUF_GROW_MAX - 1) / BYTEBUF_GROW_MAX * BYTEBUF_GROW_MAX;
+    }
+    if (cap > BYTEBUF_CAP_MAX)
+        cap = BYTEBUF_CAP_MAX;
+    bytebuf_resize(b, cap);
+    return 0;
 }
 
-void bytebuf_write_int32(bytebuf_t* b, int32_t val)
+void bytebuf_discard_read_bytes(bytebuf_t* b)
 {
-    b->data[b->w + 0] = (uint8_t)((val >> 24) & 0xff);
-    b->data[b->w + 1] = (uint8_t)((val >> 16) & 0xff);
-    b->data[b->w + 2] = (uint8_t)((val >> 8) & 0xff);
-    b->data[b->w + 3] = (uint8_t)((val)&0xff);
-    b->w += 4;
+    size_t left = bytebuf_readable_size(b);
+
+    if (b->r == 0 || (b->flags & BYTEBUF_F_RING))
+        return;
+    if (left > 0)
+        memmove(b->data, bytebuf_reader_pos(b), left);
+    b->r = 0;
+    b->w = (uint32_t)left;
 }
 
-void bytebuf_write_int64(bytebuf_t* b, int64_t val)
+void bytebuf_discard_some_read_bytes(bytebuf_t* b, size_t threshold)
 {
-    b->data[b->w + 0] = (uint8_t)((val >> 56) & 0xff);
-    b->data[b->w + 1] = (uint8_t)((val >> 48) & 0xff);
-    b->data[b->w + 2] = (uint8_t)((val >> 40) & 0xff);
-    b->data[b->w + 3] = (uint8_t)((val >> 32) & 0xff);
-    b->data[b->w + 4] = (uint8_t)((val >> 24) & 0xff);
-    b->data[b->w + 5] = (uint8_t)((val >> 16) & 0xff);
-    b->data[b->w + 6] = (uint8_t)((val >> 8) & 0xff);
-    b->data[b->w + 7] = (uint8_t)((val)&0xff);
-    b->w += 8;
+    if (!bytebuf_is_readable(b))
+        b->r = b->w = 0;
+    else if (b->r >= threshold)
+        bytebuf_discard_read_bytes(b);
 }
 
-void bytebuf_read_int64(bytebuf_t* b, int64_t* val)
+// =====================================================================
+// 环形
+bytebuf_t* new_bytebuf_ring(size_t size)
 {
-    *val = (int64_t)(b->data[b->r + 0]) << 56 |
-           (int64_t)(b->data[b->r + 1]) << 48 |
-           (int64_t)(b->data[b->r + 2]) << 40 |
-           (int64_t)(b->data[b->r + 3]) << 32 |
-           (int64_t)(b->data[b->r + 4]) << 24 |
-           (int64_t)(b->data[b->r + 5]) << 16 |
-           (int64_t)(b->data[b->r + 6]) <<  8 |
-           (int64_t)(b->data[b->r + 7]);
-    b->r += 8;
+    bytebuf_t* b = new_bytebuf(size);
+    b->flags = BYTEBUF_F_RING;
+    return b;
 }
 
-void bytebuf_read_int32(bytebuf_t* b, int32_t* val)
+bytebuf_t* new_bytebuf_mirror(size_t size)
 {
-    *val = (int32_t)(b->data[b->r + 0]) << 24 |
-           (int32_t)(b->data[b->r + 1]) << 16 |
-           (int32_t)(b->data[b->r + 2]) <<  8 |
-           (int32_t)(b->data[b->r + 3]);
-    b->r += 4;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    bytebuf_t* b;
+    uint8_t* base;
+    void *lo, *hi;
+    int fd;
+
+    // w 最大到 2 * cap, 要放得进 32 位.
+    size = (size + page - 1) / page * page;
+    if (size == 0 || size > UINT32_MAX / 2)
+        return NULL;
+    fd = memfd_create("ez_bytebuf", MFD_CLOEXEC);
+    if (fd == -1 || ftruncate(fd, (off_t)size) == -1) {
+        log_error("memfd bytebuf: %s", strerror(errno));
+        if (fd != -1)
+            close(fd);
+        return NULL;
+    }
+    // 先占住 2 * size 的地址, 再把 memfd 覆盖映射到前后两半.
+    base = mmap(NULL, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        log_error("mmap bytebuf: %s", strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    lo = mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    hi = mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    // 映射会保持 memfd 的引用.
+    close(fd);
+    if (lo == MAP_FAILED || hi == MAP_FAILED) {
+        log_error("mmap bytebuf: %s", strerror(errno));
+        munmap(base, size * 2);
+        return NULL;
+    }
+
+    b = ez_malloc(sizeof(bytebuf_t));
+    b->r = b->w = 0;
+    b->data = base;
+    b->cap = size;
+    b->flags = BYTEBUF_F_RING | BYTEBUF_F_MIRROR;
+    return b;
 }
 
-void bytebuf_read_int16(bytebuf_t* b, int16_t* val)
+// 解析器直接推进 r 时可能越过 cap.
+static void bytebuf_ring_fold(bytebuf_t* b)
 {
-    *val = (int16_t)(b->data[b->r + 0]) << 8 |
-           (int16_t)(b->data[b->r + 1]);
-    b->r += 2;
+    if (b->r >= b->cap) {
+        b->r -= (uint32_t)b->cap;
+        b->w -= (uint32_t)b->cap;
+    }
 }
 
-// Little Endian 写入
-void bytebuf_write_int16_le(bytebuf_t* b, int16_t val)
+int bytebuf_ring_readable_iov(bytebuf_t* b, struct iovec iov[2])
 {
-    b->data[b->w + 1] = (uint8_t)((val >> 8) & 0xff);
-    b->data[b->w + 0] = (uint8_t)((val     ) & 0xff);
-    b->w += 2;
+    size_t n = b->w - b->r, first = b->cap - b->r;
+
+    if (n == 0)
+        return 0;
+    iov[0].iov_base = b->data + b->r;
+    if (n <= first || (b->flags & BYTEBUF_F_MIRROR)) {
+        iov[0].iov_len = n;
+        return 1;
+    }
+    iov[0].iov_len = first;
+    iov[1].iov_base = b->data;
+    iov[1].iov_len = n - first;
+    return 2;
 }
 
-void bytebuf_read_int16_le(bytebuf_t* b, int16_t* val)
+int bytebuf_ring_writeable_iov(bytebuf_t* b, struct iovec iov[2])
 {
-    *val = (int16_t)(b->data[b->r + 1]) << 8 | (int16_t)(b->data[b->r + 0]);
-    b->r += 2;
+    size_t n, pos, first;
+
+    bytebuf_ring_fold(b);
+    n = bytebuf_ring_writeable_size(b);
+    if (n == 0)
+        return 0;
+    if (b->flags & BYTEBUF_F_MIRROR) {
+        iov[0].iov_base = b->data + b->w;
+        iov[0].iov_len = n;
+        return 1;
+    }
+    // w 在 [r, r + cap] 内, 超过 cap 的部分回绕到开头.
+    pos = b->w < b->cap ? b->w : b->w - b->cap;
+    first = b->cap - pos;
+    iov[0].iov_base = b->data + pos;
+    if (n <= first) {
+        iov[0].iov_len = n;
+        return 1;
+    }
+    iov[0].iov_len = first;
+    iov[1].iov_base = b->data;
+    iov[1].iov_len = n - first;
+    return 2;
 }
 
-void bytebuf_write_int32_le(bytebuf_t* b, int32_t val)
+void bytebuf_ring_produce(bytebuf_t* b, size_t n)
 {
-    b->data[b->w + 3] = (uint8_t)((val >> 24) & 0xff);
-    b->data[b->w + 2] = (uint8_t)((val >> 16) & 0xff);
-    b->data[b->w + 1] = (uint8_t)((val >>  8) & 0xff);
-    b->data[b->w + 0] = (uint8_t)((val      ) & 0xff);
-    b->w += 4;
+    b->w += (uint32_t)n;
 }
 
-void bytebuf_read_int32_le(bytebuf_t* b, int32_t* val)
+void bytebuf_ring_consume(bytebuf_t* b, size_t n)
 {
-    *val = (int32_t)(b->data[b->r + 3]) << 24 | (int32_t)(b->data[b->r + 2]) << 16 | (int32_t)(b->data[b->r + 1]) << 8 | (int32_t)(b->data[b->r + 0]);
-    b->r += 4;
+    b->r += (uint32_t)n;
+    if (b->r == b->w) {
+        // 读空时回到开头, 之后的读写尽量只有一段.
+        b->r = b->w = 0;
+    } else if (b->r >= b->cap) {
+        b->r -= (uint32_t)b->cap;
+        b->w -= (uint32_t)b->cap;
+    }
 }
 
-void bytebuf_write_int64_le(bytebuf_t* b, int64_t val)
+int bytebuf_ring_write(bytebuf_t* b, const void* data, size_t n)
 {
-    b->data[b->w + 7] = (uint8_t)((val >> 56) & 0xff);
-    b->data[b->w + 6] = (uint8_t)((val >> 48) & 0xff);
-    b->data[b->w + 5] = (uint8_t)((val >> 40) & 0xff);
-    b->data[b->w + 4] = (uint8_t)((val >> 32) & 0xff);
-    b->data[b->w + 3] = (uint8_t)((val >> 24) & 0xff);
-    b->data[b->w + 2] = (uint8_t)((val >> 16) & 0xff);
-    b->data[b->w + 1] = (uint8_t)((val >>  8) & 0xff);
-    b->data[b->w + 0] = (uint8_t)((val      ) & 0xff);
-    b->w += 8;
+    struct iovec iov[2];
+    int cnt;
+
+    if (bytebuf_ring_writeable_size(b) < n)
+        return -1;
+    cnt = bytebuf_ring_writeable_iov(b, iov);
+    if (cnt == 0)
+        return 0;
+    if (n <= iov[0].iov_len) {
+        memcpy(iov[0].iov_base, data, n);
+    } else {
+        memcpy(iov[0].iov_base, data, iov[0].iov_len);
+        memcpy(iov[1].iov_base, (const uint8_t*)data + iov[0].iov_len, n - iov[0].iov_len);
+    }
+    bytebuf_ring_produce(b, n);
+    return 0;
 }
 
-void bytebuf_read_int64_le(bytebuf_t* b, int64_t* val)
+int bytebuf_ring_read(bytebuf_t* b, void* out, size_t n)
 {
-    *val = (int64_t)(b->data[b->r + 7]) << 56 | (int64_t)(b->data[b->r + 6]) << 48 | (int64_t)(b->data[b->r + 5]) << 40 | (int64_t)(b->data[b->r + 4]) << 32 | (int64_t)(b->data[b->r + 3]) << 24 | (int64_t)(b->data[b->r + 2]) << 16 | (int64_t)(b->data[b->r + 1]) << 8 | (int64_t)(b->data[b->r + 0]);
-    b->r += 8;
+    struct iovec iov[2];
+    int cnt;
+
+    if (b->w - b->r < n)
+        return -1;
+    cnt = bytebuf_ring_readable_iov(b, iov);
+    if (cnt == 0)
+        return 0;
+    if (n <= iov[0].iov_len) {
+        memcpy(out, iov[0].iov_base, n);
+    } else {
+        memcpy(out, iov[0].iov_base, iov[0].iov_len);
+        memcpy((uint8_t*)out + iov[0].iov_len, iov[1].iov_base, n - iov[0].iov_len);
+    }
+    bytebuf_ring_consume(b, n);
+    return 0;
 }
@@ -3,14 +3,25 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
+#include <sys/uio.h>
 //
 // netty bytebuf
+// 写入前检查容量, 不够时自动扩容(BYTEBUF_F_FIXED 的除外); 读取前检查可读字节, 不够时返回 -1 且不移动 r.
+// 返回值 0/-1 与 ANET_OK/ANET_ERR 相同. 容量够时的路径全部内联.
 //
+#define BYTEBUF_F_FIXED 0x1 /* data 指向别处(批量缓冲, 内核缓冲池), 不能扩容 */
+#define BYTEBUF_F_RING 0x2 /* 环形, 见下面的 bytebuf_ring_* */
+#define BYTEBUF_F_MIRROR 0x4 /* 环形, 同一块 memfd 在虚拟地址上映射两遍, 见 new_bytebuf_mirror */
+
+#define BYTEBUF_GROW_MAX (4 * 1024 * 1024) /* 小于它时容量按 2 的幂增长, 之后每次增加这么多 */
+
 typedef struct bytebuf_s {
     uint32_t r; // reader index
     uint32_t w; // writer index
     size_t   cap;
     uint8_t *data;
+    uint32_t flags;
 } bytebuf_t;
 
 bytebuf_t* new_bytebuf(size_t size);
@@ -19,11 +30,46 @@ void free_bytebuf(bytebuf_t* b);
 
 void bytebuf_reset(bytebuf_t* b);
 
+// 把容量改为 size, 不会小于已写入的数据
 void bytebuf_resize(bytebuf_t* b, size_t size);
 
+// 扩容到至少还能写 n 字节, FIXED/RING 或超过 4G 时返回 -1; 镜像环形只折回下标, 空间够时返回 0
+int bytebuf_grow(bytebuf_t* b, size_t n);
+
+// 丢弃已读的字节, 未读的数据移到开头; 环形的不需要, 什么也不做
+void bytebuf_discard_read_bytes(bytebuf_t* b);
+
+// 已读超过 threshold 字节才前移, 避免每次读都 memmove; 没有未读数据时直接复位
+void bytebuf_discard_some_read_bytes(bytebuf_t* b, size_t threshold);
+
+// =====================================================================
+// 环形的 w 可以超过 cap(最多到 r + cap), 线性的读写只能用到 data + cap 为止的连续部分,
+// 越过末尾的要用 bytebuf_ring_*. 镜像环形的可读/可写区总是连续的, 可写到 r + cap,
+// 但 r 还没折回时不能超出 2 * cap 的映射; 写不下时 bytebuf_grow 先折回下标再看.
+static inline size_t bytebuf_linear_writeable_size(const bytebuf_t* b)
+{
+    size_t n, end;
+
+    if (__builtin_expect(b->flags & BYTEBUF_F_MIRROR, 0)) {
+        n = b->cap - (b->w - b->r);
+        end = 2 * b->cap - b->w;
+        return n < end ? n : end;
+    }
+    if (__builtin_expect(b->w >= b->cap, 0))
+        return 0;
+    return b->cap - b->w;
+}
+
+static inline size_t bytebuf_linear_readable_size(const bytebuf_t* b)
+{
+    if (__builtin_expect(b->w > b->cap, 0) && !(b->flags & BYTEBUF_F_MIRROR))
+        return b->cap - b->r;
+    return b->w - b->r;
+}
+
 // =====================================================================
 // 可以写入buf的字节数
-#define bytebuf_writeable_size(b) ((b)->cap - (b)->w)
+#define bytebuf_writeable_size(b) bytebuf_linear_writeable_size(b)
 
 // writer pos
 #define bytebuf_writer_pos(b)     ((uint8_t*)&((b)->data[(b)->w]))
@@ -32,13 +78,13 @@ void bytebuf_resize(bytebuf_t* b, size_t size);
 #define bytebuf_writer_index(b)   ((b)->w)
 
 // can write ?
-#define bytebuf_is_writeable(b)   ((b)->cap > (b)->w)
+#define bytebuf_is_writeable(b)   (bytebuf_writeable_size(b) > 0)
 
 #define bytebuf_reset_writer_index(b) ((b)->w = 0)
 
 // =====================================================================
 // 可以从buf中读取的字节数
-#define bytebuf_readable_size(b) ((b)->w - (b)->r)
+#define bytebuf_readable_size(b) bytebuf_linear_readable_size(b)
 
 // reader pos
 #define bytebuf_reader_pos(b)    ((uint8_t*)&((b)->data[(b)->r]))
@@ -52,37 +98,218 @@ void bytebuf_resize(bytebuf_t* b, size_t size);
 #define bytebuf_reset_reader_index(b) ((b)->r = 0)
 
 // =====================================================================
-// bytebuf 写入 int8_t
-void bytebuf_write_int8(bytebuf_t* b, int8_t val);
+// 确保还能写 n 字节
+static inline int bytebuf_ensure_writable(bytebuf_t* b, size_t n)
+{
+    if (__builtin_expect(bytebuf_writeable_size(b) >= n, 1))
+        return 0;
+    return bytebuf_grow(b, n);
+}
+
+static inline int bytebuf_write_bytes(bytebuf_t* b, const void* data, size_t n)
+{
+    if (bytebuf_ensure_writable(b, n) != 0)
+        return -1;
+    memcpy(bytebuf_writer_pos(b), data, n);
+    b->w += (uint32_t)n;
+    return 0;
+}
+
+static inline int bytebuf_read_bytes(bytebuf_t* b, void* out, size_t n)
+{
+    if (bytebuf_readable_size(b) < n)
+        return -1;
+    memcpy(out, bytebuf_reader_pos(b), n);
+    b->r += (uint32_t)n;
+    return 0;
+}
 
-void bytebuf_read_int8(bytebuf_t* b, int8_t *val);
+// =====================================================================
+// bytebuf 写入 int8_t
+static inline int bytebuf_write_int8(bytebuf_t* b, int8_t val)
+{
+    if (bytebuf_ensure_writable(b, 1) != 0)
+        return -1;
+    b->data[b->w++] = (uint8_t)val;
+    return 0;
+}
+
+static inline int bytebuf_read_int8(bytebuf_t* b, int8_t* val)
+{
+    if (bytebuf_readable_size(b) < 1)
+        return -1;
+    *val = (int8_t)b->data[b->r++];
+    return 0;
+}
 
 // big endian
-void bytebuf_write_int16(bytebuf_t* b, int16_t val);
-
-void bytebuf_write_int32(bytebuf_t* b, int32_t val);
-
-void bytebuf_write_int64(bytebuf_t* b, int64_t val);
-
-void bytebuf_read_int16(bytebuf_t* b, int16_t *val);
-
-void bytebuf_read_int32(bytebuf_t* b, int32_t *val);
-
-void bytebuf_read_int64(bytebuf_t* b, int64_t *val);
-
+static inline int bytebuf_write_int16(bytebuf_t* b, int16_t val)
+{
+    uint8_t* p;
+
+    if (bytebuf_ensure_writable(b, 2) != 0)
+        return -1;
+    p = bytebuf_writer_pos(b);
+    p[0] = (uint8_t)((uint16_t)val >> 8);
+    p[1] = (uint8_t)val;
+    b->w += 2;
+    return 0;
+}
+
+static inline int bytebuf_write_int32(bytebuf_t* b, int32_t val)
+{
+    uint8_t* p;
+
+    if (bytebuf_ensure_writable(b, 4) != 0)
+        return -1;
+    p = bytebuf_writer_pos(b);
+    p[0] = (uint8_t)((uint32_t)val >> 24);
+    p[1] = (uint8_t)((uint32_t)val >> 16);
+    p[2] = (uint8_t)((uint32_t)val >> 8);
+    p[3] = (uint8_t)val;
+    b->w += 4;
+    return 0;
+}
+
+static inline int bytebuf_write_int64(bytebuf_t* b, int64_t val)
+{
+    if (bytebuf_ensure_writable(b, 8) != 0)
+        return -1;
+    bytebuf_write_int32(b, (int32_t)((uint64_t)val >> 32));
+    bytebuf_write_int32(b, (int32_t)val);
+    return 0;
+}
+
+static inline int bytebuf_read_int16(bytebuf_t* b, int16_t* val)
+{
+    const uint8_t* p = bytebuf_reader_pos(b);
+
+    if (bytebuf_readable_size(b) < 2)
+        return -1;
+    *val = (int16_t)((uint16_t)p[0] << 8 | p[1]);
+    b->r += 2;
+    return 0;
+}
+
+static inline int bytebuf_read_int32(bytebuf_t* b, int32_t* val)
+{
+    const uint8_t* p = bytebuf_reader_pos(b);
+
+    if (bytebuf_readable_size(b) < 4)
+        return -1;
+    *val = (int32_t)((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]);
+    b->r += 4;
+    return 0;
+}
+
+static inline int bytebuf_read_int64(bytebuf_t* b, int64_t* val)
+{
+    const uint8_t* p = bytebuf_reader_pos(b);
+
+    if (bytebuf_readable_size(b) < 8)
+        return -1;
+    *val = (int64_t)((uint64_t)p[0] << 56 | (uint64_t)p[1] << 48 | (uint64_t)p[2] << 40 | (uint64_t)p[3] << 32
+        | (uint64_t)p[4] << 24 | (uint64_t)p[5] << 16 | (uint64_t)p[6] << 8 | p[7]);
+    b->r += 8;
+    return 0;
+}
 
 // little endian
-void bytebuf_write_int16_le(bytebuf_t* b, int16_t val);
-
-void bytebuf_write_int32_le(bytebuf_t* b, int32_t val);
-
-void bytebuf_write_int64_le(bytebuf_t* b, int64_t val);
-
-void bytebuf_read_int16_le(bytebuf_t* b, int16_t* val);
-
-void bytebuf_read_int32_le(bytebuf_t* b, int32_t* val);
-
-void bytebuf_read_int64_le(bytebuf_t* b, int64_t* val);
+static inline int bytebuf_write_int16_le(bytebuf_t* b, int16_t val)
+{
+    uint8_t* p;
+
+    if (bytebuf_ensure_writable(b, 2) != 0)
+        return -1;
+    p = bytebuf_writer_pos(b);
+    p[0] = (uint8_t)val;
+    p[1] = (uint8_t)((uint16_t)val >> 8);
+    b->w += 2;
+    return 0;
+}
+
+static inline int bytebuf_write_int32_le(bytebuf_t* b, int32_t val)
+{
+    uint8_t* p;
+
+    if (bytebuf_ensure_writable(b, 4) != 0)
+        return -1;
+    p = bytebuf_writer_pos(b);
+    p[0] = (uint8_t)val;
+    p[1] = (uint8_t)((uint32_t)val >> 8);
+    p[2] = (uint8_t)((uint32_t)val >> 16);
+    p[3] = (uint8_t)((uint32_t)val >> 24);
+    b->w += 4;
+    return 0;
+}
+
+static inline int bytebuf_write_int64_le(bytebuf_t* b, int64_t val)
+{
+    if (bytebuf_ensure_writable(b, 8) != 0)
+        return -1;
+    bytebuf_write_int32_le(b, (int32_t)val);
+    bytebuf_write_int32_le(b, (int32_t)((uint64_t)val >> 32));
+    return 0;
+}
+
+static inline int bytebuf_read_int16_le(bytebuf_t* b, int16_t* val)
+{
+    const uint8_t* p = bytebuf_reader_pos(b);
+
+    if (bytebuf_readable_size(b) < 2)
+        return -1;
+    *val = (int16_t)((uint16_t)p[1] << 8 | p[0]);
+    b->r += 2;
+    return 0;
+}
+
+static inline int bytebuf_read_int32_le(bytebuf_t* b, int32_t* val)
+{
+    const uint8_t* p = bytebuf_reader_pos(b);
+
+    if (bytebuf_readable_size(b) < 4)
+        return -1;
+    *val = (int32_t)((uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0]);
+    b->r += 4;
+    return 0;
+}
+
+static inline int bytebuf_read_int64_le(bytebuf_t* b, int64_t* val)
+{
+    const uint8_t* p = bytebuf_reader_pos(b);
+
+    if (bytebuf_readable_size(b) < 8)
+        return -1;
+    *val = (int64_t)((uint64_t)p[7] << 56 | (uint64_t)p[6] << 48 | (uint64_t)p[5] << 40 | (uint64_t)p[4] << 32
+        | (uint64_t)p[3] << 24 | (uint64_t)p[2] << 16 | (uint64_t)p[1] << 8 | p[0]);
+    b->r += 8;
+    return 0;
+}
 
+// =====================================================================
+// 环形模式: 容量固定, 下标回绕, 不需要前移, 每个连接的内存恒定.
+// 可读 [r, w) 和可写区都按 cap 取模, 最多两段, 用 readv/writev 一次读写
+// (ez_net_read_bf/ez_net_write_bf 会自动处理). r 始终小于 cap, w - r 不超过 cap.
+// 线性的 writer_pos/writeable_size 和上面的读写函数不适用, 只能用 bytebuf_ring_*.
+bytebuf_t* new_bytebuf_ring(size_t size);
+
+#define bytebuf_ring_writeable_size(b) ((b)->cap - ((b)->w - (b)->r))
+
+// 镜像环形: 容量按页对齐, data 后面紧跟同一块内存的第二个映射, data[i] 和 data[i + cap] 是同一个字节.
+// 可读/可写区域总是连续的一段, 除了 bytebuf_ring_* 之外, 解析器和编码器可以直接用线性的读写函数,
+// 写入不会扩容, 总量不超过 cap. r 超过 cap 的部分在下次取可写区或写不下时折回. 失败返回 NULL.
+bytebuf_t* new_bytebuf_mirror(size_t size);
+
+// 可读/可写区域, 返回段数(0-2), 镜像环形最多一段
+int bytebuf_ring_readable_iov(bytebuf_t* b, struct iovec iov[2]);
+int bytebuf_ring_writeable_iov(bytebuf_t* b, struct iovec iov[2]);
+
+// 数据写入可写区后推进 w / 读出后推进 r
+void bytebuf_ring_produce(bytebuf_t* b, size_t n);
+void bytebuf_ring_consume(bytebuf_t* b, size_t n);
+
+// 拷贝写入/读出, 空间或数据不够时返回 -1
+int bytebuf_ring_write(bytebuf_t* b, const void* data, size_t n);
+int bytebuf_ring_read(bytebuf_t* b, void* out, size_t n);
 
 #endif // EZ_BYTEBUF_H
@@ -0,0 +1,926 @@
+#include "ez_conn.h"
+
+#include "ez_list.h"
+#include "ez_log.h"
+#include "ez_macro.h"
+#include "ez_malloc.h"
+#include "ez_net.h"
+#include "ez_util.h"
+
+#include <errno.h>
+#include <string.h>
+
+#define CONN_F_IN_CALLBACK 0x1 /* 正在执行读回调, 写入只入队, 关闭延后 */
+#define CONN_F_CLOSE_PENDING 0x2 /* 回调返回后关闭 */
+#define CONN_F_CLOSE_AFTER_FLUSH 0x4 /* 输出写完后关闭 */
+#define CONN_F_CLOSED 0x8
+#define CONN_F_CORKED 0x10 /* conn_cork: 写入只入队 */
+#define CONN_F_ACTIVE 0x20 /* 上个 drain tick 之后有过读写 */
+
+#define CONN_FREE_CHUNK_MAX 1024
+#define CONN_INPUT_COMPACT 2 /* 可写空间不足 cap/2 时前移未读数据 */
+#define CONN_INPUT_SHRINK 4 /* 读空时超过初始大小 4 倍的缓冲缩回去 */
+
+/* 输出队列中的一块 */
+typedef struct conn_chunk_s {
+    list_head_t node;
+    bytebuf_t* buf;
+    int pooled; /* buf 来自 group 的空闲链表, 否则是 conn_write_bf 传入的 */
+} conn_chunk_t;
+
+struct ez_conn_s {
+    int fd;
+    int mask; /* 已注册的事件 */
+    int flags;
+    int close_reason;
+    ez_conn_group_t* group;
+    bytebuf_t* in;
+    list_head_t out; /* conn_chunk_t 队列 */
+    size_t out_bytes;
+    int paused; /* CONN_PAUSE_* */
+    size_t low_mark;
+    size_t high_mark;
+    ezConnWatermarkProc watermark_proc;
+    ezConnErrorProc error_proc;
+    size_t notsent_lowat; /* >0: 每次可写只写出约这么多 */
+    conn_chunk_t* urgent_last; /* 最后一个 conn_write_urgent 的块 */
+    ez_ratelimit_t* rl;
+    uint64_t rl_key; /* 0: 用 rl_bucket */
+    ez_token_bucket_t rl_bucket;
+    int64_t rl_timer; /* 恢复读取的定时器, -1 表示没有 */
+    ezConnReadProc read_proc;
+    ezConnCloseProc close_proc;
+    void* data;
+    list_head_t node; /* group->conns 或 group->free_conns */
+};
+
+struct ez_conn_group_s {
+    ez_event_loop_t* loop;
+    size_t bufsize;
+    size_t max_input; /* 输入缓冲中未处理数据的上限 */
+    int count;
+    list_head_t conns;
+    list_head_t free_conns;
+    list_head_t free_chunks; /* 带 buf 的空闲块 */
+    list_head_t free_nodes; /* 不带 buf 的空闲块 */
+    int free_chunk_count;
+    int64_t sample_id; /* TCP_INFO 采样定时器, -1 表示没有 */
+    ez_conn_tcp_stats_t* tcp_stats;
+    int64_t drain_id; /* drain 定时器, -1 表示没有在 drain */
+    int64_t drain_start;
+    int64_t drain_deadline;
+    ez_conn_drain_stats_t drain_stats;
+    ezConnDrainProc drain_proc;
+    void* drain_data;
+    int busy; /* 正在执行的读/关闭/错误/drain 回调层数 */
+    int free_pending; /* 回调中调用了 free_conn_group, 最外层回调返回后释放 */
+};
+
+static inline conn_chunk_t* cast_to_chunk(list_head_t* node)
+{
+    return EZ_CONTAINER_OF(node, conn_chunk_t, node);
+}
+
+static inline ez_conn_t* cast_to_conn(list_head_t* node)
+{
+    return EZ_CONTAINER_OF(node, ez_conn_t, node);
+}
+
+static void conn_event_proc(ez_event_loop_t* eventLoop, int fd, void* clientData, int mask);
+
+// =====================================================================
+// chunk
+static conn_chunk_t* chunk_get(ez_conn_group_t* g, int pooled)
+{
+    conn_chunk_t* ch;
+    list_head_t* free_list = pooled ? &g->free_chunks : &g->free_nodes;
+
+    if (!list_is_empty(free_list)) {
+        ch = cast_to_chunk(free_list->next);
+        list_del(&ch->node);
+        if (pooled)
+            g->free_chunk_count--;
+    } else {
+        ch = ez_malloc(sizeof(conn_chunk_t));
+        ch->buf = pooled ? new_bytebuf(g->bufsize) : NULL;
+    }
+    ch->pooled = pooled;
+    return ch;
+}
+
+static void chunk_put(ez_conn_group_t* g, conn_chunk_t* ch)
+{
+    if (!ch->pooled) {
+        free_bytebuf(ch->buf);
+        ch->buf = NULL;
+        list_add(&ch->node, &g->free_nodes);
+    } else if (g->free_chunk_count >= CONN_FREE_CHUNK_MAX) {
+        free_bytebuf(ch->buf);
+        ez_free(ch);
+    } else {
+        bytebuf_reset(ch->buf);
+        list_add(&ch->node, &g->free_chunks);
+        g->free_chunk_count++;
+    }
+}
+
+static void chunk_free_list(list_head_t* head)
+{
+    LIST_FOR(head, pos)
+    {
+        conn_chunk_t* ch = cast_to_chunk(pos);
+        list_del(pos);
+        if (ch->buf != NULL)
+            free_bytebuf(ch->buf);
+        ez_free(ch);
+    }
+}
+
+// =====================================================================
+// group
+ez_conn_group_t* new_conn_group(ez_event_loop_t* eventLoop, size_t bufsize)
+{
+    ez_conn_group_t* g = ez_malloc(sizeof(ez_conn_group_t));
+    g->loop = eventLoop;
+    g->bufsize = bufsize;
+    g->max_input = CONN_INPUT_MAX;
+    g->count = 0;
+    g->free_chunk_count = 0;
+    init_list_head(&g->conns);
+    init_list_head(&g->free_conns);
+    init_list_head(&g->free_chunks);
+    init_list_head(&g->free_nodes);
+    g->sample_id = -1;
+    g->tcp_stats = NULL;
+    g->drain_id = -1;
+    g->drain_proc = NULL;
+    g->drain_data = NULL;
+    g->busy = 0;
+    g->free_pending = 0;
+    return g;
+}
+
+static void conn_group_release(ez_conn_group_t* g)
+{
+    LIST_FOR(&g->free_conns, pos)
+    {
+        ez_conn_t* c = cast_to_conn(pos);
+        list_del(pos);
+        free_bytebuf(c->in);
+        ez_free(c);
+    }
+    chunk_free_list(&g->free_chunks);
+    chunk_free_list(&g->free_nodes);
+    if (g->sample_id >= 0)
+        ez_delete_time_event(g->loop, g->sample_id);
+    if (g->drain_id >= 0)
+        ez_delete_time_event(g->loop, g->drain_id);
+    if (g->tcp_stats != NULL) {
+        free_histogram(g->tcp_stats->rtt_us);
+        free_histogram(g->tcp_stats->rttvar_us);
+        free_histogram(g->tcp_stats->snd_cwnd);
+        free_histogram(g->tcp_stats->total_retrans);
+        free_histogram(g->tcp_stats->delivery_rate);
+        ez_free(g->tcp_stats);
+    }
+    ez_free(g);
+}
+
+/* 回调返回后调用, 最外层返回时释放回调中 free_conn_group 的 group, 之后不能再访问 g */
+static void conn_group_leave(ez_conn_group_t* g)
+{
+    if (--g->busy == 0 && g->free_pending)
+        conn_group_release(g);
+}
+
+/* 逐个关闭 head 中的连接. close_proc 里可能关闭别的连接, 不能边遍历边关:
+   每次取第一个放回 g->conns 再关, 被 close_proc 关掉的会从 head 里摘走. */
+static void conn_group_close_list(ez_conn_group_t* g, list_head_t* head)
+{
+    ez_conn_t* c;
+
+    while (!list_is_empty(head)) {
+        c = cast_to_conn(head->next);
+        list_del(&c->node);
+        list_add(&c->node, &g->conns);
+        conn_close(c);
+    }
+}
+
+void free_conn_group(ez_conn_group_t* g)
+{
+    list_head_t closing;
+
+    if (g == NULL || g->free_pending)
+        return;
+    g->free_pending = 1;
+
+    // 读回调中的连接只标记关闭, 回调返回后才关; 期间 g 不能释放.
+    g->busy++;
+    init_list_head(&closing);
+    LIST_FOR(&g->conns, pos)
+    {
+        list_del(pos);
+        list_add(pos, closing.prev);
+    }
+    conn_group_close_list(g, &closing);
+    conn_group_leave(g);
+}
+
+void conn_group_set_max_input(ez_conn_group_t* g, size_t max_input)
+{
+    g->max_input = max_input > 0 ? max_input : CONN_INPUT_MAX;
+}
+
+int conn_group_count(ez_conn_group_t* g)
+{
+    return g->count;
+}
+
+static int conn_group_sample_proc(ez_event_loop_t* eventLoop, int64_t timeId, void* clientData)
+{
+    ez_conn_group_t* g = (ez_conn_group_t*)clientData;
+    ez_conn_tcp_stats_t* st = g->tcp_stats;
+    ez_tcp_info_t info;
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(timeId);
+
+    LIST_FOR(&g->conns, pos)
+    {
+        // 不是 tcp 的连接直接跳过.
+        if (ez_net_tcp_info(cast_to_conn(pos)->fd, &info) != ANET_OK)
+            continue;
+        histogram_add(st->rtt_us, info.rtt_us);
+        histogram_add(st->rttvar_us, info.rttvar_us);
+        histogram_add(st->snd_cwnd, info.snd_cwnd);
+        histogram_add(st->total_retrans, info.total_retrans);
+        histogram_add(st->delivery_rate, info.delivery_rate);
+        st->samples++;
+    }
+    return AE_TIMER_NEXT;
+}
+
+void conn_group_sample_tcp_info(ez_conn_group_t* g, int64_t period_ms)
+{
+    if (g->sample_id >= 0) {
+        ez_delete_time_event(g->loop, g->sample_id);
+        g->sample_id = -1;
+    }
+    if (period_ms <= 0)
+        return;
+
+    if (g->tcp_stats == NULL) {
+        g->tcp_stats = ez_malloc(sizeof(ez_conn_tcp_stats_t));
+        g->tcp_stats->samples = 0;
+        g->tcp_stats->rtt_us = new_histogram();
+        g->tcp_stats->rttvar_us = new_histogram();
+        g->tcp_stats->snd_cwnd = new_histogram();
+        g->tcp_stats->total_retrans = new_histogram();
+        g->tcp_stats->delivery_rate = new_histogram();
+    }
+    g->sample_id = ez_create_time_event(g->loop, period_ms, conn_group_sample_proc, g);
+}
+
+ez_conn_tcp_stats_t* conn_group_tcp_stats(ez_conn_group_t* g)
+{
+    return g->tcp_stats;
+}
+
+void conn_group_reset_tcp_stats(ez_conn_group_t* g)
+{
+    ez_conn_tcp_stats_t* st = g->tcp_stats;
+
+    if (st == NULL)
+        return;
+    st->samples = 0;
+    histogram_reset(st->rtt_us);
+    histogram_reset(st->rttvar_us);
+    histogram_reset(st->snd_cwnd);
+    histogram_reset(st->total_retrans);
+    histogram_reset(st->delivery_rate);
+}
+
+static int conn_group_drain_proc(ez_event_loop_t* eventLoop, int64_t timeId, void* clientData)
+{
+    ez_conn_group_t* g = (ez_conn_group_t*)clientData;
+    ez_conn_drain_stats_t* st = &g->drain_stats;
+    int64_t now = mstime();
+    int force = now >= g->drain_deadline;
+    list_head_t closing;
+    ez_conn_t* c;
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(timeId);
+
+    g->busy++;
+    // 先挑出要关闭的再关.
+    init_list_head(&closing);
+    LIST_FOR(&g->conns, pos)
+    {
+        c = cast_to_conn(pos);
+        if (force) {
+            st->forced++;
+        } else if (c->out_bytes == 0 && !bytebuf_is_readable(c->in) && !(c->flags & CONN_F_ACTIVE)) {
+            // 一整个 tick 没有读写, 也没有处理到一半的请求.
+            st->idle_closed++;
+        } else {
+            c->flags &= ~CONN_F_ACTIVE;
+            continue;
+        }
+        list_del(pos);
+        list_add(pos, &closing);
+    }
+    conn_group_close_list(g, &closing);
+    if (g->free_pending) {
+        // close_proc 中释放了 group, 不再回调进度.
+        conn_group_leave(g);
+        return AE_TIMER_END;
+    }
+
+    st->remaining = g->count;
+    st->pending_bytes = 0;
+    LIST_FOR(&g->conns, pos)
+    {
+        st->pending_bytes += cast_to_conn(pos)->out_bytes;
+    }
+    st->elapsed_ms = now - g->drain_start;
+
+    if (g->count > 0) {
+        // 回调中可能 free_conn_group, 释放时删除本定时器, 之后不能再访问 g.
+        if (g->drain_proc != NULL)
+            g->drain_proc(g, st, 0, g->drain_data);
+        conn_group_leave(g);
+        return AE_TIMER_NEXT;
+    }
+    log_info("conn group drained in %ldms: %d conns, %d idle closed, %d forced.", (long)st->elapsed_ms, st->total,
+        st->idle_closed, st->forced);
+    g->drain_id = -1;
+    if (g->drain_proc != NULL)
+        g->drain_proc(g, st, 1, g->drain_data);
+    conn_group_leave(g);
+    return AE_TIMER_END;
+}
+
+int conn_group_drain(ez_conn_group_t* g, int64_t timeout_ms, ezConnDrainProc proc, void* data)
+{
+    if (g->drain_id >= 0)
+        return ANET_ERR;
+
+    // 只看 drain 开始之后的读写.
+    LIST_FOR(&g->conns, pos)
+    {
+        cast_to_conn(pos)->flags &= ~CONN_F_ACTIVE;
+    }
+    memset(&g->drain_stats, 0, sizeof(g->drain_stats));
+    g->drain_stats.total = g->count;
+    g->drain_stats.remaining = g->count;
+    g->drain_start = mstime();
+    g->drain_deadline = g->drain_start + timeout_ms;
+    g->drain_proc = proc;
+    g->drain_data = data;
+    g->drain_id = ez_create_time_event(g->loop, CONN_DRAIN_TICK_MS, conn_group_drain_proc, g);
+    log_info("conn group drain %d conns, timeout %ldms.", g->count, (long)timeout_ms);
+    return ANET_OK;
+}
+
+int conn_group_draining(ez_conn_group_t* g)
+{
+    return g->drain_id >= 0;
+}
+
+// =====================================================================
+// conn
+ez_conn_t* new_conn(ez_conn_group_t* g, int fd, ezConnReadProc read_proc, ezConnCloseProc close_proc, void* data)
+{
+    ez_conn_t* c;
+
+    if (g->drain_id >= 0 || g->free_pending)
+        return NULL;
+    if (!list_is_empty(&g->free_conns)) {
+        c = cast_to_conn(g->free_conns.next);
+        list_del(&c->node);
+        bytebuf_reset(c->in);
+    } else {
+        c = ez_malloc(sizeof(ez_conn_t));
+        c->in = new_bytebuf(g->bufsize);
+    }
+
+    c->fd = fd;
+    c->mask = AE_NONE;
+    c->flags = 0;
+    c->close_reason = CONN_CLOSE_ACTIVE;
+    c->group = g;
+    init_list_head(&c->out);
+    c->out_bytes = 0;
+    c->paused = 0;
+    c->low_mark = c->high_mark = 0;
+    c->watermark_proc = NULL;
+    c->error_proc = NULL;
+    c->notsent_lowat = 0;
+    c->urgent_last = NULL;
+    c->rl = NULL;
+    c->rl_key = 0;
+    c->rl_timer = -1;
+    c->read_proc = read_proc;
+    c->close_proc = close_proc;
+    c->data = data;
+
+    if (ez_create_file_event(g->loop, fd, AE_READABLE, conn_event_proc, c) == AE_ERR) {
+        log_error("conn [fd:%d] add AE_READABLE failed!", fd);
+        list_add(&c->node, &g->free_conns);
+        return NULL;
+    }
+    c->mask = AE_READABLE;
+
+    list_add(&c->node, g->conns.prev);
+    g->count++;
+    return c;
+}
+
+static void conn_do_close(ez_conn_t* c, int reason)
+{
+    ez_conn_group_t* g = c->group;
+
+    if (c->flags & CONN_F_CLOSED)
+        return;
+    c->flags |= CONN_F_CLOSED;
+
+    if (c->mask != AE_NONE)
+        ez_delete_file_event(g->loop, c->fd, c->mask);
+    c->mask = AE_NONE;
+    if (c->rl_timer >= 0) {
+        ez_delete_time_event(g->loop, c->rl_timer);
+        c->rl_timer = -1;
+    }
+    ez_net_close_socket(c->fd);
+
+    g->busy++;
+    if (c->close_proc != NULL)
+        c->close_proc(c, reason, c->data);
+
+    LIST_FOR(&c->out, pos)
+    {
+        list_del(pos);
+        chunk_put(g, cast_to_chunk(pos));
+    }
+    c->out_bytes = 0;
+
+    // 输入缓冲回收前缩回初始大小.
+    bytebuf_reset(c->in);
+    if (c->in->cap > CONN_INPUT_SHRINK * g->bufsize)
+        bytebuf_resize(c->in, g->bufsize);
+
+    list_del(&c->node);
+    list_add(&c->node, &g->free_conns);
+    g->count--;
+    conn_group_leave(g);
+}
+
+/* 回调中只做标记, 回调返回后再真正关闭 */
+static void conn_close_reason(ez_conn_t* c, int reason)
+{
+    if (c->flags & CONN_F_IN_CALLBACK) {
+        if (!(c->flags & CONN_F_CLOSE_PENDING)) {
+            c->flags |= CONN_F_CLOSE_PENDING;
+            c->close_reason = reason;
+        }
+        return;
+    }
+    conn_do_close(c, reason);
+}
+
+void conn_close(ez_conn_t* c)
+{
+    conn_close_reason(c, CONN_CLOSE_ACTIVE);
+}
+
+/* 没有暂停原因且不是等待关闭时才注册 AE_READABLE */
+static int conn_update_read_interest(ez_conn_t* c)
+{
+    ez_event_loop_t* loop = c->group->loop;
+    int want = c->paused == 0 && !(c->flags & (CONN_F_CLOSED | CONN_F_CLOSE_AFTER_FLUSH));
+
+    if (want && !(c->mask & AE_READABLE)) {
+        if (ez_create_file_event(loop, c->fd, AE_READABLE, conn_event_proc, c) == AE_ERR)
+            return ANET_ERR;
+        c->mask |= AE_READABLE;
+    } else if (!want && (c->mask & AE_READABLE)) {
+        ez_delete_file_event(loop, c->fd, AE_READABLE);
+        c->mask &= ~AE_READABLE;
+    }
+    return ANET_OK;
+}
+
+static void conn_pause(ez_conn_t* c, int reason)
+{
+    c->paused |= reason;
+    conn_update_read_interest(c);
+}
+
+static void conn_resume(ez_conn_t* c, int reason)
+{
+    c->paused &= ~reason;
+    if (conn_update_read_interest(c) != ANET_OK)
+        conn_close_reason(c, CONN_CLOSE_ERROR);
+}
+
+void conn_pause_read(ez_conn_t* c)
+{
+    conn_pause(c, CONN_PAUSE_USER);
+}
+
+void conn_resume_read(ez_conn_t* c)
+{
+    conn_resume(c, CONN_PAUSE_USER);
+}
+
+int conn_read_paused(ez_conn_t* c)
+{
+    return c->paused;
+}
+
+void conn_set_watermark(ez_conn_t* c, size_t low, size_t high, ezConnWatermarkProc proc)
+{
+    c->low_mark = low < high ? low : high;
+    c->high_mark = high;
+    c->watermark_proc = proc;
+}
+
+static void conn_check_high_watermark(ez_conn_t* c)
+{
+    if (c->high_mark == 0 || c->out_bytes < c->high_mark || (c->paused & CONN_PAUSE_WATERMARK))
+        return;
+    log_debug("conn [fd:%d] output %zu over high watermark, pause read.", c->fd, c->out_bytes);
+    conn_pause(c, CONN_PAUSE_WATERMARK);
+    if (c->watermark_proc != NULL)
+        c->watermark_proc(c, 1, c->data);
+}
+
+static void conn_check_low_watermark(ez_conn_t* c)
+{
+    if (!(c->paused & CONN_PAUSE_WATERMARK) || c->out_bytes > c->low_mark)
+        return;
+    log_debug("conn [fd:%d] output %zu under low watermark, resume read.", c->fd, c->out_bytes);
+    conn_resume(c, CONN_PAUSE_WATERMARK);
+    if (c->watermark_proc != NULL)
+        c->watermark_proc(c, 0, c->data);
+}
+
+void conn_close_after_flush(ez_conn_t* c)
+{
+    c->flags |= CONN_F_CLOSE_AFTER_FLUSH;
+    conn_update_read_interest(c);
+    if (c->out_bytes == 0)
+        conn_close_reason(c, CONN_CLOSE_ACTIVE);
+}
+
+/* 只在输出队列非空时注册 AE_WRITABLE */
+static int conn_update_write_interest(ez_conn_t* c)
+{
+    ez_event_loop_t* loop = c->group->loop;
+
+    if (c->out_bytes > 0 && !(c->mask & AE_WRITABLE)) {
+        if (ez_create_file_event(loop, c->fd, AE_WRITABLE, conn_event_proc, c) == AE_ERR)
+            return ANET_ERR;
+        c->mask |= AE_WRITABLE;
+    } else if (c->out_bytes == 0 && (c->mask & AE_WRITABLE)) {
+        ez_delete_file_event(loop, c->fd, AE_WRITABLE);
+        c->mask &= ~AE_WRITABLE;
+    }
+    return ANET_OK;
+}
+
+int conn_flush(ez_conn_t* c)
+{
+    bytebuf_t* bufs[ANET_IOV_MAX];
+    size_t want;
+    ssize_t nbytes;
+    int cnt, r;
+
+    if (c->flags & CONN_F_CLOSED)
+        return ANET_ERR;
+
+    while (c->out_bytes > 0) {
+        cnt = 0;
+        want = 0;
+        LIST_FOR(&c->out, pos)
+        {
+            if (cnt == ANET_IOV_MAX || (c->notsent_lowat > 0 && want >= c->notsent_lowat))
+                break;
+            bufs[cnt] = cast_to_chunk(pos)->buf;
+            want += bytebuf_readable_size(bufs[cnt]);
+            ++cnt;
+        }
+
+        // 一次 writev 写不完整个队列时用 MSG_MORE, 避免批次边界产生不满 MSS 的报文.
+        if (want < c->out_bytes && c->notsent_lowat == 0)
+            r = ez_net_writev_bf_more(c->fd, bufs, cnt, &nbytes);
+        else
+            r = ez_net_writev_bf(c->fd, bufs, cnt, &nbytes);
+        if (r == ANET_ERR) {
+            log_info("conn [fd:%d] write failed: %s", c->fd, strerror(errno));
+            conn_close_reason(c, CONN_CLOSE_ERROR);
+            return ANET_ERR;
+        }
+        c->out_bytes -= (size_t)nbytes;
+        c->flags |= CONN_F_ACTIVE;
+
+        // 释放已写完的块
+        LIST_FOR(&c->out, pos)
+        {
+            conn_chunk_t* ch = cast_to_chunk(pos);
+            if (bytebuf_is_readable(ch->buf))
+                break;
+            if (ch == c->urgent_last)
+                c->urgent_last = NULL;
+            list_del(pos);
+            chunk_put(c->group, ch);
+        }
+
+        // socket 发送缓冲已满, 等 AE_WRITABLE.
+        if (r == ANET_EAGAIN || (size_t)nbytes < want)
+            break;
+        // 剩下的留在队列里, 等内核中未发出的数据降到 lowat 以下再写.
+        if (c->notsent_lowat > 0)
+            break;
+    }
+
+    if (conn_update_write_interest(c) != ANET_OK) {
+        conn_close_reason(c, CONN_CLOSE_ERROR);
+        return ANET_ERR;
+    }
+    if (c->out_bytes == 0 && (c->flags & CONN_F_CLOSE_AFTER_FLUSH)) {
+        conn_close_reason(c, CONN_CLOSE_ACTIVE);
+        return ANET_OK;
+    }
+    conn_check_low_watermark(c);
+    return ANET_OK;
+}
+
+int conn_write(ez_conn_t* c, const void* data, size_t len)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    conn_chunk_t* ch;
+    size_t n;
+
+    if (c->flags & (CONN_F_CLOSED | CONN_F_CLOSE_PENDING))
+        return ANET_ERR;
+
+    while (len > 0) {
+        ch = list_is_empty(&c->out) ? NULL : cast_to_chunk(c->out.prev);
+        if (ch == NULL || !ch->pooled || !bytebuf_is_writeable(ch->buf)) {
+            ch = chunk_get(c->group, 1);
+            list_add(&ch->node, c->out.prev);
+        }
+        n = bytebuf_writeable_size(ch->buf);
+        if (n > len)
+            n = len;
+        memcpy(bytebuf_writer_pos(ch->buf), p, n);
+        ch->buf->w += n;
+        c->out_bytes += n;
+        p += n;
+        len -= n;
+    }
+    conn_check_high_watermark(c);
+
+    if (c->flags & (CONN_F_IN_CALLBACK | CONN_F_CORKED))
+        return ANET_OK;
+    return conn_flush(c);
+}
+
+int conn_write_bf(ez_conn_t* c, bytebuf_t* buf)
+{
+    conn_chunk_t* ch;
+
+    if (c->flags & (CONN_F_CLOSED | CONN_F_CLOSE_PENDING)) {
+        free_bytebuf(buf);
+        return ANET_ERR;
+    }
+    if (!bytebuf_is_readable(buf)) {
+        free_bytebuf(buf);
+        return ANET_OK;
+    }
+
+    ch = chunk_get(c->group, 0);
+    ch->buf = buf;
+    list_add(&ch->node, c->out.prev);
+    c->out_bytes += bytebuf_readable_size(buf);
+    conn_check_high_watermark(c);
+
+    if (c->flags & (CONN_F_IN_CALLBACK | CONN_F_CORKED))
+        return ANET_OK;
+    return conn_flush(c);
+}
+
+int conn_write_urgent(ez_conn_t* c, const void* data, size_t len)
+{
+    conn_chunk_t* ch;
+
+    if (c->flags & (CONN_F_CLOSED | CONN_F_CLOSE_PENDING))
+        return ANET_ERR;
+    if (len == 0)
+        return ANET_OK;
+
+    ch = chunk_get(c->group, 0);
+    ch->buf = new_bytebuf(len);
+    memcpy(ch->buf->data, data, len);
+    ch->buf->w = (uint32_t)len;
+
+    // 队首可能已写出一部分, 不能拆开, 插在它后面; 多次 urgent 之间保持先后顺序.
+    if (c->urgent_last != NULL)
+        list_add(&ch->node, &c->urgent_last->node);
+    else if (list_is_empty(&c->out))
+        list_add(&ch->node, &c->out);
+    else
+        list_add(&ch->node, c->out.next);
+    c->urgent_last = ch;
+    c->out_bytes += len;
+    conn_check_high_watermark(c);
+
+    if (c->flags & (CONN_F_IN_CALLBACK | CONN_F_CORKED))
+        return ANET_OK;
+    return conn_flush(c);
+}
+
+static int conn_ratelimit_resume(ez_event_loop_t* eventLoop, int64_t timeId, void* clientData)
+{
+    ez_conn_t* c = (ez_conn_t*)clientData;
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(timeId);
+
+    c->rl_timer = -1;
+    conn_resume(c, CONN_PAUSE_RATELIMIT);
+    return AE_TIMER_END;
+}
+
+/* 扣除读入的字节, 欠账时暂停读取并定时恢复 */
+static void conn_ratelimit_charge(ez_conn_t* c, size_t nbytes)
+{
+    int64_t wait;
+
+    wait = c->rl_key != 0 ? ratelimit_charge_key(c->rl, c->rl_key, nbytes) : ratelimit_charge(c->rl, &c->rl_bucket, nbytes);
+    if (wait <= 0 || c->rl_timer >= 0)
+        return;
+    log_debug("conn [fd:%d] rate limited, pause read %ldms.", c->fd, (long)wait);
+    c->rl_timer = ez_create_time_event(c->group->loop, wait, conn_ratelimit_resume, c);
+    conn_pause(c, CONN_PAUSE_RATELIMIT);
+}
+
+void conn_set_ratelimit(ez_conn_t* c, ez_ratelimit_t* rl, uint64_t key)
+{
+    if (c->rl_timer >= 0) {
+        ez_delete_time_event(c->group->loop, c->rl_timer);
+        c->rl_timer = -1;
+        conn_resume(c, CONN_PAUSE_RATELIMIT);
+    }
+    c->rl = rl;
+    c->rl_key = key;
+    if (rl != NULL && key == 0)
+        ratelimit_init_bucket(rl, &c->rl_bucket);
+}
+
+/* 保证输入缓冲有可写空间: 读完的复位, 剩余空间不多时先前移, 还不够再扩容.
+   未处理的数据达到 max_input 或扩容失败时返回 ANET_ERR */
+static int conn_prepare_input(ez_conn_t* c)
+{
+    bytebuf_t* in = c->in;
+    size_t max_input = c->group->max_input, left, n;
+
+    if (!bytebuf_is_readable(in)) {
+        bytebuf_reset(in);
+        // 大消息处理完后缩回初始大小, 持续负载下每个连接的内存不会停在峰值.
+        if (in->cap > CONN_INPUT_SHRINK * c->group->bufsize)
+            bytebuf_resize(in, c->group->bufsize);
+        return ANET_OK;
+    }
+    // 流水线请求总有半条留在缓冲里, 等写满再前移会让每次 read 越来越小.
+    if (bytebuf_writeable_size(in) < in->cap / CONN_INPUT_COMPACT)
+        bytebuf_discard_some_read_bytes(in, in->cap / CONN_INPUT_COMPACT);
+    if (bytebuf_is_writeable(in))
+        return ANET_OK;
+
+    // 对端一直发不完整的消息, 不能无限扩容.
+    left = bytebuf_readable_size(in);
+    if (left >= max_input)
+        return ANET_ERR;
+    n = in->cap < max_input - left ? in->cap : max_input - left;
+    return bytebuf_grow(in, n) == 0 ? ANET_OK : ANET_ERR;
+}
+
+static void conn_on_readable(ez_conn_t* c)
+{
+    ez_conn_group_t* g = c->group;
+    ssize_t nbytes = 0;
+    int r;
+
+    // 不能用 0 字节的缓冲去读, 否则 read 返回 0 会被当成对端关闭.
+    if (conn_prepare_input(c) != ANET_OK) {
+        log_info("conn [fd:%d] input buffer full (%zu bytes unprocessed), close.", c->fd, bytebuf_readable_size(c->in));
+        conn_do_close(c, CONN_CLOSE_ERROR);
+        return;
+    }
+    r = ez_net_read_bf(c->fd, c->in, &nbytes);
+    if (r == ANET_EAGAIN)
+        return;
+    if (r == ANET_ERR) {
+        log_info("conn [fd:%d] read failed: %s", c->fd, strerror(errno));
+        conn_do_close(c, CONN_CLOSE_ERROR);
+        return;
+    }
+    if (nbytes == 0) {
+        conn_do_close(c, CONN_CLOSE_EOF);
+        return;
+    }
+
+    if (c->rl != NULL)
+        conn_ratelimit_charge(c, (size_t)nbytes);
+
+    g->busy++;
+    c->flags |= CONN_F_IN_CALLBACK | CONN_F_ACTIVE;
+    c->read_proc(c, c->in, c->data);
+    c->flags &= ~CONN_F_IN_CALLBACK;
+
+    if (c->flags & CONN_F_CLOSE_PENDING)
+        conn_do_close(c, c->close_reason);
+    else
+        conn_flush(c); // 回调中的写入合并成一次写出.
+    conn_group_leave(g);
+}
+
+static void conn_event_proc(ez_event_loop_t* eventLoop, int fd, void* clientData, int mask)
+{
+    ez_conn_t* c = (ez_conn_t*)clientData;
+    ez_conn_group_t* g = c->group;
+    int closed;
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(fd);
+
+    if (c->flags & CONN_F_CLOSED)
+        return;
+    if ((mask & AE_ERROR) && c->error_proc != NULL) {
+        // 回调中可能关闭连接或释放 group
+        g->busy++;
+        c->error_proc(c, c->data);
+        closed = c->flags & CONN_F_CLOSED;
+        conn_group_leave(g);
+        if (closed)
+            return;
+    }
+    if (mask & AE_READABLE)
+        conn_on_readable(c);
+    else if (mask & AE_WRITABLE)
+        conn_flush(c);
+}
+
+void conn_set_error_proc(ez_conn_t* c, ezConnErrorProc proc)
+{
+    c->error_proc = proc;
+}
+
+int conn_set_notsent_lowat(ez_conn_t* c, size_t lowat)
+{
+    // 关闭时设为 0, 恢复为 sysctl net.ipv4.tcp_notsent_lowat 的值.
+    if (lowat > 0 && ez_net_set_notsent_lowat(c->fd, (int)lowat) != ANET_OK)
+        return ANET_ERR;
+    if (lowat == 0 && c->notsent_lowat > 0)
+        ez_net_set_notsent_lowat(c->fd, 0);
+    c->notsent_lowat = lowat;
+    return ANET_OK;
+}
+
+void conn_cork(ez_conn_t* c)
+{
+    c->flags |= CONN_F_CORKED;
+}
+
+int conn_uncork(ez_conn_t* c)
+{
+    c->flags &= ~CONN_F_CORKED;
+    if (c->flags & CONN_F_IN_CALLBACK)
+        return ANET_OK;
+    return conn_flush(c);
+}
+
+int conn_fd(ez_conn_t* c)
+{
+    return c->fd;
+}
+
+void* conn_data(ez_conn_t* c)
+{
+    return c->data;
+}
+
+void conn_set_data(ez_conn_t* c, void* data)
+{
+    c->data = data;
+}
+
+ez_event_loop_t* conn_loop(ez_conn_t* c)
+{
+    return c->group->loop;
+}
+
+size_t conn_output_size(ez_conn_t* c)
+{
+    return c->out_bytes;
+}
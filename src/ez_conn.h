@@ -0,0 +1,157 @@
+#ifndef EZ_CONN_H
+#define EZ_CONN_H
+
+#include "ez_bytebuf.h"
+#include "ez_event.h"
+#include "ez_histogram.h"
+#include "ez_ratelimit.h"
+
+#include <stddef.h>
+#include <sys/types.h>
+
+//
+// 带输入/输出缓冲的连接.
+// 输出是 bytebuf 队列, 只有队列中还有数据时才注册 AE_WRITABLE;
+// 读回调中的多次写入会在回调返回后合并成一次 writev.
+// 同一个 group 的连接共享 ez_conn_t/输出块的空闲链表, 关闭后回收复用.
+//
+typedef struct ez_conn_group_s ez_conn_group_t;
+typedef struct ez_conn_s ez_conn_t;
+
+/* 关闭原因 */
+#define CONN_CLOSE_ACTIVE 0 /* 本端调用 conn_close */
+#define CONN_CLOSE_EOF 1 /* 对端关闭 */
+#define CONN_CLOSE_ERROR 2 /* 读写出错 */
+
+/* 暂停读取的原因, 可以同时存在多个 */
+#define CONN_PAUSE_USER 0x1 /* conn_pause_read */
+#define CONN_PAUSE_WATERMARK 0x2 /* 输出超过高水位 */
+#define CONN_PAUSE_RATELIMIT 0x4 /* 令牌用完, 定时器到期后恢复 */
+
+/* 输入缓冲有新数据, 处理完后应推进 in->r */
+typedef void (*ezConnReadProc)(ez_conn_t* conn, bytebuf_t* in, void* data);
+/* 连接关闭, 回调后 conn 被回收, 不能再使用; fd 已被关闭 */
+typedef void (*ezConnCloseProc)(ez_conn_t* conn, int reason, void* data);
+
+/* high=1: 输出超过高水位, 已暂停读取; high=0: 输出降到低水位以下, 已恢复读取 */
+typedef void (*ezConnWatermarkProc)(ez_conn_t* conn, int high, void* data);
+
+/* fd 上报告了 EPOLLERR(AE_ERROR), 在处理读写之前回调 */
+typedef void (*ezConnErrorProc)(ez_conn_t* conn, void* data);
+
+/* bufsize: 输入缓冲初始大小及输出块大小 */
+ez_conn_group_t* new_conn_group(ez_event_loop_t* eventLoop, size_t bufsize);
+
+#define CONN_INPUT_MAX (64 * 1024 * 1024) /* 默认的 max_input */
+
+/* 每个连接输入缓冲中未处理数据的上限(字节), 0 恢复默认.
+   读回调一直不推进 in->r, 缓冲达到上限时以 CONN_CLOSE_ERROR 关闭连接 */
+void conn_group_set_max_input(ez_conn_group_t* g, size_t max_input);
+
+/* 关闭所有连接并释放. 可以在读/关闭/错误/drain 回调中调用, 最外层回调返回后才真正释放;
+   水位回调中不能调用 */
+void free_conn_group(ez_conn_group_t* g);
+
+/* 当前连接数 */
+int conn_group_count(ez_conn_group_t* g);
+
+/* 平滑关闭的进度 */
+typedef struct ez_conn_drain_stats_s {
+    int total; /* 开始时的连接数 */
+    int remaining; /* 还没关闭的连接 */
+    int idle_closed; /* 空闲后由 drain 关闭 */
+    int forced; /* 到期仍未空闲, 强制关闭 */
+    size_t pending_bytes; /* 剩余连接输出队列中未写出的字节 */
+    int64_t elapsed_ms;
+} ez_conn_drain_stats_t;
+
+/* done=0: 进度, 每 CONN_DRAIN_TICK_MS 一次; done=1: 所有连接已关闭, 最后一次回调.
+   回调中可以 free_conn_group(g), 之后不能再访问 g */
+typedef void (*ezConnDrainProc)(ez_conn_group_t* g, const ez_conn_drain_stats_t* stats, int done, void* data);
+
+#define CONN_DRAIN_TICK_MS 100
+
+/* 平滑关闭: 调用前先停止 accept, 开始后 new_conn 返回 NULL.
+   连接继续正常收发, 输出写完, 输入处理完且一整个 tick 没有读写时关闭;
+   timeout_ms 到期仍未关闭的连接强制关闭(丢弃未写出的数据). 返回 ANET_ERR 表示已经在 drain. */
+int conn_group_drain(ez_conn_group_t* g, int64_t timeout_ms, ezConnDrainProc proc, void* data);
+
+/* 正在 drain 时返回 1, 结束后返回 0 */
+int conn_group_draining(ez_conn_group_t* g);
+
+/* 定时采样的 TCP_INFO 指标, 每个连接每次采样记一次 */
+typedef struct ez_conn_tcp_stats_s {
+    uint64_t samples;
+    ez_histogram_t* rtt_us;
+    ez_histogram_t* rttvar_us;
+    ez_histogram_t* snd_cwnd;
+    ez_histogram_t* total_retrans;
+    ez_histogram_t* delivery_rate; /* bytes/s */
+} ez_conn_tcp_stats_t;
+
+/* 每 period_ms 对所有 tcp 连接采样一次 TCP_INFO, period_ms <= 0 停止采样(保留已有数据) */
+void conn_group_sample_tcp_info(ez_conn_group_t* g, int64_t period_ms);
+
+/* 从未开启采样时返回 NULL */
+ez_conn_tcp_stats_t* conn_group_tcp_stats(ez_conn_group_t* g);
+void conn_group_reset_tcp_stats(ez_conn_group_t* g);
+
+/* 接管非阻塞的 fd, 注册 AE_READABLE; group 正在 drain 或已 free_conn_group 时返回 NULL, fd 由调用方关闭 */
+ez_conn_t* new_conn(ez_conn_group_t* g, int fd, ezConnReadProc read_proc, ezConnCloseProc close_proc, void* data);
+
+/* 立即关闭, 丢弃未写出的数据 */
+void conn_close(ez_conn_t* c);
+
+/* 不再读取, 输出队列写完后关闭 */
+void conn_close_after_flush(ez_conn_t* c);
+
+/* 拷贝 data 到输出队列 */
+int conn_write(ez_conn_t* c, const void* data, size_t len);
+
+/* buf 的可读部分加入输出队列, buf 归连接所有, 写完后 free_bytebuf */
+int conn_write_bf(ez_conn_t* c, bytebuf_t* buf);
+
+/* 拷贝 data 插到输出队列中还没开始写的部分之前, 多次调用之间保持先后顺序 */
+int conn_write_urgent(ez_conn_t* c, const void* data, size_t len);
+
+/* 立即尝试写出输出队列, 返回 ANET_OK 或 ANET_ERR(连接已关闭) */
+int conn_flush(ez_conn_t* c);
+
+/* 设置 TCP_NOTSENT_LOWAT(0 关闭). 开启后每次可写只写出约 lowat 字节,
+   其余留在输出队列中, 内核里排队的数据少, conn_write_urgent 的数据能尽快发出. */
+int conn_set_notsent_lowat(ez_conn_t* c, size_t lowat);
+
+/* 读回调中的写入本来就会合并到回调返回后一次写出;
+   回调之外要连续写多段时, 先 conn_cork, 写完 conn_uncork 合并成一次写出.
+   队列超过一次 writev 的上限时, 前面的批次带 MSG_MORE 发送. */
+void conn_cork(ez_conn_t* c);
+int conn_uncork(ez_conn_t* c);
+
+/* 输出队列的高低水位(字节), high=0 关闭. 输出 >= high 时暂停读取, 写出到 <= low 时恢复 */
+void conn_set_watermark(ez_conn_t* c, size_t low, size_t high, ezConnWatermarkProc proc);
+
+/* 按读入的字节限速: 每次读入后从令牌桶扣除(可以欠账), 欠账时暂停读取, 到还清的时间自动恢复.
+   key 为 0 时用连接自己的桶, 否则用 rl 中 key 对应的共享桶(如同一个客户端 IP 的所有连接).
+   rl 为 NULL 取消限速. rl 由调用方释放, 释放前先取消所有连接的限速. */
+void conn_set_ratelimit(ez_conn_t* c, ez_ratelimit_t* rl, uint64_t key);
+
+/* 错误队列中有数据时回调, 如在 fd 上用了 MSG_ZEROCOPY, 在回调中 zerocopy_reap 读取完成通知.
+   不设置时由读写发现 socket 错误. 回调中可以关闭连接 */
+void conn_set_error_proc(ez_conn_t* c, ezConnErrorProc proc);
+
+/* 暂停/恢复读取(撤销/注册 AE_READABLE) */
+void conn_pause_read(ez_conn_t* c);
+void conn_resume_read(ez_conn_t* c);
+
+/* 返回 CONN_PAUSE_* 的组合, 0 表示正在读取 */
+int conn_read_paused(ez_conn_t* c);
+
+int conn_fd(ez_conn_t* c);
+void* conn_data(ez_conn_t* c);
+void conn_set_data(ez_conn_t* c, void* data);
+ez_event_loop_t* conn_loop(ez_conn_t* c);
+
+/* 输出队列中未写出的字节数 */
+size_t conn_output_size(ez_conn_t* c);
+
+#endif // EZ_CONN_H
@@ -0,0 +1,394 @@
+#include "ez_conn_pool.h"
+
+#include "ez_list.h"
+#include "ez_log.h"
+#include "ez_macro.h"
+#include "ez_malloc.h"
+#include "ez_net.h"
+#include "ez_rbtree.h"
+#include "ez_util.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#define POOL_HOST_MAX 256
+#define POOL_CHECK_PERIOD_MAX 1000
+
+typedef struct pool_endpoint_s {
+    ez_rbtree_node_t rb_node;
+    list_head_t node; /* pool->endpoint_list */
+    ez_conn_pool_t* pool;
+    char host[POOL_HOST_MAX];
+    int port;
+    int total; /* 空闲 + 借出 + 连接中 */
+    int idle_count;
+    list_head_t idle; /* pool_idle_t, 头部是最近放回的 */
+    list_head_t waiters; /* pool_request_t, 达到上限后排队 */
+} pool_endpoint_t;
+
+typedef struct pool_idle_s {
+    list_head_t node;
+    pool_endpoint_t* ep;
+    int fd;
+    int64_t since; /* 放回时间 ms */
+} pool_idle_t;
+
+/* 排队或连接中的请求 */
+typedef struct pool_request_s {
+    list_head_t node;
+    pool_endpoint_t* ep;
+    ez_connect_t* req;
+    ezConnectProc proc;
+    void* clientData;
+} pool_request_t;
+
+struct ez_conn_pool_s {
+    ez_event_loop_t* loop;
+    int max_per_endpoint;
+    int64_t idle_timeout;
+    int64_t connect_timeout;
+    int64_t timer_id;
+    ez_rbtree_t endpoints;
+    ez_rbtree_node_t sentinel;
+    list_head_t endpoint_list; /* 遍历用, endpoint 只增不删 */
+    list_head_t connecting; /* pool_request_t */
+    ez_conn_pool_stats_t stats;
+};
+
+typedef struct endpoint_key_s {
+    const char* host;
+    int port;
+} endpoint_key_t;
+
+static void pool_serve_waiters(pool_endpoint_t* ep);
+
+static inline pool_endpoint_t* cast_to_endpoint(ez_rbtree_node_t* node)
+{
+    return EZ_CONTAINER_OF(node, pool_endpoint_t, rb_node);
+}
+
+static int endpoint_cmp(const char* host, int port, const char* host2, int port2)
+{
+    if (port != port2)
+        return port > port2 ? 1 : -1;
+    return strcmp(host, host2);
+}
+
+static int endpoint_compare_proc(ez_rbtree_node_t* newNode, ez_rbtree_node_t* existNode)
+{
+    pool_endpoint_t* a = cast_to_endpoint(newNode);
+    pool_endpoint_t* b = cast_to_endpoint(existNode);
+    return endpoint_cmp(a->host, a->port, b->host, b->port);
+}
+
+static int endpoint_find_compare_proc(ez_rbtree_node_t* node, void* find_args)
+{
+    endpoint_key_t* key = (endpoint_key_t*)find_args;
+    pool_endpoint_t* ep = cast_to_endpoint(node);
+    return endpoint_cmp(ep->host, ep->port, key->host, key->port);
+}
+
+static pool_endpoint_t* pool_find_endpoint(ez_conn_pool_t* p, const char* host, int port)
+{
+    endpoint_key_t key = { host, port };
+    ez_rbtree_node_t* n = rbtree_find_node(&p->endpoints, endpoint_find_compare_proc, &key);
+    return n == NULL ? NULL : cast_to_endpoint(n);
+}
+
+static pool_endpoint_t* pool_get_endpoint(ez_conn_pool_t* p, const char* host, int port)
+{
+    pool_endpoint_t* ep = pool_find_endpoint(p, host, port);
+    if (ep != NULL)
+        return ep;
+
+    if (strlen(host) >= POOL_HOST_MAX)
+        return NULL;
+    ep = ez_malloc(sizeof(pool_endpoint_t));
+    ep->pool = p;
+    strcpy(ep->host, host);
+    ep->port = port;
+    ep->total = 0;
+    ep->idle_count = 0;
+    init_list_head(&ep->idle);
+    init_list_head(&ep->waiters);
+    rbtree_insert(&p->endpoints, &ep->rb_node);
+    list_add(&ep->node, &p->endpoint_list);
+    return ep;
+}
+
+/* 空闲连接应当既没有数据也没有 EOF */
+static int pool_fd_alive(int fd)
+{
+    char c;
+    ssize_t r = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return r == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+static void pool_release_idle(pool_idle_t* idle)
+{
+    pool_endpoint_t* ep = idle->ep;
+
+    list_del(&idle->node);
+    ep->idle_count--;
+    ez_delete_file_event(ep->pool->loop, idle->fd, AE_READABLE);
+    ez_free(idle);
+}
+
+static void pool_close_idle(pool_idle_t* idle)
+{
+    pool_endpoint_t* ep = idle->ep;
+
+    ez_net_close_socket(idle->fd);
+    pool_release_idle(idle);
+    ep->total--;
+}
+
+static void pool_idle_readable_proc(ez_event_loop_t* eventLoop, int fd, void* clientData, int mask)
+{
+    pool_idle_t* idle = (pool_idle_t*)clientData;
+    pool_endpoint_t* ep = idle->ep;
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(mask);
+
+    // 空闲期间可读: 对端关闭或发来了不属于任何请求的数据, 都不能再复用.
+    log_info("pool %s:%d idle fd:%d broken.", ep->host, ep->port, fd);
+    ep->pool->stats.broken_closed++;
+    pool_close_idle(idle);
+    pool_serve_waiters(ep);
+}
+
+/* 取出最近放回的健康连接, 没有返回 -1 */
+static int pool_take_idle(pool_endpoint_t* ep)
+{
+    while (!list_is_empty(&ep->idle)) {
+        pool_idle_t* idle = EZ_CONTAINER_OF(ep->idle.next, pool_idle_t, node);
+        int fd = idle->fd;
+
+        if (pool_fd_alive(fd)) {
+            pool_release_idle(idle);
+            return fd;
+        }
+        ep->pool->stats.broken_closed++;
+        pool_close_idle(idle);
+    }
+    return -1;
+}
+
+static void pool_connect_proc(ez_event_loop_t* eventLoop, int fd, int status, void* clientData)
+{
+    pool_request_t* r = (pool_request_t*)clientData;
+    pool_endpoint_t* ep = r->ep;
+    ezConnectProc proc = r->proc;
+    void* data = r->clientData;
+
+    list_del(&r->node);
+    ez_free(r);
+    if (status != ANET_OK) {
+        ep->pool->stats.connect_failed++;
+        ep->total--;
+    }
+    proc(eventLoop, fd, status, data);
+    if (status != ANET_OK)
+        pool_serve_waiters(ep);
+}
+
+/* 占一个名额发起连接, 地址解析失败返回 ANET_ERR */
+static int pool_connect(pool_endpoint_t* ep, ezConnectProc proc, void* clientData)
+{
+    ez_conn_pool_t* p = ep->pool;
+    pool_request_t* r = ez_malloc(sizeof(pool_request_t));
+
+    r->ep = ep;
+    r->proc = proc;
+    r->clientData = clientData;
+    r->req = ez_net_async_connect(p->loop, ep->host, ep->port, p->connect_timeout, pool_connect_proc, r);
+    if (r->req == NULL) {
+        ez_free(r);
+        return ANET_ERR;
+    }
+    list_add(&r->node, &p->connecting);
+    ep->total++;
+    p->stats.misses++;
+    return ANET_OK;
+}
+
+/* 有空闲连接或名额时, 按先来先服务处理排队的请求 */
+static void pool_serve_waiters(pool_endpoint_t* ep)
+{
+    ez_conn_pool_t* p = ep->pool;
+
+    while (!list_is_empty(&ep->waiters)) {
+        pool_request_t* r = EZ_CONTAINER_OF(ep->waiters.prev, pool_request_t, node);
+        int fd = pool_take_idle(ep);
+
+        if (fd < 0 && ep->total >= p->max_per_endpoint)
+            return;
+
+        list_del(&r->node);
+        if (fd >= 0) {
+            p->stats.hits++;
+            r->proc(p->loop, fd, ANET_OK, r->clientData);
+        } else if (pool_connect(ep, r->proc, r->clientData) != ANET_OK) {
+            r->proc(p->loop, -1, ANET_ERR, r->clientData);
+        }
+        ez_free(r);
+    }
+}
+
+static int pool_idle_timer_proc(ez_event_loop_t* eventLoop, int64_t timeId, void* clientData)
+{
+    ez_conn_pool_t* p = (ez_conn_pool_t*)clientData;
+    int64_t now = mstime();
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(timeId);
+
+    // 空闲链表尾部是最早放回的.
+    LIST_FOR(&p->endpoint_list, pos)
+    {
+        pool_endpoint_t* ep = EZ_CONTAINER_OF(pos, pool_endpoint_t, node);
+        while (!list_is_empty(&ep->idle)) {
+            pool_idle_t* idle = EZ_CONTAINER_OF(ep->idle.prev, pool_idle_t, node);
+            if (now - idle->since < p->idle_timeout)
+                break;
+            p->stats.idle_closed++;
+            pool_close_idle(idle);
+        }
+        pool_serve_waiters(ep);
+    }
+    return AE_TIMER_NEXT;
+}
+
+ez_conn_pool_t* new_conn_pool(ez_event_loop_t* eventLoop, int max_per_endpoint, int64_t idle_timeout_ms,
+    int64_t connect_timeout_ms)
+{
+    ez_conn_pool_t* p = ez_malloc(sizeof(ez_conn_pool_t));
+
+    p->loop = eventLoop;
+    p->max_per_endpoint = max_per_endpoint > 0 ? max_per_endpoint : 1;
+    p->idle_timeout = idle_timeout_ms;
+    p->connect_timeout = connect_timeout_ms;
+    p->timer_id = -1;
+    rbtree_init(&p->endpoints, &p->sentinel, endpoint_compare_proc);
+    init_list_head(&p->connecting);
+    init_list_head(&p->endpoint_list);
+    memset(&p->stats, 0, sizeof(p->stats));
+
+    if (idle_timeout_ms > 0) {
+        int64_t period = idle_timeout_ms / 2;
+        if (period > POOL_CHECK_PERIOD_MAX)
+            period = POOL_CHECK_PERIOD_MAX;
+        if (period < 1)
+            period = 1;
+        p->timer_id = ez_create_time_event(eventLoop, period, pool_idle_timer_proc, p);
+    }
+    return p;
+}
+
+void free_conn_pool(ez_conn_pool_t* p)
+{
+    ez_rbtree_node_t* i;
+
+    if (p->timer_id >= 0)
+        ez_delete_time_event(p->loop, p->timer_id);
+
+    LIST_FOR(&p->connecting, pos)
+    {
+        pool_request_t* r = EZ_CONTAINER_OF(pos, pool_request_t, node);
+        ez_net_async_connect_cancel(r->req);
+        ez_free(r);
+    }
+
+    while ((i = rbtree_min_node(&p->endpoints)) != NULL) {
+        pool_endpoint_t* ep = cast_to_endpoint(i);
+        rbtree_delete(&p->endpoints, i);
+
+        while (!list_is_empty(&ep->idle))
+            pool_close_idle(EZ_CONTAINER_OF(ep->idle.next, pool_idle_t, node));
+        LIST_FOR(&ep->waiters, pos)
+        {
+            pool_request_t* r = EZ_CONTAINER_OF(pos, pool_request_t, node);
+            ez_free(r);
+        }
+        ez_free(ep);
+    }
+    ez_free(p);
+}
+
+int conn_pool_get(ez_conn_pool_t* p, const char* host, int port, ezConnectProc proc, void* clientData)
+{
+    pool_endpoint_t* ep = pool_get_endpoint(p, host, port);
+    int fd;
+
+    if (ep == NULL)
+        return ANET_ERR;
+
+    // 已有排队的请求时不插队.
+    if (list_is_empty(&ep->waiters) && (fd = pool_take_idle(ep)) >= 0) {
+        p->stats.hits++;
+        proc(p->loop, fd, ANET_OK, clientData);
+        return ANET_OK;
+    }
+    if (list_is_empty(&ep->waiters) && ep->total < p->max_per_endpoint)
+        return pool_connect(ep, proc, clientData);
+
+    pool_request_t* r = ez_malloc(sizeof(pool_request_t));
+    r->ep = ep;
+    r->req = NULL;
+    r->proc = proc;
+    r->clientData = clientData;
+    list_add(&r->node, &ep->waiters);
+    p->stats.waits++;
+    return ANET_OK;
+}
+
+void conn_pool_put(ez_conn_pool_t* p, const char* host, int port, int fd)
+{
+    pool_endpoint_t* ep = pool_find_endpoint(p, host, port);
+
+    if (ep == NULL) {
+        ez_net_close_socket(fd);
+        return;
+    }
+
+    pool_idle_t* idle = ez_malloc(sizeof(pool_idle_t));
+    idle->ep = ep;
+    idle->fd = fd;
+    idle->since = mstime();
+    if (ez_create_file_event(p->loop, fd, AE_READABLE, pool_idle_readable_proc, idle) == AE_ERR) {
+        ez_free(idle);
+        conn_pool_discard(p, host, port, fd);
+        return;
+    }
+    list_add(&idle->node, &ep->idle);
+    ep->idle_count++;
+    pool_serve_waiters(ep);
+}
+
+void conn_pool_discard(ez_conn_pool_t* p, const char* host, int port, int fd)
+{
+    pool_endpoint_t* ep = pool_find_endpoint(p, host, port);
+
+    ez_net_close_socket(fd);
+    if (ep == NULL)
+        return;
+    ep->total--;
+    pool_serve_waiters(ep);
+}
+
+int conn_pool_idle_count(ez_conn_pool_t* p, const char* host, int port)
+{
+    pool_endpoint_t* ep = pool_find_endpoint(p, host, port);
+    return ep == NULL ? 0 : ep->idle_count;
+}
+
+int conn_pool_total_count(ez_conn_pool_t* p, const char* host, int port)
+{
+    pool_endpoint_t* ep = pool_find_endpoint(p, host, port);
+    return ep == NULL ? 0 : ep->total;
+}
+
+void conn_pool_stats(ez_conn_pool_t* p, ez_conn_pool_stats_t* stats)
+{
+    *stats = p->stats;
+}
@@ -0,0 +1,50 @@
+#ifndef EZ_CONN_POOL_H
+#define EZ_CONN_POOL_H
+
+#include "ez_connect.h"
+#include "ez_event.h"
+
+#include <stdint.h>
+
+//
+// 按 (host, port) 复用的出站连接池, 每个事件循环一个.
+// 空闲连接后进先出; 空闲期间注册 AE_READABLE, 对端关闭或发来数据即视为失效并关闭,
+// 取出前再用 MSG_PEEK 检查一次. 空闲超过 idle_timeout_ms 由定时器关闭.
+// 每个 endpoint 的连接数(空闲 + 使用中 + 连接中)不超过 max_per_endpoint,
+// 达到上限时请求排队, 等到有连接放回或释放.
+//
+typedef struct ez_conn_pool_s ez_conn_pool_t;
+
+typedef struct ez_conn_pool_stats_s {
+    uint64_t hits; /* 复用了空闲连接 */
+    uint64_t misses; /* 新建连接 */
+    uint64_t waits; /* 达到上限排队 */
+    uint64_t connect_failed;
+    uint64_t idle_closed; /* 空闲超时关闭 */
+    uint64_t broken_closed; /* 健康检查失败关闭 */
+} ez_conn_pool_stats_t;
+
+/* idle_timeout_ms <= 0 空闲连接不超时; connect_timeout_ms 传给 ez_net_async_connect */
+ez_conn_pool_t* new_conn_pool(ez_event_loop_t* eventLoop, int max_per_endpoint, int64_t idle_timeout_ms,
+    int64_t connect_timeout_ms);
+
+/* 关闭所有空闲连接, 取消连接中的请求和排队的请求(不回调). 已借出的 fd 不受影响 */
+void free_conn_pool(ez_conn_pool_t* p);
+
+/* 借一个连接. 命中空闲连接时在本函数内直接回调, 否则连接完成后回调.
+   返回 ANET_ERR 表示地址解析失败, 不会回调. */
+int conn_pool_get(ez_conn_pool_t* p, const char* host, int port, ezConnectProc proc, void* clientData);
+
+/* 归还一个可以继续使用的连接(没有未读的响应数据) */
+void conn_pool_put(ez_conn_pool_t* p, const char* host, int port, int fd);
+
+/* 连接已不可用, 关闭它并释放名额 */
+void conn_pool_discard(ez_conn_pool_t* p, const char* host, int port, int fd);
+
+/* 某个 endpoint 的空闲连接数和总连接数, endpoint 不存在时都为 0 */
+int conn_pool_idle_count(ez_conn_pool_t* p, const char* host, int port);
+int conn_pool_total_count(ez_conn_pool_t* p, const char* host, int port);
+
+void conn_pool_stats(ez_conn_pool_t* p, ez_conn_pool_stats_t* stats);
+
+#endif // EZ_CONN_POOL_H
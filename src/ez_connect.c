@@ -0,0 +1,242 @@
+#include "ez_connect.h"
+
+#include "ez_log.h"
+#include "ez_macro.h"
+#include "ez_malloc.h"
+#include "ez_net.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+typedef struct connect_addr_s {
+    struct sockaddr_storage sa;
+    socklen_t salen;
+    int family;
+    int fd; /* 正在连接的 socket, -1 表示未开始或已失败 */
+} connect_addr_t;
+
+struct ez_connect_s {
+    ez_event_loop_t* loop;
+    int naddr;
+    int next; /* 下一个要尝试的地址 */
+    int pending; /* 正在进行的尝试数 */
+    int64_t timeout_id; /* -1 表示没有 */
+    int64_t delay_id;
+    ezConnectProc proc;
+    void* clientData;
+    connect_addr_t* addrs;
+};
+
+static void connect_writable_proc(ez_event_loop_t* eventLoop, int fd, void* clientData, int mask);
+static void connect_next(ez_connect_t* req);
+
+/* 解析结果按地址族交替排列, 以第一个结果的地址族开头 */
+static int connect_resolve(ez_connect_t* req, const char* host, int port)
+{
+    struct addrinfo hints, *servinfo, *p;
+    char portstr[6]; /* strlen("65535") + 1; */
+    int rv, n = 0, i, j, k;
+
+    snprintf(portstr, sizeof(portstr), "%d", port);
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if ((rv = getaddrinfo(host, portstr, &hints, &servinfo)) != 0) {
+        log_error("getaddrinfo %s: %s", host, gai_strerror(rv));
+        return ANET_ERR;
+    }
+    for (p = servinfo; p != NULL; p = p->ai_next)
+        n++;
+
+    connect_addr_t* tmp = ez_malloc(sizeof(connect_addr_t) * n);
+    req->addrs = ez_malloc(sizeof(connect_addr_t) * n);
+    for (p = servinfo, i = 0; p != NULL; p = p->ai_next, i++) {
+        memcpy(&tmp[i].sa, p->ai_addr, p->ai_addrlen);
+        tmp[i].salen = p->ai_addrlen;
+        tmp[i].family = p->ai_family;
+        tmp[i].fd = -1;
+    }
+    freeaddrinfo(servinfo);
+
+    // 交替取首选地址族和其他地址族.
+    int first = n > 0 ? tmp[0].family : AF_UNSPEC;
+    for (i = 0, j = 0, k = 0; k < n;) {
+        while (i < n && tmp[i].family != first)
+            i++;
+        if (i < n)
+            req->addrs[k++] = tmp[i++];
+        while (j < n && tmp[j].family == first)
+            j++;
+        if (j < n)
+            req->addrs[k++] = tmp[j++];
+    }
+    ez_free(tmp);
+    req->naddr = n;
+    return n > 0 ? ANET_OK : ANET_ERR;
+}
+
+static void connect_close_attempt(ez_connect_t* req, connect_addr_t* a)
+{
+    if (a->fd < 0)
+        return;
+    ez_delete_file_event(req->loop, a->fd, AE_WRITABLE);
+    ez_net_close_socket(a->fd);
+    a->fd = -1;
+    req->pending--;
+}
+
+static void connect_free(ez_connect_t* req)
+{
+    int i;
+    for (i = 0; i < req->naddr; ++i)
+        connect_close_attempt(req, &req->addrs[i]);
+    if (req->timeout_id >= 0)
+        ez_delete_time_event(req->loop, req->timeout_id);
+    if (req->delay_id >= 0)
+        ez_delete_time_event(req->loop, req->delay_id);
+    ez_free(req->addrs);
+    ez_free(req);
+}
+
+static void connect_finish(ez_connect_t* req, int fd, int status)
+{
+    ez_event_loop_t* loop = req->loop;
+    ezConnectProc proc = req->proc;
+    void* clientData = req->clientData;
+
+    connect_free(req);
+    proc(loop, fd, status, clientData);
+}
+
+static int connect_timeout_proc(ez_event_loop_t* eventLoop, int64_t timeId, void* clientData)
+{
+    ez_connect_t* req = (ez_connect_t*)clientData;
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(timeId);
+
+    req->timeout_id = -1;
+    log_warn("async connect timeout, %d addresses tried.", req->next);
+    connect_finish(req, -1, ANET_ETIMEDOUT);
+    return AE_TIMER_END;
+}
+
+static int connect_delay_proc(ez_event_loop_t* eventLoop, int64_t timeId, void* clientData)
+{
+    ez_connect_t* req = (ez_connect_t*)clientData;
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(timeId);
+
+    // 当前尝试迟迟没有结果, 并发尝试下一个地址.
+    req->delay_id = -1;
+    connect_next(req);
+    return AE_TIMER_END;
+}
+
+/* 发起下一个地址的连接; 全部失败时回调 ANET_ERR */
+static void connect_next(ez_connect_t* req)
+{
+    int s;
+
+    if (req->delay_id >= 0) {
+        ez_delete_time_event(req->loop, req->delay_id);
+        req->delay_id = -1;
+    }
+
+    while (req->next < req->naddr) {
+        connect_addr_t* a = &req->addrs[req->next++];
+
+        if ((s = socket(a->family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1)
+            continue;
+        if (connect(s, (struct sockaddr*)&a->sa, a->salen) == 0) {
+            connect_finish(req, s, ANET_OK);
+            return;
+        }
+        if (errno != EINPROGRESS) {
+            log_info("connect %s failed: %s", socket_family_name(a->family), strerror(errno));
+            ez_net_close_socket(s);
+            continue;
+        }
+        if (ez_create_file_event(req->loop, s, AE_WRITABLE, connect_writable_proc, req) == AE_ERR) {
+            ez_net_close_socket(s);
+            continue;
+        }
+        a->fd = s;
+        req->pending++;
+        if (req->next < req->naddr)
+            req->delay_id = ez_create_time_event(req->loop, CONNECT_ATTEMPT_DELAY_MS, connect_delay_proc, req);
+        return;
+    }
+
+    if (req->pending == 0)
+        connect_finish(req, -1, ANET_ERR);
+}
+
+static void connect_writable_proc(ez_event_loop_t* eventLoop, int fd, void* clientData, int mask)
+{
+    ez_connect_t* req = (ez_connect_t*)clientData;
+    connect_addr_t* a = NULL;
+    int i, err = 0;
+    socklen_t len = sizeof(err);
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(mask);
+
+    for (i = 0; i < req->naddr; ++i) {
+        if (req->addrs[i].fd == fd) {
+            a = &req->addrs[i];
+            break;
+        }
+    }
+    if (a == NULL)
+        return;
+
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1)
+        err = errno;
+    if (err == 0) {
+        // 交给调用者, 不随 req 一起关闭.
+        ez_delete_file_event(req->loop, fd, AE_WRITABLE);
+        a->fd = -1;
+        req->pending--;
+        connect_finish(req, fd, ANET_OK);
+        return;
+    }
+
+    log_info("connect %s fd:%d failed: %s", socket_family_name(a->family), fd, strerror(err));
+    connect_close_attempt(req, a);
+    connect_next(req);
+}
+
+ez_connect_t* ez_net_async_connect(ez_event_loop_t* eventLoop, const char* host, int port, int64_t timeout_ms,
+    ezConnectProc proc, void* clientData)
+{
+    ez_connect_t* req = ez_malloc(sizeof(ez_connect_t));
+    req->loop = eventLoop;
+    req->next = 0;
+    req->pending = 0;
+    req->timeout_id = -1;
+    req->delay_id = -1;
+    req->proc = proc;
+    req->clientData = clientData;
+    req->addrs = NULL;
+
+    if (connect_resolve(req, host, port) != ANET_OK) {
+        ez_free(req->addrs);
+        ez_free(req);
+        return NULL;
+    }
+    if (timeout_ms > 0)
+        req->timeout_id = ez_create_time_event(eventLoop, timeout_ms, connect_timeout_proc, req);
+
+    // 第一次连接放到事件循环中发起, 保证回调不会在本函数返回前发生.
+    req->delay_id = ez_create_time_event(eventLoop, 0, connect_delay_proc, req);
+    return req;
+}
+
+void ez_net_async_connect_cancel(ez_connect_t* req)
+{
+    if (req != NULL)
+        connect_free(req);
+}
@@ -0,0 +1,33 @@
+#ifndef EZ_CONNECT_H
+#define EZ_CONNECT_H
+
+#include "ez_event.h"
+
+#include <errno.h>
+#include <stdint.h>
+
+//
+// 事件循环中的非阻塞 tcp connect.
+// host 解析出的多个地址按 ipv6/ipv4 交替排列(happy eyeballs), 先连第一个,
+// CONNECT_ATTEMPT_DELAY_MS 内没有结果或失败就并发连下一个, 第一个连上的胜出,
+// 其余的关闭. 整体超过 timeout_ms 回调 ANET_ETIMEDOUT.
+// 注意: 地址解析(getaddrinfo)仍是阻塞的.
+//
+#define CONNECT_ATTEMPT_DELAY_MS 250
+
+#define ANET_ETIMEDOUT (-ETIMEDOUT)
+
+typedef struct ez_connect_s ez_connect_t;
+
+/* status == ANET_OK 时 fd 为已连接的非阻塞 socket, 归调用者所有;
+   否则 fd 为 -1, status 为 ANET_ERR 或 ANET_ETIMEDOUT. */
+typedef void (*ezConnectProc)(ez_event_loop_t* eventLoop, int fd, int status, void* clientData);
+
+/* timeout_ms <= 0 不设超时. 地址解析失败直接返回 NULL, 不会回调. */
+ez_connect_t* ez_net_async_connect(ez_event_loop_t* eventLoop, const char* host, int port, int64_t timeout_ms,
+    ezConnectProc proc, void* clientData);
+
+/* 取消还未完成的 connect, 不会回调 */
+void ez_net_async_connect_cancel(ez_connect_t* req);
+
+#endif // EZ_CONNECT_H
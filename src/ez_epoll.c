@@ -164,6 +164,8 @@ static int ezApiPoll(ez_event_loop_t* eventLoop, int timeout)
                 mask |= AE_READABLE;
             if (what & EPOLLOUT)
                 mask |= AE_WRITABLE;
+            if (what & EPOLLERR)
+                mask |= AE_ERROR;
 
             if (!mask)
                 continue;
@@ -66,8 +66,11 @@ struct ez_event_loop_s {
     ez_rbtree_node_t* free_events; /* free rbtree node linked list (node->parent) */
 
     time_t lastTime; /* Used to detect system clock skew */
+    int64_t now_ms; /* 每次 poll 返回后更新的缓存时钟 */
     int64_t timeNextId;
     list_head_t time_events; /* 按照时间长短和ID进行比较放入的队列 */
+    list_head_t time_reput; /* 本轮已经触发, 等待重新入队的 time event */
+    ez_time_event_t* time_running; /* 正在回调的 time event */
 
     ez_fired_event_t* fired; /* Fired events */
 };
@@ -126,9 +129,12 @@ ez_event_loop_t* ez_create_event_loop(int setsize)
         goto err;
 
     init_list_head(&eventLoop->time_events);
+    init_list_head(&eventLoop->time_reput);
+    eventLoop->time_running = NULL;
 
     eventLoop->setsize = setsize;
     eventLoop->lastTime = time(NULL);
+    eventLoop->now_ms = mstime();
     eventLoop->timeNextId = 0;
     eventLoop->stop = 0;
 
@@ -179,6 +185,11 @@ void ez_delete_event_loop(ez_event_loop_t* eventLoop)
     ez_free(eventLoop);
 }
 
+int64_t ez_event_loop_now(ez_event_loop_t* eventLoop)
+{
+    return eventLoop->now_ms;
+}
+
 void ez_stop_event_loop(ez_event_loop_t* eventLoop)
 {
     if (!eventLoop)
@@ -253,8 +264,6 @@ int ez_create_file_event(ez_event_loop_t* eventLoop, int fd, EVENT_MASK mask, ez
 
 void ez_delete_file_event(ez_event_loop_t* eventLoop, int fd, EVENT_MASK mask)
 {
-    if (fd >= eventLoop->setsize)
-        return;
     ez_file_event_t* fe = ez_fund_file_event(eventLoop, fd);
     if (fe == NULL || fe->mask == AE_NONE)
         return;
@@ -305,19 +314,35 @@ int64_t ez_create_time_event(ez_event_loop_t* eventLoop, int64_t period, ezTimeP
     return id;
 }
 
-void ez_delete_time_event(ez_event_loop_t* eventLoop, int64_t id)
+static int delete_time_event_in_list(list_head_t* head, int64_t id)
 {
     ez_time_event_t* te = NULL;
-    LIST_FOR(&(eventLoop->time_events), pos)
+    LIST_FOR(head, pos)
     {
         te = cast_to_time_event(pos);
         if (te->id == id) {
             log_debug("delete time event [id:%li].", id);
             list_del(pos);
             ez_free(te);
-            return;
+            return 1;
         }
     }
+    return 0;
+}
+
+void ez_delete_time_event(ez_event_loop_t* eventLoop, int64_t id)
+{
+    if (id < 0)
+        return;
+    // 正在回调的不在任何链表里, 先标记为删除, 回调返回后释放.
+    if (eventLoop->time_running != NULL && eventLoop->time_running->id == id) {
+        log_debug("delete running time event [id:%li].", id);
+        eventLoop->time_running->id = -1;
+        return;
+    }
+    if (delete_time_event_in_list(&eventLoop->time_events, id))
+        return;
+    delete_time_event_in_list(&eventLoop->time_reput, id);
 }
 
 #define AE_FILE_EVENTS 1
@@ -329,6 +354,9 @@ void ez_run_event_loop(ez_event_loop_t* eventLoop)
     if (!eventLoop)
         return;
 
+    // 允许 stop 之后再次 run; stop 命令经 eventfd 传递, 不会因此丢失.
+    eventLoop->stop = 0;
+    eventLoop->now_ms = mstime();
     ezApiBeforePoll(eventLoop);
     while (!eventLoop->stop) {
         ez_process_events(eventLoop, AE_ALL_EVENTS);
@@ -341,7 +369,6 @@ static int process_time_events(ez_event_loop_t* eventLoop)
 {
     int processed = 0;
     int all_fired = 0;
-    list_head_t* re_put = NULL;
     int64_t now_ms;
     ez_time_event_t* te = NULL;
     /* If the system clock is moved to the future, and then set back to the
@@ -359,8 +386,9 @@ static int process_time_events(ez_event_loop_t* eventLoop)
     }
     eventLoop->lastTime = now;
 
-    LIST_FOR(&(eventLoop->time_events), tmp)
-    {
+    // 每次都从表头取: timeProc 中可能删除其他 time event, 不能预先保存 next.
+    while (!list_is_empty(&eventLoop->time_events)) {
+        list_head_t* tmp = eventLoop->time_events.next;
         te = cast_to_time_event(tmp);
         now_ms = mstime();
 
@@ -368,10 +396,13 @@ static int process_time_events(ez_event_loop_t* eventLoop)
             list_del(tmp);
 
             log_debug("call time event [id:%li]", te->id);
+            eventLoop->time_running = te;
             int ret_val = te->timeProc(eventLoop, te->id, te->clientData);
+            eventLoop->time_running = NULL;
             processed++;
 
-            if (ret_val <= AE_TIMER_END) {
+            // id 为 -1 表示回调中删除了自己
+            if (ret_val <= AE_TIMER_END || te->id < 0) {
                 log_debug("delete one time event [id:%li]", te->id);
                 ez_free(te);
             } else {
@@ -379,9 +410,8 @@ static int process_time_events(ez_event_loop_t* eventLoop)
                     te->when_ms = now_ms + te->period;
                 else
                     te->when_ms = now_ms + ret_val;
-                // 重新入队的加入reput链表
-                te->listNode.next = re_put;
-                re_put = &te->listNode;
+                // 重新入队的加入reput链表, 本轮之内 ez_delete_time_event 也能找到
+                list_add(&te->listNode, &eventLoop->time_reput);
             }
         } else {
             // 没得比这个时间小的了，停止处理timeEvent.
@@ -390,10 +420,9 @@ static int process_time_events(ez_event_loop_t* eventLoop)
     }
 
     // 重新入队
-    while (re_put != NULL) {
-        te = cast_to_time_event(re_put);
-        // 插入前先转到下一个指针[因为insert_list_head会对next.prev进行操作]
-        re_put = re_put->next;
+    while (!list_is_empty(&eventLoop->time_reput)) {
+        te = cast_to_time_event(eventLoop->time_reput.next);
+        list_del(&te->listNode);
 
         log_debug("reput time event [id:%li]", te->id);
         insert_time_event_list(eventLoop->time_events.next, &eventLoop->time_events, te);
@@ -442,22 +471,27 @@ static int ez_process_events(ez_event_loop_t* eventLoop, int flags)
         if (shortest != NULL) {
             tvp = (int)(shortest->when_ms - mstime());
             if (tvp < 0)
-                tvp = 100;
+                tvp = 0; // 已经到期, 不再等待
         } else {
             tvp = -1; // wait for block
         }
 
         numevents = ezApiPoll(eventLoop, tvp);
+        eventLoop->now_ms = mstime();
         for (j = 0; j < numevents; j++) {
             int fd = eventLoop->fired[j].fd;
             int fired_mask = eventLoop->fired[j].mask;
             ez_file_event_t* fe = ez_fund_file_event(eventLoop, fd);
 
-            if ((fired_mask & AE_READABLE) == AE_READABLE && fe != NULL && fe->mask != AE_NONE) {
-                fe->rfileProc(eventLoop, fd, fe->clientData, AE_READABLE);
+            // EPOLLERR 会同时映射成 READABLE|WRITABLE, 只回调已注册的 mask;
+            // AE_ERROR 只随第一个回调传一次.
+            int err = fired_mask & AE_ERROR;
+            if ((fired_mask & AE_READABLE) == AE_READABLE && fe != NULL && (fe->mask & AE_READABLE)) {
+                fe->rfileProc(eventLoop, fd, fe->clientData, AE_READABLE | err);
+                err = 0;
             }
-            if ((fired_mask & AE_WRITABLE) == AE_WRITABLE && fe != NULL && fe->mask != AE_NONE) {
-                fe->wfileProc(eventLoop, fd, fe->clientData, AE_WRITABLE);
+            if ((fired_mask & AE_WRITABLE) == AE_WRITABLE && fe != NULL && (fe->mask & AE_WRITABLE)) {
+                fe->wfileProc(eventLoop, fd, fe->clientData, AE_WRITABLE | err);
             }
             processed++;
         }
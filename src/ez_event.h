@@ -15,7 +15,8 @@ typedef struct ez_event_loop_s ez_event_loop_t;
 typedef enum {
     AE_NONE = 0x0,
     AE_READABLE = 0x1,
-    AE_WRITABLE = 0x2
+    AE_WRITABLE = 0x2,
+    AE_ERROR = 0x4 /* 只出现在回调的 mask 中: fd 上有 EPOLLERR(如 MSG_ZEROCOPY 完成通知), 不能注册 */
 } EVENT_MASK;
 
 typedef void (*ezFileProc)(ez_event_loop_t* eventLoop, int fd, void* clientData, int mask);
@@ -35,6 +36,9 @@ void ez_delete_time_event(ez_event_loop_t* eventLoop, int64_t time_id);
 
 void ez_stop_event_loop(ez_event_loop_t* eventLoop);
 
+/* 缓存的毫秒时钟(mstime), 每次 poll 返回后更新, 回调中读取不产生系统调用 */
+int64_t ez_event_loop_now(ez_event_loop_t* eventLoop);
+
 void ez_run_event_loop(ez_event_loop_t* eventLoop);
 
 #endif /* _EZ_EVENT_H */
@@ -0,0 +1,184 @@
+#include "ez_frame.h"
+
+#include "ez_net.h"
+
+#include <errno.h>
+#include <string.h>
+
+void framer_init(ez_framer_t* f, int type, uint32_t max_size)
+{
+    f->type = type;
+    f->max_size = max_size;
+    f->need = 0;
+}
+
+/* 解析长度前缀, 返回前缀字节数; 数据不够返回 0, varint 非法返回 -1 */
+static inline int frame_decode_header(int type, const uint8_t* p, size_t n, uint32_t* len)
+{
+    uint32_t v = 0;
+    int i;
+
+    switch (type) {
+    case FRAME_LEN_U8:
+        if (n < 1)
+            return 0;
+        *len = p[0];
+        return 1;
+    case FRAME_LEN_U16_BE:
+        if (n < 2)
+            return 0;
+        *len = (uint32_t)p[0] << 8 | p[1];
+        return 2;
+    case FRAME_LEN_U16_LE:
+        if (n < 2)
+            return 0;
+        *len = (uint32_t)p[1] << 8 | p[0];
+        return 2;
+    case FRAME_LEN_U32_BE:
+        if (n < 4)
+            return 0;
+        *len = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+        return 4;
+    case FRAME_LEN_U32_LE:
+        if (n < 4)
+            return 0;
+        *len = (uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0];
+        return 4;
+    case FRAME_LEN_VARINT:
+        for (i = 0; i < FRAME_HEADER_MAX; ++i) {
+            if ((size_t)i == n)
+                return 0;
+            v |= (uint32_t)(p[i] & 0x7f) << (7 * i);
+            if (!(p[i] & 0x80)) {
+                // 第 5 个字节只能用低 4 位.
+                if (i == FRAME_HEADER_MAX - 1 && p[i] > 0x0f)
+                    return -1;
+                *len = v;
+                return i + 1;
+            }
+        }
+        return -1;
+    default:
+        return -1;
+    }
+}
+
+int framer_next(ez_framer_t* f, bytebuf_t* in, ez_frame_t* frame)
+{
+    const uint8_t* p = bytebuf_reader_pos(in);
+    size_t n = bytebuf_readable_size(in);
+    uint32_t len;
+    int hlen;
+
+    hlen = frame_decode_header(f->type, p, n, &len);
+    if (hlen < 0)
+        return ANET_ERR;
+    if (hlen == 0) {
+        f->need = 1;
+        return ANET_EAGAIN;
+    }
+    if (len > f->max_size)
+        return ANET_ERR;
+    if (n - (size_t)hlen < len) {
+        f->need = (size_t)hlen + len - n;
+        return ANET_EAGAIN;
+    }
+
+    frame->data = p + hlen;
+    frame->len = len;
+    in->r += (uint32_t)hlen + len;
+    f->need = 0;
+    return ANET_OK;
+}
+
+size_t framer_need(ez_framer_t* f)
+{
+    return f->need;
+}
+
+size_t framer_header_size(int type, uint32_t len)
+{
+    size_t n = 1;
+
+    switch (type) {
+    case FRAME_LEN_U8:
+        return 1;
+    case FRAME_LEN_U16_BE:
+    case FRAME_LEN_U16_LE:
+        return 2;
+    case FRAME_LEN_U32_BE:
+    case FRAME_LEN_U32_LE:
+        return 4;
+    case FRAME_LEN_VARINT:
+        while (len >= 0x80) {
+            len >>= 7;
+            n++;
+        }
+        return n;
+    default:
+        return 0;
+    }
+}
+
+size_t framer_encode_header(int type, uint32_t len, uint8_t* out)
+{
+    size_t n = 0;
+
+    switch (type) {
+    case FRAME_LEN_U8:
+        if (len > 0xff)
+            return 0;
+        out[0] = (uint8_t)len;
+        return 1;
+    case FRAME_LEN_U16_BE:
+        if (len > 0xffff)
+            return 0;
+        out[0] = (uint8_t)(len >> 8);
+        out[1] = (uint8_t)len;
+        return 2;
+    case FRAME_LEN_U16_LE:
+        if (len > 0xffff)
+            return 0;
+        out[0] = (uint8_t)len;
+        out[1] = (uint8_t)(len >> 8);
+        return 2;
+    case FRAME_LEN_U32_BE:
+        out[0] = (uint8_t)(len >> 24);
+        out[1] = (uint8_t)(len >> 16);
+        out[2] = (uint8_t)(len >> 8);
+        out[3] = (uint8_t)len;
+        return 4;
+    case FRAME_LEN_U32_LE:
+        out[0] = (uint8_t)len;
+        out[1] = (uint8_t)(len >> 8);
+        out[2] = (uint8_t)(len >> 16);
+        out[3] = (uint8_t)(len >> 24);
+        return 4;
+    case FRAME_LEN_VARINT:
+        while (len >= 0x80) {
+            out[n++] = (uint8_t)(len | 0x80);
+            len >>= 7;
+        }
+        out[n++] = (uint8_t)len;
+        return n;
+    default:
+        return 0;
+    }
+}
+
+int framer_write(ez_framer_t* f, bytebuf_t* out, const void* data, uint32_t len)
+{
+    size_t need = FRAME_HEADER_MAX + (size_t)len;
+    size_t hlen;
+
+    if (len > f->max_size)
+        return ANET_ERR;
+    if (bytebuf_ensure_writable(out, need) != 0)
+        return ANET_ERR;
+    hlen = framer_encode_header(f->type, len, bytebuf_writer_pos(out));
+    if (hlen == 0)
+        return ANET_ERR;
+    memcpy(bytebuf_writer_pos(out) + hlen, data, len);
+    out->w += (uint32_t)(hlen + len);
+    return ANET_OK;
+}
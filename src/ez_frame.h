@@ -0,0 +1,54 @@
+#ifndef EZ_FRAME_H
+#define EZ_FRAME_H
+
+#include "ez_bytebuf.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// 长度前缀的分帧: [长度][payload], 长度为 1/2/4 字节大端或小端, 或 varint(LEB128, 最多 5 字节).
+// framer_next 直接返回指向输入 bytebuf 内部的帧, 不拷贝;
+// 帧不完整时不移动 in->r, 下次读入追加在后面, 凑齐后再返回, 中间也不拷贝.
+// 长度前缀一解析出来就检查 max_size, 不用等超大的帧读完.
+//
+#define FRAME_LEN_U8 1
+#define FRAME_LEN_U16_BE 2
+#define FRAME_LEN_U16_LE 3
+#define FRAME_LEN_U32_BE 4
+#define FRAME_LEN_U32_LE 5
+#define FRAME_LEN_VARINT 6
+
+#define FRAME_HEADER_MAX 5
+
+/* 每个连接一个, 可以直接嵌在连接的结构里 */
+typedef struct ez_framer_s {
+    int type; /* FRAME_LEN_* */
+    uint32_t max_size; /* payload 上限 */
+    size_t need; /* 上次返回 ANET_EAGAIN 时还差的字节数 */
+} ez_framer_t;
+
+typedef struct ez_frame_s {
+    const uint8_t* data; /* 指向输入 bytebuf, 下次往 bytebuf 读入前有效 */
+    uint32_t len;
+} ez_frame_t;
+
+void framer_init(ez_framer_t* f, int type, uint32_t max_size);
+
+/* 取出一帧并推进 in->r. 返回 ANET_OK; 数据不够返回 ANET_EAGAIN;
+   长度超过 max_size 或 varint 非法返回 ANET_ERR, 此时应关闭连接. */
+int framer_next(ez_framer_t* f, bytebuf_t* in, ez_frame_t* frame);
+
+/* 上次返回 ANET_EAGAIN 时当前帧还差的字节数, 可以用来预留输入缓冲 */
+size_t framer_need(ez_framer_t* f);
+
+/* len 的长度前缀占几个字节 */
+size_t framer_header_size(int type, uint32_t len);
+
+/* 把 len 的长度前缀写到 out, 返回写入的字节数; len 超出前缀能表示的范围返回 0 */
+size_t framer_encode_header(int type, uint32_t len, uint8_t* out);
+
+/* 把一帧写到 out 末尾, 空间不够时扩容. 返回 ANET_OK/ANET_ERR */
+int framer_write(ez_framer_t* f, bytebuf_t* out, const void* data, uint32_t len);
+
+#endif // EZ_FRAME_H
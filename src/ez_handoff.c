@@ -0,0 +1,230 @@
+#include "ez_handoff.h"
+
+#include "ez_log.h"
+#include "ez_macro.h"
+#include "ez_malloc.h"
+#include "ez_net.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#define HANDOFF_MAGIC 0x657a686fu /* "ezho" */
+
+#define HANDOFF_TAKE 0 /* 新进程发出的请求 */
+#define HANDOFF_END 3
+
+typedef struct handoff_msg_s {
+    uint32_t magic;
+    uint32_t type;
+    char name[HANDOFF_NAME_MAX];
+} handoff_msg_t;
+
+struct ez_handoff_s {
+    ez_event_loop_t* loop;
+    int fd; /* unix server */
+    int peer; /* 正在交接的新进程, -1 表示没有 */
+    int nlisteners;
+    ez_handoff_fd_t listeners[HANDOFF_LISTENER_MAX];
+    ezHandoffProc proc;
+    void* clientData;
+};
+
+/* 交接很少发生, 用带超时的阻塞读写, 对端卡住时不至于挂住整个进程 */
+static int handoff_set_blocking(int fd)
+{
+    struct timeval tv = { HANDOFF_IO_TIMEOUT_MS / 1000, (HANDOFF_IO_TIMEOUT_MS % 1000) * 1000 };
+    int flags = fcntl(fd, F_GETFL);
+
+    if (flags == -1 || fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) == -1)
+        return ANET_ERR;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == -1
+        || setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) == -1)
+        return ANET_ERR;
+    return ANET_OK;
+}
+
+static int handoff_send(int sock, int type, int fd, const char* name)
+{
+    handoff_msg_t msg;
+    ssize_t nbytes;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.magic = HANDOFF_MAGIC;
+    msg.type = (uint32_t)type;
+    if (name != NULL)
+        strncpy(msg.name, name, HANDOFF_NAME_MAX - 1);
+    if (ez_net_send_fds(sock, &fd, fd >= 0 ? 1 : 0, &msg, sizeof(msg), &nbytes) != ANET_OK
+        || nbytes != (ssize_t)sizeof(msg)) {
+        log_error("handoff send type:%d failed: %s", type, strerror(errno));
+        return ANET_ERR;
+    }
+    return ANET_OK;
+}
+
+/* 收一条完整的消息, fd 只随消息的第一段到达; 没有 fd 时 *fd = -1 */
+static int handoff_recv(int sock, handoff_msg_t* msg, int* fd)
+{
+    size_t got = 0;
+    ssize_t nbytes;
+    int nfds = 1;
+
+    *fd = -1;
+    if (ez_net_recv_fds(sock, fd, &nfds, msg, sizeof(*msg), &nbytes) != ANET_OK || nbytes == 0)
+        goto error;
+    if (nfds == 0)
+        *fd = -1;
+    got = (size_t)nbytes;
+    while (got < sizeof(*msg)) {
+        nbytes = read(sock, (char*)msg + got, sizeof(*msg) - got);
+        if (nbytes <= 0)
+            goto error;
+        got += (size_t)nbytes;
+    }
+    if (msg->magic != HANDOFF_MAGIC)
+        goto error;
+    msg->name[HANDOFF_NAME_MAX - 1] = '\0';
+    return ANET_OK;
+
+error:
+    if (*fd >= 0)
+        ez_net_close_socket(*fd);
+    *fd = -1;
+    return ANET_ERR;
+}
+
+static void handoff_accept_proc(ez_event_loop_t* eventLoop, int fd, void* clientData, int mask)
+{
+    ez_handoff_t* h = (ez_handoff_t*)clientData;
+    handoff_msg_t req;
+    int c, unused = -1, i;
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(mask);
+
+    if ((c = ez_net_unix_accept(fd)) < 0)
+        return;
+    if (handoff_set_blocking(c) != ANET_OK || handoff_recv(c, &req, &unused) != ANET_OK || req.type != HANDOFF_TAKE) {
+        log_warn("handoff: bad request from fd:%d.", c);
+        if (unused >= 0)
+            ez_net_close_socket(unused);
+        ez_net_close_socket(c);
+        return;
+    }
+    if (unused >= 0)
+        ez_net_close_socket(unused);
+
+    for (i = 0; i < h->nlisteners; ++i) {
+        if (handoff_send(c, HANDOFF_LISTENER, h->listeners[i].fd, h->listeners[i].name) != ANET_OK) {
+            ez_net_close_socket(c);
+            return;
+        }
+    }
+    log_info("handoff: %d listeners sent to new process.", h->nlisteners);
+
+    h->peer = c;
+    h->proc(h, h->clientData);
+    h->peer = -1;
+
+    handoff_send(c, HANDOFF_END, -1, NULL);
+    ez_net_close_socket(c);
+}
+
+ez_handoff_t* new_handoff(ez_event_loop_t* eventLoop, const char* path, ezHandoffProc proc, void* clientData)
+{
+    ez_handoff_t* h;
+    int s;
+
+    unlink(path);
+    if ((s = ez_net_unix_server((char*)path, 4)) < 0)
+        return NULL;
+    ez_net_set_closexec(s);
+
+    h = ez_malloc(sizeof(ez_handoff_t));
+    h->loop = eventLoop;
+    h->fd = s;
+    h->peer = -1;
+    h->nlisteners = 0;
+    h->proc = proc;
+    h->clientData = clientData;
+    if (ez_create_file_event(eventLoop, s, AE_READABLE, handoff_accept_proc, h) == AE_ERR) {
+        ez_net_close_socket(s);
+        unlink(path);
+        ez_free(h);
+        return NULL;
+    }
+    return h;
+}
+
+void free_handoff(ez_handoff_t* h)
+{
+    // 不删除 path, 新进程可能已经在同一个 path 上等待下一次交接.
+    if (h == NULL)
+        return;
+    ez_delete_file_event(h->loop, h->fd, AE_READABLE);
+    ez_net_close_socket(h->fd);
+    ez_free(h);
+}
+
+int handoff_add_listener(ez_handoff_t* h, int fd, const char* name)
+{
+    ez_handoff_fd_t* l;
+
+    if (h->nlisteners == HANDOFF_LISTENER_MAX)
+        return ANET_ERR;
+    l = &h->listeners[h->nlisteners++];
+    l->fd = fd;
+    l->type = HANDOFF_LISTENER;
+    memset(l->name, 0, sizeof(l->name));
+    strncpy(l->name, name, HANDOFF_NAME_MAX - 1);
+    return ANET_OK;
+}
+
+int handoff_send_conn(ez_handoff_t* h, int fd, const char* name)
+{
+    if (h->peer < 0)
+        return ANET_ERR;
+    return handoff_send(h->peer, HANDOFF_CONN, fd, name);
+}
+
+int ez_handoff_take(const char* path, ez_handoff_fd_t* fds, int cap)
+{
+    handoff_msg_t msg;
+    int s, fd, n = 0, i;
+
+    if ((s = ez_net_unix_connect(path)) < 0)
+        return ANET_ERR;
+    if (handoff_set_blocking(s) != ANET_OK || handoff_send(s, HANDOFF_TAKE, -1, NULL) != ANET_OK)
+        goto error;
+
+    for (;;) {
+        if (handoff_recv(s, &msg, &fd) != ANET_OK)
+            goto error;
+        if (msg.type == HANDOFF_END)
+            break;
+        if (fd < 0 || (msg.type != HANDOFF_LISTENER && msg.type != HANDOFF_CONN)) {
+            if (fd >= 0)
+                ez_net_close_socket(fd);
+            goto error;
+        }
+        if (n == cap) {
+            log_warn("handoff: no room for %s, closed.", msg.name);
+            ez_net_close_socket(fd);
+            continue;
+        }
+        fds[n].fd = fd;
+        fds[n].type = (int)msg.type;
+        memcpy(fds[n].name, msg.name, HANDOFF_NAME_MAX);
+        n++;
+    }
+    ez_net_close_socket(s);
+    log_info("handoff: took %d fds from %s.", n, path);
+    return n;
+
+error:
+    for (i = 0; i < n; ++i)
+        ez_net_close_socket(fds[i].fd);
+    ez_net_close_socket(s);
+    return ANET_ERR;
+}
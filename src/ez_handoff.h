@@ -0,0 +1,47 @@
+#ifndef EZ_HANDOFF_H
+#define EZ_HANDOFF_H
+
+#include "ez_event.h"
+
+//
+// 重启时通过 unix socket 把监听 socket(以及可选的已有连接)交给新进程.
+// 监听 socket 在两个进程间共享, 已在 backlog 中的连接不会丢失, 重启期间不会拒绝连接.
+//
+// 旧进程: new_handoff 在 path 上等待, handoff_add_listener 登记监听 socket.
+// 新进程: 启动时先 ez_handoff_take(path), 拿不到(没有旧进程)再自己创建监听 socket,
+//         然后同样 new_handoff(path) 等待下一次重启.
+// 旧进程把监听 socket 发出后回调 ezHandoffProc, 回调中可以用 handoff_send_conn 交出已有连接;
+// 回调返回后交接结束, 旧进程应停止 accept, 关闭交出的 fd 并退出.
+//
+#define HANDOFF_NAME_MAX 64
+#define HANDOFF_LISTENER_MAX 32
+#define HANDOFF_IO_TIMEOUT_MS 3000
+
+#define HANDOFF_LISTENER 1
+#define HANDOFF_CONN 2
+
+typedef struct ez_handoff_fd_s {
+    int fd;
+    int type; /* HANDOFF_LISTENER / HANDOFF_CONN */
+    char name[HANDOFF_NAME_MAX];
+} ez_handoff_fd_t;
+
+typedef struct ez_handoff_s ez_handoff_t;
+
+typedef void (*ezHandoffProc)(ez_handoff_t* h, void* clientData);
+
+/* path 已存在时先删除 */
+ez_handoff_t* new_handoff(ez_event_loop_t* eventLoop, const char* path, ezHandoffProc proc, void* clientData);
+
+/* 不会关闭登记的监听 socket */
+void free_handoff(ez_handoff_t* h);
+
+int handoff_add_listener(ez_handoff_t* h, int fd, const char* name);
+
+/* 只能在 ezHandoffProc 中调用. 发出后本进程仍持有 fd, 直接 close 不会影响新进程中的连接 */
+int handoff_send_conn(ez_handoff_t* h, int fd, const char* name);
+
+/* 阻塞地从 path 上的旧进程取 fd, 返回个数(超过 cap 的被关闭), 没有旧进程或出错返回 ANET_ERR */
+int ez_handoff_take(const char* path, ez_handoff_fd_t* fds, int cap);
+
+#endif // EZ_HANDOFF_H
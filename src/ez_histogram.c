@@ -0,0 +1,142 @@
+#include "ez_histogram.h"
+
+#include "ez_malloc.h"
+
+#include <string.h>
+
+/* 小于 2^(sub_bits+1) 的值每个值一个桶, 之后从 2^(sub_bits+1) 开始每个区间 2^sub_bits 个桶 */
+static inline int histogram_bucket(const ez_histogram_t* h, uint64_t val)
+{
+    int s = h->sub_bits, e;
+    uint64_t linear = (uint64_t)2 << s;
+
+    if (val < linear)
+        return (int)val;
+    e = 63 - __builtin_clzll(val);
+    return (int)linear + ((e - s - 1) << s) + (int)((val >> (e - s)) & (((uint64_t)1 << s) - 1));
+}
+
+/* 桶内最大的值 */
+static uint64_t histogram_bucket_high(const ez_histogram_t* h, int b)
+{
+    int s = h->sub_bits, linear = 2 << s, e, sub;
+
+    if (b < linear)
+        return (uint64_t)b;
+    e = ((b - linear) >> s) + s + 1;
+    sub = (b - linear) & ((1 << s) - 1);
+    // 最后一个桶移位后溢出为 0, 减 1 正好是 UINT64_MAX.
+    return (((uint64_t)(1 << s) + (uint64_t)sub + 1) << (e - s)) - 1;
+}
+
+static ez_histogram_t* new_histogram_sub_bits(int sub_bits)
+{
+    ez_histogram_t* h = ez_malloc(sizeof(ez_histogram_t));
+    h->sub_bits = sub_bits;
+    h->nbuckets = (2 << sub_bits) + ((64 - sub_bits - 1) << sub_bits);
+    h->buckets = ez_malloc(sizeof(uint64_t) * h->nbuckets);
+    histogram_reset(h);
+    return h;
+}
+
+ez_histogram_t* new_histogram(void)
+{
+    return new_histogram_sub_bits(HISTOGRAM_SUB_BITS);
+}
+
+ez_histogram_t* new_histogram_digits(int digits)
+{
+    uint64_t n = 1;
+    int sub_bits = 0;
+
+    if (digits < 1)
+        digits = 1;
+    if (digits > HISTOGRAM_DIGITS_MAX)
+        digits = HISTOGRAM_DIGITS_MAX;
+    // 2^sub_bits >= 10^digits
+    while (digits-- > 0)
+        n *= 10;
+    while (((uint64_t)1 << sub_bits) < n)
+        ++sub_bits;
+    return new_histogram_sub_bits(sub_bits);
+}
+
+void free_histogram(ez_histogram_t* h)
+{
+    ez_free(h->buckets);
+    ez_free(h);
+}
+
+void histogram_reset(ez_histogram_t* h)
+{
+    memset(h->buckets, 0, sizeof(uint64_t) * h->nbuckets);
+    h->count = 0;
+    h->sum = 0;
+    h->min = UINT64_MAX;
+    h->max = 0;
+}
+
+void histogram_add(ez_histogram_t* h, uint64_t val)
+{
+    h->buckets[histogram_bucket(h, val)]++;
+    h->count++;
+    h->sum += val;
+    if (val < h->min)
+        h->min = val;
+    if (val > h->max)
+        h->max = val;
+}
+
+int histogram_merge(ez_histogram_t* dst, const ez_histogram_t* src)
+{
+    int i;
+
+    if (dst->sub_bits != src->sub_bits)
+        return -1;
+    if (src->count == 0)
+        return 0;
+    for (i = 0; i < dst->nbuckets; ++i)
+        dst->buckets[i] += src->buckets[i];
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+    return 0;
+}
+
+uint64_t histogram_percentile(const ez_histogram_t* h, double p)
+{
+    uint64_t rank, seen = 0, high;
+    int i;
+
+    if (h->count == 0)
+        return 0;
+    if (p <= 0)
+        return h->min;
+    if (p >= 100)
+        return h->max;
+
+    rank = (uint64_t)(p / 100.0 * (double)h->count + 0.5);
+    if (rank == 0)
+        rank = 1;
+    for (i = 0; i < h->nbuckets; ++i) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            high = histogram_bucket_high(h, i);
+            return high > h->max ? h->max : high;
+        }
+    }
+    return h->max;
+}
+
+uint64_t histogram_mean(const ez_histogram_t* h)
+{
+    return h->count == 0 ? 0 : h->sum / h->count;
+}
+
+double histogram_error(const ez_histogram_t* h)
+{
+    return 1.0 / (double)(1 << h->sub_bits);
+}
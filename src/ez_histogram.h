@@ -0,0 +1,47 @@
+#ifndef EZ_HISTOGRAM_H
+#define EZ_HISTOGRAM_H
+
+#include <stdint.h>
+
+//
+// 对数分桶的直方图(HDR 式), 记录 uint64 的数值(延时 us, 字节数等).
+// 每个 2 的幂区间分 2^sub_bits 个等宽的桶, 相对误差 < 2^-sub_bits; 小于 2^(sub_bits+1) 的值精确记录.
+// 桶在创建时一次分配, 之后记录不再分配内存; 精度相同的直方图可以直接合并.
+//
+#define HISTOGRAM_SUB_BITS 3 /* new_histogram 的精度: 每个区间 8 个桶, 误差 < 12.5%, 496 个桶 */
+#define HISTOGRAM_DIGITS_MAX 3
+
+typedef struct ez_histogram_s {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    int sub_bits;
+    int nbuckets;
+    uint64_t* buckets;
+} ez_histogram_t;
+
+ez_histogram_t* new_histogram(void);
+
+/* digits 位有效数字(1~HISTOGRAM_DIGITS_MAX), 相对误差 < 10^-digits.
+   3 位时每个区间 1024 个桶(误差 < 0.1%), 约 440KB; 用于延时分位数这类要看尾部的统计. */
+ez_histogram_t* new_histogram_digits(int digits);
+
+void free_histogram(ez_histogram_t* h);
+
+void histogram_reset(ez_histogram_t* h);
+
+void histogram_add(ez_histogram_t* h, uint64_t val);
+
+/* dst += src, 精度不同时返回 -1 */
+int histogram_merge(ez_histogram_t* dst, const ez_histogram_t* src);
+
+/* p in [0, 100], 返回所在桶的上界(不超过 max), 偏大不超过 histogram_error; 没有数据返回 0 */
+uint64_t histogram_percentile(const ez_histogram_t* h, double p);
+
+uint64_t histogram_mean(const ez_histogram_t* h);
+
+/* 分位数的最大相对误差, 如 0.125 */
+double histogram_error(const ez_histogram_t* h);
+
+#endif // EZ_HISTOGRAM_H
@@ -0,0 +1,503 @@
+#include "ez_http.h"
+
+#include "ez_net.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/types.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define HTTP_BODY_DONE 0
+#define HTTP_BODY_LENGTH 1
+#define HTTP_BODY_EOF 2 /* 读到连接关闭 */
+#define HTTP_BODY_CHUNK_SIZE 3
+#define HTTP_BODY_CHUNK_DATA 4
+#define HTTP_BODY_CHUNK_CRLF 5
+#define HTTP_BODY_TRAILER 6
+
+// =====================================================================
+// 扫描
+
+/* 在 p[from, n) 中找头部结束的 "\r\n\r\n", 返回头部长度; 找不到返回 0 */
+static inline size_t http_find_header_end(const char* p, size_t from, size_t n)
+{
+    size_t i = from;
+#if defined(__SSE2__)
+    const __m128i lf = _mm_set1_epi8('\n');
+    unsigned mask;
+
+    // 找 '\n', 再往回看是不是 "\r\n\r\n" 的结尾; 头部里 '\n' 很稀疏.
+    for (; i + 16 <= n; i += 16) {
+        mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i)), lf));
+        while (mask != 0) {
+            size_t j = i + (size_t)__builtin_ctz(mask);
+            if (j >= 3 && p[j - 1] == '\r' && p[j - 2] == '\n' && p[j - 3] == '\r')
+                return j + 1;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        if (p[i] == '\n' && i >= 3 && p[i - 1] == '\r' && p[i - 2] == '\n' && p[i - 3] == '\r')
+            return i + 1;
+    }
+    return 0;
+}
+
+/* 返回 [p, end) 中第一个控制字符(HT 除外)的位置, 没有返回 end */
+static inline const char* http_find_ctl(const char* p, const char* end)
+{
+    uint8_t c;
+#if defined(__SSE2__)
+    const __m128i lim = _mm_set1_epi8(0x1f);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    const __m128i tab = _mm_set1_epi8('\t');
+    __m128i v, ctl;
+    unsigned mask;
+
+    // c <= 0x1f 等价于 min(c, 0x1f) == c, 按无符号比较, 不会误伤 0x80 以上的字节.
+    for (; end - p >= 16; p += 16) {
+        v = _mm_loadu_si128((const __m128i*)p);
+        ctl = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, lim), v), _mm_cmpeq_epi8(v, del));
+        mask = (unsigned)_mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(v, tab), ctl));
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+    }
+#endif
+    for (; p < end; ++p) {
+        c = (uint8_t)*p;
+        if ((c < 0x20 && c != '\t') || c == 0x7f)
+            return p;
+    }
+    return end;
+}
+
+/* RFC 7230 的 tchar */
+static inline int http_is_tchar(uint8_t c)
+{
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+        return 1;
+    switch (c) {
+    case '!':
+    case '#':
+    case '$':
+    case '%':
+    case '&':
+    case '\'':
+    case '*':
+    case '+':
+    case '-':
+    case '.':
+    case '^':
+    case '_':
+    case '`':
+    case '|':
+    case '~':
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static inline int http_name_is(const ez_http_header_t* h, const char* name, size_t len)
+{
+    return h->name_len == len && strncasecmp(h->name, name, len) == 0;
+}
+
+/* 逗号分隔的值里是否有 token(不区分大小写) */
+static int http_has_token(const char* v, size_t len, const char* token)
+{
+    size_t tlen = strlen(token), i = 0, s, e;
+
+    while (i < len) {
+        while (i < len && (v[i] == ' ' || v[i] == '\t' || v[i] == ','))
+            ++i;
+        s = i;
+        while (i < len && v[i] != ',')
+            ++i;
+        e = i;
+        while (e > s && (v[e - 1] == ' ' || v[e - 1] == '\t'))
+            --e;
+        if (e - s == tlen && strncasecmp(v + s, token, tlen) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/* 最后一个 token 是不是 chunked */
+static int http_last_token_chunked(const char* v, size_t len)
+{
+    size_t e = len, s;
+
+    while (e > 0 && (v[e - 1] == ' ' || v[e - 1] == '\t'))
+        --e;
+    s = e;
+    while (s > 0 && v[s - 1] != ',' && v[s - 1] != ' ' && v[s - 1] != '\t')
+        --s;
+    return e - s == 7 && strncasecmp(v + s, "chunked", 7) == 0;
+}
+
+static int http_parse_length(const char* v, size_t len, int64_t* val)
+{
+    int64_t x = 0;
+    size_t i;
+
+    if (len == 0 || len > 18)
+        return ANET_ERR;
+    for (i = 0; i < len; ++i) {
+        if (v[i] < '0' || v[i] > '9')
+            return ANET_ERR;
+        x = x * 10 + (v[i] - '0');
+    }
+    *val = x;
+    return ANET_OK;
+}
+
+// =====================================================================
+// 头部
+void http_parser_init(ez_http_parser_t* p, size_t max_header_size)
+{
+    p->max_header_size = max_header_size;
+    p->scanned = 0;
+}
+
+/* "HTTP/1.x" */
+static const char* http_parse_version(const char* p, const char* end, int* minor)
+{
+    if (end - p < 8 || memcmp(p, "HTTP/1.", 7) != 0 || p[7] < '0' || p[7] > '9')
+        return NULL;
+    *minor = p[7] - '0';
+    return p + 8;
+}
+
+/* 解析从 p 开始的头部行, 直到空行; 返回 body 的开始 */
+static const char* http_parse_headers(const char* p, const char* end, ez_http_msg_t* msg)
+{
+    ez_http_header_t* h;
+    const char* q;
+
+    msg->num_headers = 0;
+    for (;;) {
+        if (end - p < 2)
+            return NULL;
+        if (p[0] == '\r')
+            return p[1] == '\n' ? p + 2 : NULL;
+        // 不支持折行(obs-fold), RFC 7230 允许直接拒绝.
+        if (msg->num_headers == HTTP_HEADERS_MAX)
+            return NULL;
+        h = &msg->headers[msg->num_headers];
+        h->name = p;
+        while (p < end && http_is_tchar((uint8_t)*p))
+            ++p;
+        h->name_len = (size_t)(p - h->name);
+        if (h->name_len == 0 || p == end || *p != ':')
+            return NULL;
+        ++p;
+        while (p < end && (*p == ' ' || *p == '\t'))
+            ++p;
+        q = http_find_ctl(p, end);
+        if (end - q < 2 || q[0] != '\r' || q[1] != '\n')
+            return NULL;
+        h->value = p;
+        p = q + 2;
+        while (q > h->value && (q[-1] == ' ' || q[-1] == '\t'))
+            --q;
+        h->value_len = (size_t)(q - h->value);
+        msg->num_headers++;
+    }
+}
+
+/* Content-Length/Transfer-Encoding/Connection */
+static int http_parse_semantics(ez_http_msg_t* msg, int is_request)
+{
+    const ez_http_header_t* h;
+    int64_t len;
+    int close = 0, keep = 0, te = 0, smuggle = 0, i;
+
+    msg->content_length = -1;
+    msg->chunked = 0;
+    for (i = 0; i < msg->num_headers; ++i) {
+        h = &msg->headers[i];
+        if (http_name_is(h, "content-length", 14)) {
+            // 重复的 Content-Length 值必须一致, 防止请求走私.
+            if (http_parse_length(h->value, h->value_len, &len) != ANET_OK)
+                return ANET_ERR;
+            if (msg->content_length >= 0 && msg->content_length != len)
+                return ANET_ERR;
+            msg->content_length = len;
+        } else if (http_name_is(h, "transfer-encoding", 17)) {
+            te = 1;
+            msg->chunked = http_last_token_chunked(h->value, h->value_len);
+        } else if (http_name_is(h, "connection", 10)) {
+            close |= http_has_token(h->value, h->value_len, "close");
+            keep |= http_has_token(h->value, h->value_len, "keep-alive");
+        }
+    }
+    // 请求的 Transfer-Encoding 最后不是 chunked 时无法确定长度(RFC 7230 3.3.3).
+    if (is_request && te && !msg->chunked)
+        return ANET_ERR;
+    // 两者都有时以 chunked 为准; 可能是请求走私, 请求处理完必须关闭连接(RFC 7230 3.3.3).
+    if (msg->chunked) {
+        smuggle = is_request && msg->content_length >= 0;
+        msg->content_length = -1;
+    }
+    msg->keep_alive = (msg->minor_version >= 1 ? !close : keep && !close) && !smuggle;
+    return ANET_OK;
+}
+
+/* 等头部收齐, 返回头部长度; 没收齐返回 0, 超长返回 -1 */
+static ssize_t http_wait_header(ez_http_parser_t* p, bytebuf_t* in)
+{
+    const char* base;
+    size_t n, hlen;
+
+    // 消息之间多余的空行(RFC 7230 3.5).
+    if (p->scanned == 0) {
+        while (bytebuf_readable_size(in) >= 2 && in->data[in->r] == '\r' && in->data[in->r + 1] == '\n')
+            in->r += 2;
+    }
+    base = (const char*)bytebuf_reader_pos(in);
+    n = bytebuf_readable_size(in);
+    hlen = http_find_header_end(base, p->scanned, n);
+    if (hlen == 0) {
+        p->scanned = n;
+        return n > p->max_header_size ? -1 : 0;
+    }
+    p->scanned = 0;
+    return hlen > p->max_header_size ? -1 : (ssize_t)hlen;
+}
+
+int http_parse_request(ez_http_parser_t* p, bytebuf_t* in, ez_http_msg_t* msg)
+{
+    const char *s, *end;
+    ssize_t hlen;
+
+    hlen = http_wait_header(p, in);
+    if (hlen <= 0)
+        return hlen == 0 ? ANET_EAGAIN : ANET_ERR;
+    s = (const char*)bytebuf_reader_pos(in);
+    end = s + hlen;
+
+    // method SP request-target SP HTTP-version CRLF
+    msg->method = s;
+    while (s < end && http_is_tchar((uint8_t)*s))
+        ++s;
+    msg->method_len = (size_t)(s - msg->method);
+    if (msg->method_len == 0 || *s != ' ')
+        return ANET_ERR;
+    msg->path = ++s;
+    while (s < end && (uint8_t)*s > ' ' && *s != 0x7f)
+        ++s;
+    msg->path_len = (size_t)(s - msg->path);
+    if (msg->path_len == 0 || *s != ' ')
+        return ANET_ERR;
+    s = http_parse_version(s + 1, end, &msg->minor_version);
+    if (s == NULL || end - s < 2 || s[0] != '\r' || s[1] != '\n')
+        return ANET_ERR;
+    msg->status = 0;
+    msg->reason = NULL;
+    msg->reason_len = 0;
+
+    if (http_parse_headers(s + 2, end, msg) == NULL || http_parse_semantics(msg, 1) != ANET_OK)
+        return ANET_ERR;
+    msg->header_len = (size_t)hlen;
+    in->r += (uint32_t)hlen;
+    return ANET_OK;
+}
+
+int http_parse_response(ez_http_parser_t* p, bytebuf_t* in, ez_http_msg_t* msg)
+{
+    const char *s, *end, *q;
+    ssize_t hlen;
+
+    hlen = http_wait_header(p, in);
+    if (hlen <= 0)
+        return hlen == 0 ? ANET_EAGAIN : ANET_ERR;
+    s = (const char*)bytebuf_reader_pos(in);
+    end = s + hlen;
+
+    // HTTP-version SP status-code SP reason-phrase CRLF, reason 可以为空
+    s = http_parse_version(s, end, &msg->minor_version);
+    if (s == NULL || end - s < 6 || s[0] != ' ' || s[1] < '1' || s[1] > '9' || s[2] < '0' || s[2] > '9'
+        || s[3] < '0' || s[3] > '9')
+        return ANET_ERR;
+    msg->status = (s[1] - '0') * 100 + (s[2] - '0') * 10 + (s[3] - '0');
+    s += 4;
+    if (*s == ' ')
+        ++s;
+    q = http_find_ctl(s, end);
+    if (end - q < 2 || q[0] != '\r' || q[1] != '\n')
+        return ANET_ERR;
+    msg->reason = s;
+    msg->reason_len = (size_t)(q - s);
+    msg->method = NULL;
+    msg->method_len = 0;
+    msg->path = NULL;
+    msg->path_len = 0;
+
+    if (http_parse_headers(q + 2, end, msg) == NULL || http_parse_semantics(msg, 0) != ANET_OK)
+        return ANET_ERR;
+    // 没有长度的响应读到连接关闭, 不能复用连接.
+    if (!msg->chunked && msg->content_length < 0 && msg->status >= 200 && msg->status != 204 && msg->status != 304)
+        msg->keep_alive = 0;
+    msg->header_len = (size_t)hlen;
+    in->r += (uint32_t)hlen;
+    return ANET_OK;
+}
+
+const ez_http_header_t* http_find_header(const ez_http_msg_t* msg, const char* name)
+{
+    size_t len = strlen(name);
+    int i;
+
+    for (i = 0; i < msg->num_headers; ++i) {
+        if (http_name_is(&msg->headers[i], name, len))
+            return &msg->headers[i];
+    }
+    return NULL;
+}
+
+// =====================================================================
+// body
+void http_body_init(ez_http_body_t* b, const ez_http_msg_t* msg, int is_request)
+{
+    b->remain = 0;
+    if (!is_request && (msg->status < 200 || msg->status == 204 || msg->status == 304)) {
+        b->state = HTTP_BODY_DONE;
+    } else if (msg->chunked) {
+        b->state = HTTP_BODY_CHUNK_SIZE;
+    } else if (msg->content_length > 0) {
+        b->state = HTTP_BODY_LENGTH;
+        b->remain = msg->content_length;
+    } else if (msg->content_length == 0 || is_request) {
+        b->state = HTTP_BODY_DONE;
+    } else {
+        b->state = HTTP_BODY_EOF;
+        b->remain = -1;
+    }
+}
+
+/* chunk 长度行或 trailer 行的长度(不含 \r\n); 没收齐返回 -1, 超长返回 -2 */
+static ssize_t http_chunk_line(bytebuf_t* in)
+{
+    const char* s = (const char*)bytebuf_reader_pos(in);
+    size_t n = bytebuf_readable_size(in);
+    const char* lf = memchr(s, '\n', n < HTTP_CHUNK_LINE_MAX ? n : HTTP_CHUNK_LINE_MAX);
+
+    if (lf == NULL)
+        return n >= HTTP_CHUNK_LINE_MAX ? -2 : -1;
+    if (lf == s || lf[-1] != '\r')
+        return -2;
+    return lf - 1 - s;
+}
+
+/* "1a;ext=x" */
+static int http_parse_chunk_size(const char* s, size_t len, int64_t* size)
+{
+    int64_t x = 0;
+    size_t i;
+    int d;
+
+    for (i = 0; i < len; ++i) {
+        if (s[i] >= '0' && s[i] <= '9')
+            d = s[i] - '0';
+        else if ((s[i] | 0x20) >= 'a' && (s[i] | 0x20) <= 'f')
+            d = (s[i] | 0x20) - 'a' + 10;
+        else
+            break;
+        if (i == 15)
+            return ANET_ERR;
+        x = x * 16 + d;
+    }
+    if (i == 0 || (i < len && s[i] != ';' && s[i] != ' ' && s[i] != '\t'))
+        return ANET_ERR;
+    *size = x;
+    return ANET_OK;
+}
+
+int http_body_next(ez_http_body_t* b, bytebuf_t* in, ez_http_slice_t* data)
+{
+    size_t avail;
+    ssize_t line;
+
+    for (;;) {
+        avail = bytebuf_readable_size(in);
+        switch (b->state) {
+        case HTTP_BODY_DONE:
+            return HTTP_BODY_END;
+
+        case HTTP_BODY_LENGTH:
+        case HTTP_BODY_CHUNK_DATA:
+        case HTTP_BODY_EOF:
+            if (avail == 0)
+                return ANET_EAGAIN;
+            if (b->remain >= 0 && (int64_t)avail > b->remain)
+                avail = (size_t)b->remain;
+            data->data = (const char*)bytebuf_reader_pos(in);
+            data->len = avail;
+            in->r += (uint32_t)avail;
+            if (b->remain >= 0) {
+                b->remain -= (int64_t)avail;
+                if (b->remain == 0)
+                    b->state = b->state == HTTP_BODY_LENGTH ? HTTP_BODY_DONE : HTTP_BODY_CHUNK_CRLF;
+            }
+            return ANET_OK;
+
+        case HTTP_BODY_CHUNK_CRLF:
+            if (avail < 2)
+                return ANET_EAGAIN;
+            if (in->data[in->r] != '\r' || in->data[in->r + 1] != '\n')
+                return ANET_ERR;
+            in->r += 2;
+            b->state = HTTP_BODY_CHUNK_SIZE;
+            break;
+
+        case HTTP_BODY_CHUNK_SIZE:
+            line = http_chunk_line(in);
+            if (line < 0)
+                return line == -1 ? ANET_EAGAIN : ANET_ERR;
+            if (http_parse_chunk_size((const char*)bytebuf_reader_pos(in), (size_t)line, &b->remain) != ANET_OK)
+                return ANET_ERR;
+            in->r += (uint32_t)line + 2;
+            b->state = b->remain == 0 ? HTTP_BODY_TRAILER : HTTP_BODY_CHUNK_DATA;
+            break;
+
+        case HTTP_BODY_TRAILER:
+            // trailer 行直接丢弃, 空行结束.
+            line = http_chunk_line(in);
+            if (line < 0)
+                return line == -1 ? ANET_EAGAIN : ANET_ERR;
+            in->r += (uint32_t)line + 2;
+            if (line == 0) {
+                b->state = HTTP_BODY_DONE;
+                return HTTP_BODY_END;
+            }
+            break;
+
+        default:
+            return ANET_ERR;
+        }
+    }
+}
+
+// =====================================================================
+int http_write_response(bytebuf_t* out, int status, const char* reason, const char* content_type,
+    const void* body, size_t len, int keep_alive)
+{
+    size_t need = strlen(reason) + strlen(content_type) + len + 128;
+    int n;
+
+    if (bytebuf_ensure_writable(out, need) != 0)
+        return ANET_ERR;
+    n = snprintf((char*)bytebuf_writer_pos(out), bytebuf_writeable_size(out),
+        "HTTP/1.1 %03d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: %s\r\n\r\n", status, reason,
+        content_type, len, keep_alive ? "keep-alive" : "close");
+    out->w += (uint32_t)n;
+    memcpy(bytebuf_writer_pos(out), body, len);
+    out->w += (uint32_t)len;
+    return ANET_OK;
+}
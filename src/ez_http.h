@@ -0,0 +1,87 @@
+#ifndef EZ_HTTP_H
+#define EZ_HTTP_H
+
+#include "ez_bytebuf.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// HTTP/1.x 请求/响应的增量解析.
+// 头部收齐(\r\n\r\n)之前返回 ANET_EAGAIN, 不移动 in->r, 已扫描过的字节下次不再扫描;
+// 收齐后一遍解析完, 方法/路径/头部都直接指向输入 bytebuf, 不拷贝, 下次往 bytebuf 读入前有效.
+// body 用 ez_http_body_t 按 Content-Length 或 chunked 逐段取出, 一个连接上可以流水线多个请求.
+//
+#define HTTP_HEADERS_MAX 64
+#define HTTP_CHUNK_LINE_MAX 1024 /* chunk 长度行和 trailer 行的最大长度 */
+
+#define HTTP_BODY_END 1 /* http_body_next: body 已结束 */
+
+typedef struct ez_http_header_s {
+    const char* name;
+    size_t name_len;
+    const char* value;
+    size_t value_len;
+} ez_http_header_t;
+
+typedef struct ez_http_msg_s {
+    // 请求行
+    const char* method;
+    size_t method_len;
+    const char* path;
+    size_t path_len;
+    // 状态行
+    int status;
+    const char* reason;
+    size_t reason_len;
+
+    int minor_version; /* HTTP/1.x 的 x */
+    int num_headers;
+    ez_http_header_t headers[HTTP_HEADERS_MAX];
+
+    int64_t content_length; /* 没有 Content-Length 为 -1 */
+    int chunked;
+    int keep_alive;
+    size_t header_len; /* 整个头部(含最后的空行)的字节数 */
+} ez_http_msg_t;
+
+/* 每个连接一个, 可以直接嵌在连接的结构里 */
+typedef struct ez_http_parser_s {
+    size_t max_header_size;
+    size_t scanned; /* 已确认不含头部结束标记的字节数, 相对 in->r */
+} ez_http_parser_t;
+
+typedef struct ez_http_body_s {
+    int state;
+    int64_t remain; /* Content-Length 或当前 chunk 剩余的字节, -1 为读到连接关闭 */
+} ez_http_body_t;
+
+typedef struct ez_http_slice_s {
+    const char* data;
+    size_t len;
+} ez_http_slice_t;
+
+void http_parser_init(ez_http_parser_t* p, size_t max_header_size);
+
+/* 解析请求/响应的头部, 成功后 in->r 指向 body. 返回 ANET_OK;
+   头部不完整返回 ANET_EAGAIN; 格式错误或头部超过 max_header_size 返回 ANET_ERR */
+int http_parse_request(ez_http_parser_t* p, bytebuf_t* in, ez_http_msg_t* msg);
+int http_parse_response(ez_http_parser_t* p, bytebuf_t* in, ez_http_msg_t* msg);
+
+/* 按名字(不区分大小写)找头部, 没有返回 NULL */
+const ez_http_header_t* http_find_header(const ez_http_msg_t* msg, const char* name);
+
+/* 按 msg 的 Content-Length/chunked 初始化 body 解码. is_request 时没有长度的 body 为空,
+   响应没有长度则读到连接关闭 */
+void http_body_init(ez_http_body_t* b, const ez_http_msg_t* msg, int is_request);
+
+/* 取出下一段 body 并推进 in->r, chunked 的长度行和 trailer 直接跳过.
+   返回 ANET_OK(data 指向输入 bytebuf); body 结束返回 HTTP_BODY_END, in->r 指向下一个消息;
+   数据不够返回 ANET_EAGAIN; 格式错误返回 ANET_ERR */
+int http_body_next(ez_http_body_t* b, bytebuf_t* in, ez_http_slice_t* data);
+
+/* 写一个带 Content-Length 的完整响应, 空间不够时扩容; out 不能扩容且空间不够时返回 ANET_ERR */
+int http_write_response(bytebuf_t* out, int status, const char* reason, const char* content_type,
+    const void* body, size_t len, int keep_alive);
+
+#endif // EZ_HTTP_H
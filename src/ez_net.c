@@ -10,9 +10,12 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
 #include <stdio.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 
@@ -80,7 +83,7 @@ static int ez_net_listen(int s, int backlog)
     return ANET_OK;
 }
 
-static int _ez_net_tcp_server(int port, char* bindaddr, int af, int backlog)
+static int _ez_net_server(int port, char* bindaddr, int af, int socktype, int backlog, int tfo_qlen)
 {
     int s, rv;
     char _port[7]; /* strlen("65535") */
@@ -91,7 +94,7 @@ static int _ez_net_tcp_server(int port, char* bindaddr, int af, int backlog)
 
     memset(&hints, 0, sizeof(hints));
     hints.ai_family = af; // AF_INET, AF_INET6, AF_UNIX, AF_LOCAL
-    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_socktype = socktype; // SOCK_STREAM, SOCK_DGRAM
     hints.ai_flags = AI_PASSIVE; /* No effect if bindaddr != NULL */
 
     if ((rv = getaddrinfo(bindaddr, _port, &hints, &servinfo)) != 0) {
@@ -114,13 +117,16 @@ static int _ez_net_tcp_server(int port, char* bindaddr, int af, int backlog)
             goto error;
         if (ez_net_bind(s, p->ai_addr, p->ai_addrlen) == ANET_ERR)
             goto error;
-        if (ez_net_listen(s, backlog) == ANET_ERR)
+        // 内核不支持时仍可以作为普通 server 使用.
+        if (tfo_qlen > 0 && ez_net_set_tcp_fastopen(s, tfo_qlen) == ANET_ERR)
+            log_warn("%d > tcp fastopen disabled.", s);
+        if (socktype == SOCK_STREAM && ez_net_listen(s, backlog) == ANET_ERR)
             goto error;
         goto end;
     }
 
     if (p == NULL) {
-        log_error("unable create TcpServer.");
+        log_error("unable create %s server.", socket_socktype_name(socktype));
         goto error;
     }
 
@@ -160,12 +166,32 @@ int ez_net_unix_server(char* path, int backlog)
 
 int ez_net_tcp_server(int port, char* bindaddr, int backlog)
 {
-    return _ez_net_tcp_server(port, bindaddr, AF_INET, backlog);
+    return _ez_net_server(port, bindaddr, AF_INET, SOCK_STREAM, backlog, 0);
 }
 
 int ez_net_tcp6_server(int port, char* bindaddr, int backlog)
 {
-    return _ez_net_tcp_server(port, bindaddr, AF_INET6, backlog);
+    return _ez_net_server(port, bindaddr, AF_INET6, SOCK_STREAM, backlog, 0);
+}
+
+int ez_net_tcp_fastopen_server(int port, char* bindaddr, int backlog, int qlen)
+{
+    return _ez_net_server(port, bindaddr, AF_INET, SOCK_STREAM, backlog, qlen);
+}
+
+int ez_net_tcp6_fastopen_server(int port, char* bindaddr, int backlog, int qlen)
+{
+    return _ez_net_server(port, bindaddr, AF_INET6, SOCK_STREAM, backlog, qlen);
+}
+
+int ez_net_udp_server(int port, char* bindaddr)
+{
+    return _ez_net_server(port, bindaddr, AF_INET, SOCK_DGRAM, 0, 0);
+}
+
+int ez_net_udp6_server(int port, char* bindaddr)
+{
+    return _ez_net_server(port, bindaddr, AF_INET6, SOCK_DGRAM, 0, 0);
 }
 
 static int ez_net_tcp_generic_accept(int s, struct sockaddr* sa, socklen_t* len)
@@ -261,6 +287,7 @@ int ez_net_close_socket(int s)
 /* create client */
 #define ANET_CONNECT_NONE 0
 #define ANET_CONNECT_NONBLOCK 1
+#define ANET_CONNECT_DGRAM 2
 
 static int ez_net_unix_connect_ex(const char* path, int flags)
 {
@@ -320,7 +347,7 @@ static int ez_net_tcp_connect_ex(const char* addr, int port, int flags)
 
     memset(&hints, 0, sizeof(hints));
     hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_socktype = (flags & ANET_CONNECT_DGRAM) ? SOCK_DGRAM : SOCK_STREAM;
 
     if ((rv = getaddrinfo(addr, portstr, &hints, &servinfo)) != 0) {
         log_error("%s", gai_strerror(rv));
@@ -383,6 +410,56 @@ int ez_net_tcp_connect_non_block(const char* addr, int port)
     return ez_net_tcp_connect_ex(addr, port, ANET_CONNECT_NONBLOCK);
 }
 
+int ez_net_udp_connect(const char* addr, int port)
+{
+    return ez_net_tcp_connect_ex(addr, port, ANET_CONNECT_NONBLOCK | ANET_CONNECT_DGRAM);
+}
+
+int ez_net_tcp_fastopen_connect(const char* addr, int port, const char* data, size_t len, ssize_t* nbytes)
+{
+    int s = ANET_ERR, rv;
+    ssize_t r;
+    char portstr[6]; /* strlen("65535") + 1; */
+    struct addrinfo hints, *servinfo, *p;
+
+    *nbytes = 0;
+    snprintf(portstr, sizeof(portstr), "%d", port);
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if ((rv = getaddrinfo(addr, portstr, &hints, &servinfo)) != 0) {
+        log_error("%s", gai_strerror(rv));
+        return ANET_ERR;
+    }
+    for (p = servinfo; p != NULL; p = p->ai_next) {
+        if ((s = socket(p->ai_family, p->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, p->ai_protocol)) == -1)
+            continue;
+
+        // sendto + MSG_FASTOPEN 同时完成 connect 和发送:
+        // 有 cookie 时数据随 SYN 发出, 否则只发带 cookie 请求的 SYN, 返回 EINPROGRESS.
+        r = sendto(s, data, len, MSG_FASTOPEN | MSG_NOSIGNAL, p->ai_addr, p->ai_addrlen);
+        if (r >= 0) {
+            *nbytes = r;
+            goto end;
+        }
+        if (errno == EINPROGRESS)
+            goto end;
+        if (errno == EOPNOTSUPP || errno == EPIPE) {
+            // 本机关闭了 client 端 fastopen, 退回普通 connect.
+            if (connect(s, p->ai_addr, p->ai_addrlen) == 0 || errno == EINPROGRESS)
+                goto end;
+        }
+        log_error("fastopen connect to %s:%d failed, cause:[%s]!", addr, port, strerror(errno));
+        ez_net_close_socket(s);
+        s = ANET_ERR;
+    }
+
+end:
+    freeaddrinfo(servinfo);
+    return s;
+}
+
 /* socket option */
 int ez_net_set_send_buf_size(int fd, int bufsize)
 {
@@ -458,6 +535,80 @@ int ez_net_set_reuse_port(int fd)
     return ANET_OK;
 }
 
+int ez_net_set_zerocopy(int fd)
+{
+    int yes = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &yes, sizeof(yes)) == -1) {
+        log_error("setsockopt SO_ZEROCOPY: %s", strerror(errno));
+        return ANET_ERR;
+    }
+    return ANET_OK;
+}
+
+int ez_net_set_udp_segment(int fd, int gso_size)
+{
+    if (setsockopt(fd, SOL_UDP, UDP_SEGMENT, &gso_size, sizeof(gso_size)) == -1) {
+        log_error("setsockopt UDP_SEGMENT: %s", strerror(errno));
+        return ANET_ERR;
+    }
+    return ANET_OK;
+}
+
+int ez_net_set_udp_gro(int fd, int val)
+{
+    if (setsockopt(fd, SOL_UDP, UDP_GRO, &val, sizeof(val)) == -1) {
+        log_error("setsockopt UDP_GRO: %s", strerror(errno));
+        return ANET_ERR;
+    }
+    return ANET_OK;
+}
+
+int ez_net_set_tcp_fastopen(int fd, int qlen)
+{
+    if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen)) == -1) {
+        log_error("setsockopt TCP_FASTOPEN: %s", strerror(errno));
+        return ANET_ERR;
+    }
+    return ANET_OK;
+}
+
+int ez_net_set_tcp_fastopen_connect(int fd, int val)
+{
+    if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &val, sizeof(val)) == -1) {
+        log_error("setsockopt TCP_FASTOPEN_CONNECT: %s", strerror(errno));
+        return ANET_ERR;
+    }
+    return ANET_OK;
+}
+
+int ez_net_set_notsent_lowat(int fd, int bytes)
+{
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &bytes, sizeof(bytes)) == -1) {
+        log_error("setsockopt TCP_NOTSENT_LOWAT: %s", strerror(errno));
+        return ANET_ERR;
+    }
+    return ANET_OK;
+}
+
+static int ez_net_set_tcp_cork(int fd, int val)
+{
+    if (setsockopt(fd, IPPROTO_TCP, TCP_CORK, &val, sizeof(val)) == -1) {
+        log_error("setsockopt TCP_CORK: %s", strerror(errno));
+        return ANET_ERR;
+    }
+    return ANET_OK;
+}
+
+int ez_net_cork(int fd)
+{
+    return ez_net_set_tcp_cork(fd, 1);
+}
+
+int ez_net_uncork(int fd)
+{
+    return ez_net_set_tcp_cork(fd, 0);
+}
+
 int ez_net_set_reuse_addr(int fd)
 {
     int yes = 1;
@@ -591,14 +742,8 @@ int ez_net_read(int fd, char* buf, size_t bufsize, ssize_t* nbytes)
 {
     int ezerrno;
     ssize_t r = read(fd, buf, bufsize);
-    if (r == 0) {
-        *nbytes = 0;
-        ezerrno = errno;
-        if (ezerrno == EAGAIN || ezerrno == EINTR)
-            return ANET_EAGAIN; // 才能继续读
-        else
-            return ANET_OK;
-    } else if (r > 0) {
+    if (r >= 0) {
+        // r == 0 时 errno 未被设置, 不能据此判断 EAGAIN; read 返回 0 即对端关闭.
         *nbytes = r;
         return ANET_OK;
     } else {
@@ -617,14 +762,7 @@ int ez_net_write(int fd, char* buf, size_t bufsize, ssize_t* nbytes)
 {
     int ezerrno;
     ssize_t r = write(fd, buf, bufsize);
-    if (r == 0) {
-        *nbytes = 0;
-        ezerrno = errno;
-        if (ezerrno == EAGAIN || ezerrno == EINTR)
-            return ANET_EAGAIN; // 才能继续写
-        else
-            return ANET_OK;
-    } else if (r > 0) {
+    if (r >= 0) {
         *nbytes = r;
         return ANET_OK;
     } else {
@@ -668,6 +806,44 @@ int ez_net_peer_name(int fd, char* ip, size_t ip_len, int* port)
     return 0;
 }
 
+/* glibc 的 struct tcp_info 只到 tcpi_total_retrans, 后面的字段按内核布局补上 */
+struct ez_tcp_info_ext {
+    struct tcp_info base;
+    uint64_t tcpi_pacing_rate;
+    uint64_t tcpi_max_pacing_rate;
+    uint64_t tcpi_bytes_acked;
+    uint64_t tcpi_bytes_received;
+    uint32_t tcpi_segs_out;
+    uint32_t tcpi_segs_in;
+    uint32_t tcpi_notsent_bytes;
+    uint32_t tcpi_min_rtt;
+    uint32_t tcpi_data_segs_in;
+    uint32_t tcpi_data_segs_out;
+    uint64_t tcpi_delivery_rate;
+};
+
+int ez_net_tcp_info(int fd, ez_tcp_info_t* info)
+{
+    struct ez_tcp_info_ext ti;
+    socklen_t len = sizeof(ti);
+
+    memset(&ti, 0, sizeof(ti));
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &ti, &len) == -1)
+        return ANET_ERR;
+
+    // 老内核返回的长度较短, 没有的字段保持为 0.
+    info->rtt_us = ti.base.tcpi_rtt;
+    info->rttvar_us = ti.base.tcpi_rttvar;
+    info->min_rtt_us = ti.tcpi_min_rtt;
+    info->snd_cwnd = ti.base.tcpi_snd_cwnd;
+    info->snd_mss = ti.base.tcpi_snd_mss;
+    info->retransmits = ti.base.tcpi_retransmits;
+    info->total_retrans = ti.base.tcpi_total_retrans;
+    info->notsent_bytes = ti.tcpi_notsent_bytes;
+    info->delivery_rate = ti.tcpi_delivery_rate;
+    return ANET_OK;
+}
+
 int ez_net_socket_name(int fd, char* ip, size_t ip_len, int* port)
 {
     struct sockaddr_storage sa;
@@ -698,8 +874,42 @@ int ez_net_socket_name(int fd, char* ip, size_t ip_len, int* port)
     return 0;
 }
 
+/* 环形 bytebuf 的可读/可写区最多两段, 一次 readv/writev */
+static int ez_net_read_ring(int fd, bytebuf_t* buf, ssize_t* nbytes)
+{
+    struct iovec iov[2];
+    int cnt = bytebuf_ring_writeable_iov(buf, iov);
+    int r;
+
+    *nbytes = 0;
+    // 环满了: readv 0 段会返回 0, 被当成对端关闭.
+    if (cnt == 0)
+        return ANET_EAGAIN;
+    r = ez_net_readv(fd, iov, cnt, nbytes);
+    if (r == ANET_OK)
+        bytebuf_ring_produce(buf, (size_t)*nbytes);
+    return r;
+}
+
+static int ez_net_write_ring(int fd, bytebuf_t* buf, ssize_t* nbytes)
+{
+    struct iovec iov[2];
+    int cnt = bytebuf_ring_readable_iov(buf, iov);
+    int r;
+
+    *nbytes = 0;
+    if (cnt == 0)
+        return ANET_OK;
+    r = ez_net_writev(fd, iov, cnt, nbytes);
+    if (r == ANET_OK)
+        bytebuf_ring_consume(buf, (size_t)*nbytes);
+    return r;
+}
+
 int ez_net_read_bf(int fd, bytebuf_t* buf, ssize_t* nbytes)
 {
+    if (buf->flags & BYTEBUF_F_RING)
+        return ez_net_read_ring(fd, buf, nbytes);
     size_t size = bytebuf_writeable_size(buf);
     uint8_t* p = bytebuf_writer_pos(buf);
     *nbytes = 0;
@@ -712,6 +922,8 @@ int ez_net_read_bf(int fd, bytebuf_t* buf, ssize_t* nbytes)
 
 int ez_net_write_bf(int fd, bytebuf_t* buf, ssize_t* nbytes)
 {
+    if (buf->flags & BYTEBUF_F_RING)
+        return ez_net_write_ring(fd, buf, nbytes);
     size_t size = bytebuf_readable_size(buf);
     uint8_t* p = bytebuf_reader_pos(buf);
     *nbytes = 0;
@@ -720,4 +932,216 @@ int ez_net_write_bf(int fd, bytebuf_t* buf, ssize_t* nbytes)
         buf->r += *nbytes;
     }
     return r;
-}
\ No newline at end of file
+}
+/* NonBlock net_readv & net_writev */
+static int ez_net_rw_result(ssize_t r, ssize_t* nbytes)
+{
+    int ezerrno;
+    if (r >= 0) {
+        *nbytes = r;
+        return ANET_OK;
+    }
+    *nbytes = 0;
+    ezerrno = errno;
+    // linux define EWOULDBLOCK EAGAIN.
+    if (ezerrno == EAGAIN || ezerrno == EINTR)
+        return ANET_EAGAIN; /* 非阻塞模式 */
+    else
+        return ANET_ERR;
+}
+
+int ez_net_readv(int fd, const struct iovec* iov, int iovcnt, ssize_t* nbytes)
+{
+    return ez_net_rw_result(readv(fd, iov, iovcnt), nbytes);
+}
+
+int ez_net_writev(int fd, const struct iovec* iov, int iovcnt, ssize_t* nbytes)
+{
+    return ez_net_rw_result(writev(fd, iov, iovcnt), nbytes);
+}
+
+int ez_net_write_more(int fd, char* buf, size_t bufsize, ssize_t* nbytes)
+{
+    return ez_net_rw_result(send(fd, buf, bufsize, MSG_MORE | MSG_NOSIGNAL), nbytes);
+}
+
+int ez_net_writev_more(int fd, const struct iovec* iov, int iovcnt, ssize_t* nbytes)
+{
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec*)iov;
+    msg.msg_iovlen = (size_t)iovcnt;
+    return ez_net_rw_result(sendmsg(fd, &msg, MSG_MORE | MSG_NOSIGNAL), nbytes);
+}
+
+int ez_net_send_fds(int fd, const int* fds, int nfds, const void* buf, size_t len, ssize_t* nbytes)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    char ctrl[CMSG_SPACE(sizeof(int) * ANET_FDS_MAX)];
+    struct cmsghdr* cmsg;
+
+    *nbytes = 0;
+    if (nfds > ANET_FDS_MAX || len == 0)
+        return ANET_ERR;
+
+    // SCM_RIGHTS 必须附带至少一个字节的普通数据.
+    iov.iov_base = (void*)buf;
+    iov.iov_len = len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (nfds > 0) {
+        memset(ctrl, 0, sizeof(ctrl));
+        msg.msg_control = ctrl;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+    }
+    return ez_net_rw_result(sendmsg(fd, &msg, MSG_NOSIGNAL), nbytes);
+}
+
+int ez_net_recv_fds(int fd, int* fds, int* nfds, void* buf, size_t len, ssize_t* nbytes)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    char ctrl[CMSG_SPACE(sizeof(int) * ANET_FDS_MAX)];
+    struct cmsghdr* cmsg;
+    int cap = *nfds, n = 0, i, r;
+
+    *nfds = 0;
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+
+    r = ez_net_rw_result(recvmsg(fd, &msg, MSG_CMSG_CLOEXEC), nbytes);
+    if (r != ANET_OK)
+        return r;
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+        int cnt = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        int* p = (int*)CMSG_DATA(cmsg);
+        for (i = 0; i < cnt; ++i) {
+            // 放不下的 fd 也已经进了本进程, 要关掉.
+            if (n < cap)
+                fds[n++] = p[i];
+            else
+                ez_net_close_socket(p[i]);
+        }
+    }
+    *nfds = n;
+    if (msg.msg_flags & MSG_CTRUNC) {
+        log_error("recv fds: control message truncated.");
+        for (i = 0; i < n; ++i)
+            ez_net_close_socket(fds[i]);
+        *nfds = 0;
+        return ANET_ERR;
+    }
+    return ANET_OK;
+}
+
+int ez_net_readv_bf(int fd, bytebuf_t** bufs, int cnt, ssize_t* nbytes)
+{
+    struct iovec iov[ANET_IOV_MAX];
+    int i, r;
+    size_t left, len;
+
+    *nbytes = 0;
+    if (cnt > ANET_IOV_MAX)
+        cnt = ANET_IOV_MAX;
+    for (i = 0, len = 0; i < cnt; ++i) {
+        iov[i].iov_base = bytebuf_writer_pos(bufs[i]);
+        iov[i].iov_len = bytebuf_writeable_size(bufs[i]);
+        len += iov[i].iov_len;
+    }
+    // 没有可写空间时 readv 返回 0, 和对端关闭分不开.
+    if (len == 0)
+        return ANET_EAGAIN;
+
+    r = ez_net_readv(fd, iov, cnt, nbytes);
+    if (r == ANET_OK) {
+        // 依次填满各 buf.
+        left = (size_t)*nbytes;
+        for (i = 0; i < cnt && left > 0; ++i) {
+            len = bytebuf_writeable_size(bufs[i]);
+            if (len > left)
+                len = left;
+            bufs[i]->w += len;
+            left -= len;
+        }
+    }
+    return r;
+}
+
+static int ez_net_writev_bf_ex(int fd, bytebuf_t** bufs, int cnt, int more, ssize_t* nbytes)
+{
+    struct iovec iov[ANET_IOV_MAX];
+    int i, n = 0, r;
+    size_t left, len;
+
+    *nbytes = 0;
+    if (cnt > ANET_IOV_MAX)
+        cnt = ANET_IOV_MAX;
+    for (i = 0; i < cnt; ++i) {
+        if (!bytebuf_is_readable(bufs[i]))
+            continue;
+        iov[n].iov_base = bytebuf_reader_pos(bufs[i]);
+        iov[n].iov_len = bytebuf_readable_size(bufs[i]);
+        ++n;
+    }
+    if (n == 0)
+        return ANET_OK;
+
+    r = more ? ez_net_writev_more(fd, iov, n, nbytes) : ez_net_writev(fd, iov, n, nbytes);
+    if (r == ANET_OK) {
+        // 依次消费各 buf, 最后一个可能只写出一部分.
+        left = (size_t)*nbytes;
+        for (i = 0; i < cnt && left > 0; ++i) {
+            len = bytebuf_readable_size(bufs[i]);
+            if (len > left)
+                len = left;
+            bufs[i]->r += len;
+            left -= len;
+        }
+    }
+    return r;
+}
+
+int ez_net_writev_bf(int fd, bytebuf_t** bufs, int cnt, ssize_t* nbytes)
+{
+    return ez_net_writev_bf_ex(fd, bufs, cnt, 0, nbytes);
+}
+
+int ez_net_writev_bf_more(int fd, bytebuf_t** bufs, int cnt, ssize_t* nbytes)
+{
+    return ez_net_writev_bf_ex(fd, bufs, cnt, 1, nbytes);
+}
+
+int ez_net_sendfile(int out_fd, int in_fd, off_t* offset, size_t count, ssize_t* nbytes)
+{
+    return ez_net_rw_result(sendfile(out_fd, in_fd, offset, count), nbytes);
+}
+
+int ez_net_splice(int in_fd, int out_fd, size_t len, ssize_t* nbytes)
+{
+    return ez_net_rw_result(splice(in_fd, NULL, out_fd, NULL, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK), nbytes);
+}
+
+int ez_net_write_zerocopy(int fd, char* buf, size_t bufsize, ssize_t* nbytes)
+{
+    int r = ez_net_rw_result(send(fd, buf, bufsize, MSG_ZEROCOPY | MSG_NOSIGNAL), nbytes);
+    // 内核 optmem 不足以 pin 住页时返回 ENOBUFS, 同 EAGAIN 稍后重试.
+    if (r == ANET_ERR && errno == ENOBUFS)
+        return ANET_EAGAIN;
+    return r;
+}
@@ -5,6 +5,7 @@
 #include "ez_bytebuf.h"
 
 #include <unistd.h>
+#include <sys/uio.h>
 
 #define ANET_OK 0
 #define ANET_ERR -1
@@ -19,6 +20,15 @@ int ez_net_tcp_server(int port, char* bindaddr, int backlog);
 int ez_net_tcp6_server(int port, char* bindaddr, int backlog);
 int ez_net_unix_server(char* path, int backlog);
 
+/* 开启 TCP_FASTOPEN 的 server, qlen 为未完成三次握手的 fastopen 请求队列长度.
+   需要 sysctl net.ipv4.tcp_fastopen 打开 server 端(0x2), 内核不支持时退化为普通 server. */
+int ez_net_tcp_fastopen_server(int port, char* bindaddr, int backlog, int qlen);
+int ez_net_tcp6_fastopen_server(int port, char* bindaddr, int backlog, int qlen);
+
+/* 非阻塞 udp socket, 批量收发见 ez_udp.h */
+int ez_net_udp_server(int port, char* bindaddr);
+int ez_net_udp6_server(int port, char* bindaddr);
+
 /* 标准的accept模式 */
 #define ANET_EMEN_FILE -ENFILE
 
@@ -38,6 +48,14 @@ int ez_net_tcp_connect(const char* addr, int port);
 
 int ez_net_tcp_connect_non_block(const char* addr, int port);
 
+/* 非阻塞 connect 并用 MSG_FASTOPEN 发送 data, 返回 fd.
+   nbytes 为随 SYN 发出(或已进入发送缓冲)的字节数; 没有 cookie 时为 0,
+   剩余数据要等 fd 可写(连接建立)后再发送. */
+int ez_net_tcp_fastopen_connect(const char* addr, int port, const char* data, size_t len, ssize_t* nbytes);
+
+/* 非阻塞且已 connect 的 udp socket */
+int ez_net_udp_connect(const char* addr, int port);
+
 /* NonBlock net_read & net_write
    @return ANET_EAGAIN:(非阻塞模式)读写已经执行, 读写字节数在nbytes
    @return ANET_ERR   :读写错误
@@ -46,9 +64,49 @@ int ez_net_tcp_connect_non_block(const char* addr, int port);
 int ez_net_read(int fd, char* buf, size_t bufsize, ssize_t* nbytes);
 int ez_net_write(int fd, char* buf, size_t bufsize, ssize_t* nbytes);
 
+/* 读到 buf 的可写区 / 写出 buf 的可读区; 环形 bytebuf 回绕的两段用一次 readv/writev.
+   环形 buf 满了时 read 返回 ANET_EAGAIN, 不会读到 0 字节被当成对端关闭 */
 int ez_net_read_bf(int fd, bytebuf_t* buf, ssize_t* nbytes);
 int ez_net_write_bf(int fd, bytebuf_t* buf, ssize_t* nbytes);
 
+/* NonBlock scatter/gather (readv/writev), 返回值同 ez_net_read/ez_net_write.
+   _bf 版本一次系统调用处理 bufs[0..cnt), 部分读写时按顺序推进各 buf 的 w/r.
+   cnt 最多 ANET_IOV_MAX 个.
+ */
+#define ANET_IOV_MAX 64
+
+int ez_net_readv(int fd, const struct iovec* iov, int iovcnt, ssize_t* nbytes);
+int ez_net_writev(int fd, const struct iovec* iov, int iovcnt, ssize_t* nbytes);
+
+int ez_net_readv_bf(int fd, bytebuf_t** bufs, int cnt, ssize_t* nbytes);
+int ez_net_writev_bf(int fd, bytebuf_t** bufs, int cnt, ssize_t* nbytes);
+
+/* 带 MSG_MORE 的写, 只能用于 socket: 告诉内核后面还有数据, 先不要发出不满 MSS 的报文.
+   最后一段要用普通写(或 ez_net_uncork)发出. 返回值同 ez_net_write. */
+int ez_net_write_more(int fd, char* buf, size_t bufsize, ssize_t* nbytes);
+int ez_net_writev_more(int fd, const struct iovec* iov, int iovcnt, ssize_t* nbytes);
+int ez_net_writev_bf_more(int fd, bytebuf_t** bufs, int cnt, ssize_t* nbytes);
+
+/* NonBlock zero-copy, 返回值同 ez_net_read/ez_net_write, nbytes=0 表示输入已到 EOF.
+   ez_net_sendfile: 文件 in_fd 从 *offset 起发送到 out_fd, 并推进 *offset.
+   ez_net_splice  : in_fd/out_fd 至少一个是 pipe.
+ */
+int ez_net_sendfile(int out_fd, int in_fd, off_t* offset, size_t count, ssize_t* nbytes);
+int ez_net_splice(int in_fd, int out_fd, size_t len, ssize_t* nbytes);
+
+/* MSG_ZEROCOPY 发送, 需先 ez_net_set_zerocopy(fd).
+   返回值同 ez_net_write, 发送成功后 buf 在内核完成通知前不能修改或释放(见 ez_zerocopy.h).
+ */
+int ez_net_write_zerocopy(int fd, char* buf, size_t bufsize, ssize_t* nbytes);
+
+/* 通过 unix socket 传递 fd(SCM_RIGHTS), 每条消息附带 buf 中 len(>0) 字节的数据.
+   ez_net_recv_fds: *nfds 传入 fds 的容量, 返回收到的个数, 收到的 fd 带 FD_CLOEXEC.
+   返回值同 ez_net_write/ez_net_read. */
+#define ANET_FDS_MAX 64
+
+int ez_net_send_fds(int fd, const int* fds, int nfds, const void* buf, size_t len, ssize_t* nbytes);
+int ez_net_recv_fds(int fd, int* fds, int* nfds, void* buf, size_t len, ssize_t* nbytes);
+
 /* socket option */
 int ez_net_set_send_buf_size(int fd, int bufsize);
 int ez_net_set_recv_buf_size(int fd, int bufsize);
@@ -57,17 +115,51 @@ int ez_net_set_non_block(int fd);
 int ez_net_set_closexec(int fd);
 int ez_net_set_reuse_addr(int fd);
 int ez_net_set_reuse_port(int fd);
+int ez_net_set_zerocopy(int fd);
+
+/* server: listen 前设置 fastopen 队列长度; client: connect 前设置后,
+   connect 立即返回, 第一次 write 的数据随 SYN 发出 */
+int ez_net_set_tcp_fastopen(int fd, int qlen);
+int ez_net_set_tcp_fastopen_connect(int fd, int val);
+
+/* udp 分段卸载: UDP_SEGMENT 为 socket 默认的 GSO 分段大小(0 关闭), UDP_GRO 接收合并后的报文 */
+int ez_net_set_udp_segment(int fd, int gso_size);
+int ez_net_set_udp_gro(int fd, int val);
 
 int ez_net_set_tcp_nodelay(int fd, int val);
 #define ez_net_tcp_enable_nodelay(fd) (ez_net_set_tcp_nodelay(fd, 1))
 #define ez_net_tcp_disable_nodelay(fd) (ez_net_set_tcp_nodelay(fd, 0))
 
+/* TCP_NOTSENT_LOWAT: 发送缓冲中未发出的数据低于 bytes 时 socket 才可写,
+   数据留在应用自己的队列中, 还能调整顺序. */
+int ez_net_set_notsent_lowat(int fd, int bytes);
+
+/* TCP_CORK: cork 期间只发满 MSS 的报文, uncork 时发出剩余部分(内核最多 cork 200ms) */
+int ez_net_cork(int fd);
+int ez_net_uncork(int fd);
+
 int ez_net_tcp_keepalive(int fd, int interval);
 int ez_net_set_ipv6_only(int fd);
 
 /* get socket's peer connected client ip port info */
 int ez_net_peer_name(int fd, char* ip, size_t ip_len, int* port);
 
+/* TCP_INFO 中常用的指标 */
+typedef struct ez_tcp_info_s {
+    uint32_t rtt_us; /* 平滑 RTT */
+    uint32_t rttvar_us;
+    uint32_t min_rtt_us;
+    uint32_t snd_cwnd; /* 拥塞窗口, 单位 MSS */
+    uint32_t snd_mss;
+    uint32_t retransmits; /* 当前未确认数据的超时重传次数 */
+    uint32_t total_retrans; /* 连接建立以来的重传段数 */
+    uint32_t notsent_bytes; /* 发送缓冲中还没发出的字节 */
+    uint64_t delivery_rate; /* 最近的交付速率 bytes/s */
+} ez_tcp_info_t;
+
+/* 非 tcp socket 返回 ANET_ERR */
+int ez_net_tcp_info(int fd, ez_tcp_info_t* info);
+
 /** get socket's address ip port info */
 int ez_net_socket_name(int fd, char* ip, size_t ip_len, int* port);
 
@@ -0,0 +1,249 @@
+#include "ez_ratelimit.h"
+
+#include "ez_macro.h"
+#include "ez_malloc.h"
+#include "ez_util.h"
+
+#include <string.h>
+
+#define RATELIMIT_INIT_CAP 1024 /* power of 2 */
+#define RATELIMIT_SWEEP_MS 100
+#define RATELIMIT_SWEEP_MIN 4096 /* 每次清除至少检查的槽数 */
+
+/* key 表的一项, key 为 0 表示空槽 */
+typedef struct rl_entry_s {
+    uint64_t key;
+    ez_token_bucket_t b;
+} rl_entry_t;
+
+struct ez_ratelimit_s {
+    ez_event_loop_t* loop;
+    int64_t rate; /* 每秒 rate 个令牌, 正好是每毫秒 rate 个 1/1000 令牌 */
+    int64_t cap; /* burst * 1000 */
+    rl_entry_t* table; /* 线性探测的开放地址表 */
+    size_t mask;
+    size_t count;
+    size_t sweep_pos;
+    int64_t sweep_id;
+};
+
+static inline int64_t rl_now(ez_ratelimit_t* rl)
+{
+    return rl->loop != NULL ? ez_event_loop_now(rl->loop) : mstime();
+}
+
+static inline size_t rl_hash(uint64_t key)
+{
+    key *= 0x9E3779B97F4A7C15ull;
+    return (size_t)(key ^ (key >> 32));
+}
+
+/* 补上 last_ms 之后的令牌 */
+static inline void rl_refill(ez_ratelimit_t* rl, ez_token_bucket_t* b, int64_t now)
+{
+    int64_t elapsed = now - b->last_ms;
+
+    b->last_ms = now;
+    // 时钟回拨时只更新 last_ms.
+    if (elapsed <= 0 || b->tokens >= rl->cap)
+        return;
+    // 先比较, 避免 elapsed * rate 溢出.
+    if (elapsed > (rl->cap - b->tokens) / rl->rate)
+        b->tokens = rl->cap;
+    else
+        b->tokens += elapsed * rl->rate;
+}
+
+static inline int64_t rl_wait_ms(ez_ratelimit_t* rl, int64_t deficit)
+{
+    return (deficit + rl->rate - 1) / rl->rate;
+}
+
+static int64_t rl_take(ez_ratelimit_t* rl, ez_token_bucket_t* b, uint64_t n, int64_t now)
+{
+    int64_t need = (int64_t)n * 1000;
+
+    if (need > rl->cap)
+        return -1;
+    rl_refill(rl, b, now);
+    if (b->tokens >= need) {
+        b->tokens -= need;
+        return 0;
+    }
+    return rl_wait_ms(rl, need - b->tokens);
+}
+
+static int64_t rl_charge(ez_ratelimit_t* rl, ez_token_bucket_t* b, uint64_t n, int64_t now)
+{
+    rl_refill(rl, b, now);
+    b->tokens -= (int64_t)n * 1000;
+    return b->tokens >= 0 ? 0 : rl_wait_ms(rl, -b->tokens);
+}
+
+// =====================================================================
+// key 表
+static void rl_table_resize(ez_ratelimit_t* rl, size_t cap)
+{
+    rl_entry_t* old = rl->table;
+    size_t old_cap = rl->table == NULL ? 0 : rl->mask + 1;
+    size_t i, j;
+
+    rl->table = ez_malloc(sizeof(rl_entry_t) * cap);
+    memset(rl->table, 0, sizeof(rl_entry_t) * cap);
+    rl->mask = cap - 1;
+    rl->sweep_pos = 0;
+    for (i = 0; i < old_cap; ++i) {
+        if (old[i].key == 0)
+            continue;
+        for (j = rl_hash(old[i].key) & rl->mask; rl->table[j].key != 0; j = (j + 1) & rl->mask)
+            ;
+        rl->table[j] = old[i];
+    }
+    if (old != NULL)
+        ez_free(old);
+}
+
+static ez_token_bucket_t* rl_table_get(ez_ratelimit_t* rl, uint64_t key, int64_t now)
+{
+    size_t i;
+
+    // 负载不超过 1/2, 探测链保持很短.
+    if ((rl->count + 1) * 2 > rl->mask + 1)
+        rl_table_resize(rl, (rl->mask + 1) * 2);
+    for (i = rl_hash(key) & rl->mask; rl->table[i].key != 0; i = (i + 1) & rl->mask) {
+        if (rl->table[i].key == key)
+            return &rl->table[i].b;
+    }
+    rl->table[i].key = key;
+    rl->table[i].b.tokens = rl->cap;
+    rl->table[i].b.last_ms = now;
+    rl->count++;
+    return &rl->table[i].b;
+}
+
+/* 删除 i 处的项, 把后面探测链上的项往前移, 不需要墓碑 */
+static void rl_table_remove(ez_ratelimit_t* rl, size_t i)
+{
+    size_t j = i, k;
+
+    for (;;) {
+        j = (j + 1) & rl->mask;
+        if (rl->table[j].key == 0)
+            break;
+        k = rl_hash(rl->table[j].key) & rl->mask;
+        // k 在循环区间 (i, j] 内的项不能移到 i.
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        rl->table[i] = rl->table[j];
+        i = j;
+    }
+    rl->table[i].key = 0;
+    rl->count--;
+}
+
+/* 从 sweep_pos 开始检查 n 个槽, 清除已补满的 key */
+static size_t rl_table_sweep(ez_ratelimit_t* rl, size_t n, int64_t now)
+{
+    size_t removed = 0;
+    rl_entry_t* e;
+
+    // 删除后原地重查不计入 n, 每次删除 count 减一, 循环一定会结束.
+    while (n > 0 && rl->count > 0) {
+        e = &rl->table[rl->sweep_pos];
+        if (e->key != 0) {
+            rl_refill(rl, &e->b, now);
+            if (e->b.tokens >= rl->cap) {
+                // 补满的桶和不存在一样; 删除后后面的项可能移到这里.
+                rl_table_remove(rl, rl->sweep_pos);
+                removed++;
+                continue;
+            }
+        }
+        rl->sweep_pos = (rl->sweep_pos + 1) & rl->mask;
+        n--;
+    }
+    return removed;
+}
+
+static int rl_sweep_proc(ez_event_loop_t* eventLoop, int64_t timeId, void* clientData)
+{
+    ez_ratelimit_t* rl = (ez_ratelimit_t*)clientData;
+    size_t n = (rl->mask + 1) / 16;
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(timeId);
+
+    // 分批检查, 表很大时也不会长时间占用事件循环.
+    if (n < RATELIMIT_SWEEP_MIN)
+        n = RATELIMIT_SWEEP_MIN;
+    if (n > rl->mask + 1)
+        n = rl->mask + 1;
+    rl_table_sweep(rl, n, rl_now(rl));
+    return AE_TIMER_NEXT;
+}
+
+// =====================================================================
+ez_ratelimit_t* new_ratelimit(ez_event_loop_t* eventLoop, uint64_t rate, uint64_t burst)
+{
+    ez_ratelimit_t* rl;
+
+    if (rate == 0 || burst == 0)
+        return NULL;
+    rl = ez_malloc(sizeof(ez_ratelimit_t));
+    rl->loop = eventLoop;
+    rl->rate = (int64_t)rate;
+    rl->cap = (int64_t)burst * 1000;
+    rl->table = NULL;
+    rl->count = 0;
+    rl_table_resize(rl, RATELIMIT_INIT_CAP);
+    rl->sweep_id = eventLoop != NULL ? ez_create_time_event(eventLoop, RATELIMIT_SWEEP_MS, rl_sweep_proc, rl) : -1;
+    return rl;
+}
+
+void free_ratelimit(ez_ratelimit_t* rl)
+{
+    if (rl == NULL)
+        return;
+    if (rl->sweep_id >= 0)
+        ez_delete_time_event(rl->loop, rl->sweep_id);
+    ez_free(rl->table);
+    ez_free(rl);
+}
+
+void ratelimit_init_bucket(ez_ratelimit_t* rl, ez_token_bucket_t* b)
+{
+    b->tokens = rl->cap;
+    b->last_ms = rl_now(rl);
+}
+
+int64_t ratelimit_take(ez_ratelimit_t* rl, ez_token_bucket_t* b, uint64_t n)
+{
+    return rl_take(rl, b, n, rl_now(rl));
+}
+
+int64_t ratelimit_charge(ez_ratelimit_t* rl, ez_token_bucket_t* b, uint64_t n)
+{
+    return rl_charge(rl, b, n, rl_now(rl));
+}
+
+int64_t ratelimit_take_key(ez_ratelimit_t* rl, uint64_t key, uint64_t n)
+{
+    int64_t now = rl_now(rl);
+    return rl_take(rl, rl_table_get(rl, key, now), n, now);
+}
+
+int64_t ratelimit_charge_key(ez_ratelimit_t* rl, uint64_t key, uint64_t n)
+{
+    int64_t now = rl_now(rl);
+    return rl_charge(rl, rl_table_get(rl, key, now), n, now);
+}
+
+size_t ratelimit_key_count(ez_ratelimit_t* rl)
+{
+    return rl->count;
+}
+
+size_t ratelimit_expire(ez_ratelimit_t* rl)
+{
+    rl->sweep_pos = 0;
+    return rl_table_sweep(rl, rl->mask + 1, rl_now(rl));
+}
@@ -0,0 +1,46 @@
+#ifndef EZ_RATELIMIT_H
+#define EZ_RATELIMIT_H
+
+#include "ez_event.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// 令牌桶限速. 桶只有 16 字节, 不用定时器补充令牌: 每次取令牌时按事件循环的缓存时钟
+// 补上距上次的部分, 所以空闲的桶没有任何开销.
+// 速率和容量由 ez_ratelimit_t 统一配置; 桶可以嵌在调用方自己的结构里(如每个连接一个),
+// 也可以按 64 位 key(如客户端 IP)放在 ez_ratelimit_t 内部的表中, 已经补满的 key 会被定期清除.
+//
+typedef struct ez_ratelimit_s ez_ratelimit_t;
+
+typedef struct ez_token_bucket_s {
+    int64_t tokens; /* 单位为 1/1000 个令牌, 欠账时为负 */
+    int64_t last_ms;
+} ez_token_bucket_t;
+
+/* 每秒补充 rate 个令牌, 最多存 burst 个. loop 为 NULL 时直接用 mstime(), 也不清除 key */
+ez_ratelimit_t* new_ratelimit(ez_event_loop_t* eventLoop, uint64_t rate, uint64_t burst);
+
+void free_ratelimit(ez_ratelimit_t* rl);
+
+/* 桶初始为满 */
+void ratelimit_init_bucket(ez_ratelimit_t* rl, ez_token_bucket_t* b);
+
+/* 取 n 个令牌: 够则扣除并返回 0; 不够时不扣除, 返回还需等待的毫秒数; n 超过 burst 返回 -1 */
+int64_t ratelimit_take(ez_ratelimit_t* rl, ez_token_bucket_t* b, uint64_t n);
+
+/* 事后扣除 n 个令牌(如已经读入的字节), 可以欠账; 返回还清欠账需等待的毫秒数, 不欠返回 0 */
+int64_t ratelimit_charge(ez_ratelimit_t* rl, ez_token_bucket_t* b, uint64_t n);
+
+/* 同上, 使用 key 对应的桶, 第一次出现的 key 桶为满. key 不能为 0 */
+int64_t ratelimit_take_key(ez_ratelimit_t* rl, uint64_t key, uint64_t n);
+int64_t ratelimit_charge_key(ez_ratelimit_t* rl, uint64_t key, uint64_t n);
+
+/* 表中 key 的个数 */
+size_t ratelimit_key_count(ez_ratelimit_t* rl);
+
+/* 立即清除所有已补满的 key, 返回清除的个数. 平时由定时器分批清除 */
+size_t ratelimit_expire(ez_ratelimit_t* rl);
+
+#endif // EZ_RATELIMIT_H
@@ -0,0 +1,489 @@
+#include "ez_resp.h"
+
+#include "ez_malloc.h"
+#include "ez_net.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define RESP_ARGV_INIT 16
+
+struct ez_resp_parser_s {
+    uint32_t max_args;
+    uint32_t max_bulk;
+    size_t pos; /* 当前消息已解析的字节, 相对 in->r */
+
+    // 命令
+    int64_t argc; /* 正在解析的命令的参数个数, -1 表示还没解析数组头 */
+    uint32_t argn; /* 已解析的参数 */
+    uint32_t argv_cap;
+    uint32_t* offs; /* 参数相对 in->r 的偏移 */
+    ez_resp_arg_t* argv;
+    int nargs; /* 上一条完整命令的参数个数 */
+
+    // 回复
+    int depth;
+    int64_t remain[RESP_DEPTH_MAX]; /* 每层聚合还差的元素 */
+    int started; /* 已解析出最外层的类型 */
+    int top_type;
+    size_t top_off; /* str 相对 in->r 的偏移, 没有为 SIZE_MAX */
+    uint32_t top_len;
+    int64_t top_int;
+};
+
+// =====================================================================
+// 扫描
+
+/* 在 p[from, n) 中找 "\r\n", 返回 '\r' 的位置, 找不到返回 -1 */
+static inline ssize_t resp_find_crlf(const uint8_t* p, size_t from, size_t n)
+{
+    size_t i = from;
+#if defined(__SSE2__)
+    const __m128i cr = _mm_set1_epi8('\r');
+    unsigned mask;
+
+    // 每次比较 16 字节, 命中的 '\r' 再看下一个字节是不是 '\n'.
+    for (; i + 16 <= n; i += 16) {
+        mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i)), cr));
+        while (mask != 0) {
+            size_t j = i + (size_t)__builtin_ctz(mask);
+            if (j + 1 >= n)
+                return -1;
+            if (p[j + 1] == '\n')
+                return (ssize_t)j;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i + 1 < n; ++i) {
+        if (p[i] == '\r' && p[i + 1] == '\n')
+            return (ssize_t)i;
+    }
+    return -1;
+}
+
+/* 解析 "123\r\n" 这样的整数行, 返回整行长度; 不完整返回 0, 非法返回 -1.
+   长度行都很短, 边扫描边计算, 不另外找 \r\n. */
+static inline ssize_t resp_parse_int_line(const uint8_t* p, size_t n, int64_t* val)
+{
+    size_t i = 0, start;
+    uint64_t v = 0;
+    int neg = 0;
+
+    if (n > 0 && p[0] == '-') {
+        neg = 1;
+        i = 1;
+    }
+    start = i;
+    for (; i < n && p[i] >= '0' && p[i] <= '9'; ++i) {
+        // 最多 19 位, 不会溢出 uint64_t
+        if (i - start == 19)
+            return -1;
+        v = v * 10 + (uint64_t)(p[i] - '0');
+    }
+    if (i == n || (p[i] == '\r' && i + 1 == n))
+        return 0;
+    if (i == start || p[i] != '\r' || p[i + 1] != '\n')
+        return -1;
+    if (v > (uint64_t)INT64_MAX + (uint64_t)neg)
+        return -1;
+    *val = neg ? (int64_t)(0 - v) : (int64_t)v;
+    return (ssize_t)(i + 2);
+}
+
+// =====================================================================
+// parser
+ez_resp_parser_t* new_resp_parser(uint32_t max_args, uint32_t max_bulk)
+{
+    ez_resp_parser_t* p = ez_malloc(sizeof(ez_resp_parser_t));
+    p->max_args = max_args;
+    p->max_bulk = max_bulk;
+    p->argv_cap = RESP_ARGV_INIT;
+    p->offs = ez_malloc(sizeof(uint32_t) * p->argv_cap);
+    p->argv = ez_malloc(sizeof(ez_resp_arg_t) * p->argv_cap);
+    p->nargs = 0;
+    resp_parser_reset(p);
+    return p;
+}
+
+void free_resp_parser(ez_resp_parser_t* p)
+{
+    if (p == NULL)
+        return;
+    ez_free(p->offs);
+    ez_free(p->argv);
+    ez_free(p);
+}
+
+void resp_parser_reset(ez_resp_parser_t* p)
+{
+    p->pos = 0;
+    p->argc = -1;
+    p->argn = 0;
+    p->depth = 0;
+    p->started = 0;
+}
+
+static void resp_argv_reserve(ez_resp_parser_t* p, uint32_t n)
+{
+    if (n <= p->argv_cap)
+        return;
+    while (p->argv_cap < n)
+        p->argv_cap *= 2;
+    p->offs = ez_realloc(p->offs, sizeof(uint32_t) * p->argv_cap);
+    p->argv = ez_realloc(p->argv, sizeof(ez_resp_arg_t) * p->argv_cap);
+}
+
+/* 命令解析完成: 偏移换成指针, 推进 in->r */
+static int resp_command_done(ez_resp_parser_t* p, bytebuf_t* in)
+{
+    const uint8_t* base = bytebuf_reader_pos(in);
+    uint32_t i;
+
+    for (i = 0; i < p->argn; ++i)
+        p->argv[i].data = base + p->offs[i];
+    p->nargs = (int)p->argn;
+    in->r += (uint32_t)p->pos;
+    resp_parser_reset(p);
+    return ANET_OK;
+}
+
+#define RESP_INLINE_EMPTY 1 /* 跳过了一个空行, 接着解析 */
+
+/* telnet 式的命令: 一行, 空格分隔 */
+static int resp_parse_inline(ez_resp_parser_t* p, bytebuf_t* in)
+{
+    const uint8_t* base = bytebuf_reader_pos(in);
+    size_t n = bytebuf_readable_size(in), i = 0, end;
+    ssize_t e;
+
+    e = resp_find_crlf(base, p->pos, n);
+    if (e < 0) {
+        // 下次从这里继续找, 最后一个字节可能是 '\r'.
+        p->pos = n > 0 ? n - 1 : 0;
+        return n > RESP_INLINE_MAX ? ANET_ERR : ANET_EAGAIN;
+    }
+    end = (size_t)e;
+    p->argn = 0;
+    while (i < end) {
+        while (i < end && base[i] == ' ')
+            ++i;
+        if (i == end)
+            break;
+        if (p->argn == p->max_args)
+            return ANET_ERR;
+        resp_argv_reserve(p, p->argn + 1);
+        p->offs[p->argn] = (uint32_t)i;
+        while (i < end && base[i] != ' ')
+            ++i;
+        p->argv[p->argn].len = (uint32_t)(i - p->offs[p->argn]);
+        p->argn++;
+    }
+    p->pos = end + 2;
+    if (p->argn == 0) {
+        // 空行, 跳过; 回到 resp_parse_command 的循环, 连续的空行不能递归
+        in->r += (uint32_t)p->pos;
+        resp_parser_reset(p);
+        return RESP_INLINE_EMPTY;
+    }
+    return resp_command_done(p, in);
+}
+
+int resp_parse_command(ez_resp_parser_t* p, bytebuf_t* in)
+{
+    const uint8_t* base;
+    size_t n, pos, data;
+    int64_t v;
+    ssize_t r;
+    int ret;
+
+    for (;;) {
+        base = bytebuf_reader_pos(in);
+        n = bytebuf_readable_size(in);
+        if (n == 0)
+            return ANET_EAGAIN;
+        if (p->argc >= 0)
+            break;
+        if (base[0] != '*') {
+            ret = resp_parse_inline(p, in);
+            if (ret != RESP_INLINE_EMPTY)
+                return ret;
+            continue;
+        }
+
+        r = resp_parse_int_line(base + 1, n - 1, &v);
+        if (r <= 0)
+            return r == 0 ? ANET_EAGAIN : ANET_ERR;
+        if (v <= 0) {
+            // 空命令, 跳过
+            in->r += (uint32_t)(1 + r);
+            continue;
+        }
+        if (v > p->max_args)
+            return ANET_ERR;
+        resp_argv_reserve(p, (uint32_t)v);
+        p->argc = v;
+        p->argn = 0;
+        p->pos = (size_t)(1 + r);
+    }
+
+    while (p->argn < p->argc) {
+        pos = p->pos;
+        if (pos >= n)
+            return ANET_EAGAIN;
+        if (base[pos] != '$')
+            return ANET_ERR;
+        r = resp_parse_int_line(base + pos + 1, n - pos - 1, &v);
+        if (r <= 0)
+            return r == 0 ? ANET_EAGAIN : ANET_ERR;
+        if (v < 0 || v > p->max_bulk)
+            return ANET_ERR;
+        // bulk 还没到齐时 pos 停在 '$', 下次重新解析这一个短的长度行.
+        data = pos + 1 + (size_t)r;
+        if (n < data + (size_t)v + 2)
+            return ANET_EAGAIN;
+        if (base[data + v] != '\r' || base[data + v + 1] != '\n')
+            return ANET_ERR;
+        p->offs[p->argn] = (uint32_t)data;
+        p->argv[p->argn].len = (uint32_t)v;
+        p->argn++;
+        p->pos = data + (size_t)v + 2;
+    }
+    return resp_command_done(p, in);
+}
+
+int resp_argc(ez_resp_parser_t* p)
+{
+    return p->nargs;
+}
+
+const ez_resp_arg_t* resp_argv(ez_resp_parser_t* p)
+{
+    return p->argv;
+}
+
+/* 记录最外层元素 */
+static inline void resp_set_top(ez_resp_parser_t* p, int type, size_t off, uint32_t len, int64_t integer)
+{
+    if (p->started)
+        return;
+    p->started = 1;
+    p->top_type = type;
+    p->top_off = off;
+    p->top_len = len;
+    p->top_int = integer;
+}
+
+int resp_parse_reply(ez_resp_parser_t* p, bytebuf_t* in, ez_resp_reply_t* reply)
+{
+    const uint8_t* base = bytebuf_reader_pos(in);
+    size_t n = bytebuf_readable_size(in), pos, data, end;
+    int64_t v = 0;
+    ssize_t r, e;
+    int type;
+
+    for (;;) {
+        pos = p->pos;
+        if (pos >= n)
+            return ANET_EAGAIN;
+        type = base[pos];
+
+        switch (type) {
+        case RESP_SIMPLE:
+        case RESP_ERROR:
+        case RESP_INTEGER:
+        case RESP_NULL:
+        case RESP_BOOL:
+        case RESP_DOUBLE:
+        case RESP_BIGNUM:
+            e = resp_find_crlf(base, pos + 1, n);
+            if (e < 0)
+                return n - pos > RESP_INLINE_MAX ? ANET_ERR : ANET_EAGAIN;
+            if (type == RESP_INTEGER && resp_parse_int_line(base + pos + 1, (size_t)e + 2 - pos - 1, &v) <= 0)
+                return ANET_ERR;
+            if (type == RESP_NULL)
+                resp_set_top(p, type, SIZE_MAX, 0, -1);
+            else
+                resp_set_top(p, type, pos + 1, (uint32_t)((size_t)e - pos - 1), type == RESP_INTEGER ? v : 0);
+            end = (size_t)e + 2;
+            break;
+
+        case RESP_BULK:
+        case RESP_BLOB_ERROR:
+        case RESP_VERBATIM:
+            r = resp_parse_int_line(base + pos + 1, n - pos - 1, &v);
+            if (r <= 0)
+                return r == 0 ? ANET_EAGAIN : ANET_ERR;
+            data = pos + 1 + (size_t)r;
+            if (v == -1) {
+                resp_set_top(p, type, SIZE_MAX, 0, -1);
+                end = data;
+                break;
+            }
+            if (v < 0 || v > p->max_bulk)
+                return ANET_ERR;
+            if (n < data + (size_t)v + 2)
+                return ANET_EAGAIN;
+            if (base[data + v] != '\r' || base[data + v + 1] != '\n')
+                return ANET_ERR;
+            resp_set_top(p, type, data, (uint32_t)v, v);
+            end = data + (size_t)v + 2;
+            break;
+
+        case RESP_ARRAY:
+        case RESP_MAP:
+        case RESP_SET:
+        case RESP_PUSH:
+        case RESP_ATTR:
+            r = resp_parse_int_line(base + pos + 1, n - pos - 1, &v);
+            if (r <= 0)
+                return r == 0 ? ANET_EAGAIN : ANET_ERR;
+            if (v < -1)
+                return ANET_ERR;
+            resp_set_top(p, type, SIZE_MAX, 0, v);
+            end = pos + 1 + (size_t)r;
+            if (v <= 0)
+                break;
+            // map/attribute 每项是 key value 两个元素, attribute 后面还跟着真正的回复.
+            if (type == RESP_MAP || type == RESP_ATTR)
+                v *= 2;
+            if (type == RESP_ATTR)
+                v += 1;
+            if (p->depth == RESP_DEPTH_MAX)
+                return ANET_ERR;
+            p->remain[p->depth++] = v;
+            p->pos = end;
+            continue;
+
+        default:
+            return ANET_ERR;
+        }
+
+        p->pos = end;
+        // 一个元素完成, 逐层减少父聚合还差的元素.
+        while (p->depth > 0 && --p->remain[p->depth - 1] == 0)
+            p->depth--;
+        if (p->depth == 0)
+            break;
+    }
+
+    reply->type = p->top_type;
+    reply->raw = base;
+    reply->raw_len = (uint32_t)p->pos;
+    reply->str = p->top_off == SIZE_MAX ? NULL : base + p->top_off;
+    reply->len = p->top_len;
+    reply->integer = p->top_int;
+    in->r += (uint32_t)p->pos;
+    resp_parser_reset(p);
+    return ANET_OK;
+}
+
+// =====================================================================
+// 编码
+#define RESP_INT_LINE_MAX 24 /* "<prefix>-9223372036854775808\r\n" */
+
+/* 写 "<prefix><val>\r\n" */
+static int resp_write_int_line(bytebuf_t* out, char prefix, int64_t val)
+{
+    char tmp[20];
+    uint64_t u = val < 0 ? (uint64_t)0 - (uint64_t)val : (uint64_t)val;
+    int i = (int)sizeof(tmp);
+    size_t n;
+    uint8_t* p;
+
+    do {
+        tmp[--i] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    if (val < 0)
+        tmp[--i] = '-';
+
+    n = sizeof(tmp) - (size_t)i;
+    if (bytebuf_ensure_writable(out, n + 3) != 0)
+        return ANET_ERR;
+    p = bytebuf_writer_pos(out);
+    p[0] = (uint8_t)prefix;
+    memcpy(p + 1, tmp + i, n);
+    p[n + 1] = '\r';
+    p[n + 2] = '\n';
+    out->w += (uint32_t)(n + 3);
+    return ANET_OK;
+}
+
+static int resp_write_line(bytebuf_t* out, char prefix, const char* str)
+{
+    size_t len = strlen(str);
+    uint8_t* p;
+
+    if (bytebuf_ensure_writable(out, len + 3) != 0)
+        return ANET_ERR;
+    p = bytebuf_writer_pos(out);
+    p[0] = (uint8_t)prefix;
+    memcpy(p + 1, str, len);
+    p[len + 1] = '\r';
+    p[len + 2] = '\n';
+    out->w += (uint32_t)(len + 3);
+    return ANET_OK;
+}
+
+int resp_write_simple(bytebuf_t* out, const char* str)
+{
+    return resp_write_line(out, RESP_SIMPLE, str);
+}
+
+int resp_write_error(bytebuf_t* out, const char* str)
+{
+    return resp_write_line(out, RESP_ERROR, str);
+}
+
+int resp_write_integer(bytebuf_t* out, int64_t val)
+{
+    return resp_write_int_line(out, RESP_INTEGER, val);
+}
+
+int resp_write_bulk(bytebuf_t* out, const void* data, size_t len)
+{
+    uint8_t* p;
+
+    // 一次预留整个 bulk, 要么全部写入, 要么什么都不写.
+    if (bytebuf_ensure_writable(out, RESP_INT_LINE_MAX + len + 2) != 0)
+        return ANET_ERR;
+    resp_write_int_line(out, RESP_BULK, (int64_t)len);
+    p = bytebuf_writer_pos(out);
+    memcpy(p, data, len);
+    p[len] = '\r';
+    p[len + 1] = '\n';
+    out->w += (uint32_t)(len + 2);
+    return ANET_OK;
+}
+
+int resp_write_null(bytebuf_t* out)
+{
+    return resp_write_int_line(out, RESP_BULK, -1);
+}
+
+int resp_write_array(bytebuf_t* out, int64_t count)
+{
+    return resp_write_int_line(out, RESP_ARRAY, count);
+}
+
+int resp_write_command(bytebuf_t* out, int argc, const ez_resp_arg_t* argv)
+{
+    // 相对 r 记录, 镜像环形写的中途可能折回下标.
+    uint32_t len = out->w - out->r;
+    int i;
+
+    if (resp_write_array(out, argc) != ANET_OK)
+        return ANET_ERR;
+    for (i = 0; i < argc; ++i) {
+        if (resp_write_bulk(out, argv[i].data, argv[i].len) != ANET_OK) {
+            out->w = out->r + len;
+            return ANET_ERR;
+        }
+    }
+    return ANET_OK;
+}
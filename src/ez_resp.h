@@ -0,0 +1,78 @@
+#ifndef EZ_RESP_H
+#define EZ_RESP_H
+
+#include "ez_bytebuf.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// RESP2/RESP3(redis 协议)的增量解析和编码.
+// 解析结果直接指向输入 bytebuf, 不拷贝; 数据不完整时返回 ANET_EAGAIN, 不移动 in->r,
+// 已解析的部分以相对 in->r 的偏移保存, 下次读入后从断点继续, 不重新扫描.
+// 输入缓冲被前移或扩容(conn_prepare_input)也不影响断点.
+//
+/* 首字节即类型 */
+#define RESP_SIMPLE '+'
+#define RESP_ERROR '-'
+#define RESP_INTEGER ':'
+#define RESP_BULK '$'
+#define RESP_ARRAY '*'
+#define RESP_NULL '_'
+#define RESP_BOOL '#'
+#define RESP_DOUBLE ','
+#define RESP_BIGNUM '('
+#define RESP_BLOB_ERROR '!'
+#define RESP_VERBATIM '='
+#define RESP_MAP '%'
+#define RESP_SET '~'
+#define RESP_PUSH '>'
+#define RESP_ATTR '|'
+
+#define RESP_DEPTH_MAX 16
+#define RESP_INLINE_MAX (64 * 1024) /* 单行(inline 命令, 简单字符串)的最大长度 */
+
+typedef struct ez_resp_parser_s ez_resp_parser_t;
+
+typedef struct ez_resp_arg_s {
+    const uint8_t* data;
+    uint32_t len;
+} ez_resp_arg_t;
+
+/* 一条完整的回复. 指针指向输入 bytebuf, 下次往 bytebuf 读入前有效 */
+typedef struct ez_resp_reply_s {
+    int type; /* RESP_*; RESP_ATTR 时 raw 中包含紧跟的真正回复 */
+    const uint8_t* raw; /* 整条回复的原始字节, 代理可以直接转发 */
+    uint32_t raw_len;
+    const uint8_t* str; /* 字符串类的内容, 其他类型为 NULL */
+    uint32_t len;
+    int64_t integer; /* RESP_INTEGER 的值; 聚合类型的元素个数; null bulk/array 为 -1 */
+} ez_resp_reply_t;
+
+/* max_args: 命令参数个数上限; max_bulk: 单个 bulk 字符串的长度上限 */
+ez_resp_parser_t* new_resp_parser(uint32_t max_args, uint32_t max_bulk);
+void free_resp_parser(ez_resp_parser_t* p);
+
+/* 丢弃解析到一半的消息 */
+void resp_parser_reset(ez_resp_parser_t* p);
+
+/* 解析一条命令(bulk 数组, 或 telnet 式的 inline 命令), 推进 in->r.
+   返回 ANET_OK, 参数用 resp_argc/resp_argv 取; 不完整返回 ANET_EAGAIN; 协议错误返回 ANET_ERR */
+int resp_parse_command(ez_resp_parser_t* p, bytebuf_t* in);
+int resp_argc(ez_resp_parser_t* p);
+const ez_resp_arg_t* resp_argv(ez_resp_parser_t* p);
+
+/* 解析一条回复(任意 RESP2/RESP3 类型, 可以嵌套), 返回值同 resp_parse_command */
+int resp_parse_reply(ez_resp_parser_t* p, bytebuf_t* in, ez_resp_reply_t* reply);
+
+/* 编码, 直接写到 out 末尾, 空间不够时扩容. 返回 ANET_OK;
+   out 不能扩容(BYTEBUF_F_FIXED)且空间不够时返回 ANET_ERR, 不写入任何内容 */
+int resp_write_simple(bytebuf_t* out, const char* str);
+int resp_write_error(bytebuf_t* out, const char* str);
+int resp_write_integer(bytebuf_t* out, int64_t val);
+int resp_write_bulk(bytebuf_t* out, const void* data, size_t len);
+int resp_write_null(bytebuf_t* out); /* RESP2 的 null bulk: $-1 */
+int resp_write_array(bytebuf_t* out, int64_t count);
+int resp_write_command(bytebuf_t* out, int argc, const ez_resp_arg_t* argv);
+
+#endif // EZ_RESP_H
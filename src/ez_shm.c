@@ -0,0 +1,333 @@
+#include "ez_shm.h"
+
+#include "ez_log.h"
+#include "ez_macro.h"
+#include "ez_malloc.h"
+#include "ez_net.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SHM_MAGIC 0x657a7368u /* "ezsh" */
+#define SHM_CACHELINE 64
+#define SHM_RING_MIN 4096
+
+/* 读写索引分在不同的 cache line, 避免两端互相失效 */
+typedef struct shm_ring_s {
+    uint64_t head; /* 写端推进 */
+    uint8_t pad0[SHM_CACHELINE - sizeof(uint64_t)];
+    uint64_t tail; /* 读端推进 */
+    uint8_t pad1[SHM_CACHELINE - sizeof(uint64_t)];
+    uint32_t reader_waiting; /* 读端读空后在等门铃 */
+    uint32_t writer_waiting; /* 写端写满后在等门铃 */
+    uint32_t closed; /* 写端已关闭 */
+    uint32_t pad2[SHM_CACHELINE / sizeof(uint32_t) - 3];
+} shm_ring_t;
+
+typedef struct shm_hdr_s {
+    uint32_t magic;
+    uint32_t ring_size;
+    uint8_t pad[SHM_CACHELINE - 2 * sizeof(uint32_t)];
+    shm_ring_t rings[2]; /* rings[i] 由 side i 写入 */
+} shm_hdr_t;
+
+struct ez_shm_chan_s {
+    int side; /* 创建者为 0, 对端为 1 */
+    int memfd;
+    int efd[2]; /* efd[i] 是 side i 的门铃 */
+    size_t ring_size;
+    size_t map_size;
+    shm_hdr_t* hdr;
+    shm_ring_t* tx;
+    shm_ring_t* rx;
+    uint8_t* tx_data;
+    uint8_t* rx_data;
+    int closed;
+    ez_event_loop_t* loop;
+    ezShmChanProc proc;
+    void* clientData;
+};
+
+static void shm_chan_map(ez_shm_chan_t* ch, uint8_t* map)
+{
+    uint8_t* data = map + sizeof(shm_hdr_t);
+
+    ch->hdr = (shm_hdr_t*)map;
+    ch->tx = &ch->hdr->rings[ch->side];
+    ch->rx = &ch->hdr->rings[1 - ch->side];
+    ch->tx_data = data + ch->ring_size * ch->side;
+    ch->rx_data = data + ch->ring_size * (1 - ch->side);
+}
+
+static ez_shm_chan_t* shm_chan_alloc(int side)
+{
+    ez_shm_chan_t* ch = ez_malloc(sizeof(ez_shm_chan_t));
+    memset(ch, 0, sizeof(ez_shm_chan_t));
+    ch->side = side;
+    ch->memfd = ch->efd[0] = ch->efd[1] = -1;
+    return ch;
+}
+
+static void shm_chan_release(ez_shm_chan_t* ch)
+{
+    if (ch->hdr != NULL)
+        munmap(ch->hdr, ch->map_size);
+    if (ch->memfd >= 0)
+        close(ch->memfd);
+    if (ch->efd[0] >= 0)
+        close(ch->efd[0]);
+    if (ch->efd[1] >= 0)
+        close(ch->efd[1]);
+    ez_free(ch);
+}
+
+ez_shm_chan_t* new_shm_chan(size_t ring_size)
+{
+    ez_shm_chan_t* ch = shm_chan_alloc(0);
+    size_t size = SHM_RING_MIN;
+    void* map;
+
+    while (size < ring_size)
+        size <<= 1;
+    ch->ring_size = size;
+    ch->map_size = sizeof(shm_hdr_t) + 2 * size;
+
+    ch->memfd = memfd_create("ez_shm_chan", MFD_CLOEXEC);
+    ch->efd[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ch->efd[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ch->memfd == -1 || ch->efd[0] == -1 || ch->efd[1] == -1 || ftruncate(ch->memfd, (off_t)ch->map_size) == -1) {
+        log_error("new shm chan: %s", strerror(errno));
+        shm_chan_release(ch);
+        return NULL;
+    }
+    map = mmap(NULL, ch->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, ch->memfd, 0);
+    if (map == MAP_FAILED) {
+        log_error("mmap shm chan: %s", strerror(errno));
+        shm_chan_release(ch);
+        return NULL;
+    }
+    // ftruncate 出来的内存都是 0, 只需要写头部.
+    shm_chan_map(ch, map);
+    ch->hdr->magic = SHM_MAGIC;
+    ch->hdr->ring_size = (uint32_t)size;
+    return ch;
+}
+
+void free_shm_chan(ez_shm_chan_t* ch)
+{
+    if (ch == NULL)
+        return;
+    if (!ch->closed)
+        shm_chan_close(ch);
+    if (ch->loop != NULL)
+        ez_delete_file_event(ch->loop, ch->efd[ch->side], AE_READABLE);
+    shm_chan_release(ch);
+}
+
+int shm_chan_send(int sock, ez_shm_chan_t* ch)
+{
+    int fds[3] = { ch->memfd, ch->efd[0], ch->efd[1] };
+    ssize_t nbytes;
+    return ez_net_send_fds(sock, fds, 3, "shm", 3, &nbytes) == ANET_OK ? ANET_OK : ANET_ERR;
+}
+
+ez_shm_chan_t* shm_chan_recv(int sock)
+{
+    ez_shm_chan_t* ch = shm_chan_alloc(1);
+    int fds[3], nfds = 3;
+    char buf[3];
+    ssize_t nbytes;
+    struct stat st;
+    void* map;
+
+    if (ez_net_recv_fds(sock, fds, &nfds, buf, sizeof(buf), &nbytes) != ANET_OK || nfds != 3) {
+        while (nfds > 0)
+            close(fds[--nfds]);
+        ez_free(ch);
+        return NULL;
+    }
+    ch->memfd = fds[0];
+    ch->efd[0] = fds[1];
+    ch->efd[1] = fds[2];
+
+    if (fstat(ch->memfd, &st) == -1 || (size_t)st.st_size < sizeof(shm_hdr_t))
+        goto error;
+    ch->map_size = (size_t)st.st_size;
+    map = mmap(NULL, ch->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, ch->memfd, 0);
+    if (map == MAP_FAILED)
+        goto error;
+    ch->hdr = (shm_hdr_t*)map;
+    ch->ring_size = ch->hdr->ring_size;
+    if (ch->hdr->magic != SHM_MAGIC || sizeof(shm_hdr_t) + 2 * ch->ring_size != ch->map_size)
+        goto error;
+    shm_chan_map(ch, map);
+    return ch;
+
+error:
+    log_error("shm chan recv: bad memfd.");
+    shm_chan_release(ch);
+    return NULL;
+}
+
+static void shm_event_proc(ez_event_loop_t* eventLoop, int fd, void* clientData, int mask)
+{
+    ez_shm_chan_t* ch = (ez_shm_chan_t*)clientData;
+    uint64_t val;
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(mask);
+
+    if (read(fd, &val, sizeof(val)) != sizeof(val))
+        return;
+    ch->proc(ch, ch->clientData);
+}
+
+int shm_chan_attach(ez_shm_chan_t* ch, ez_event_loop_t* eventLoop, ezShmChanProc proc, void* clientData)
+{
+    if (ez_create_file_event(eventLoop, ch->efd[ch->side], AE_READABLE, shm_event_proc, ch) == AE_ERR)
+        return ANET_ERR;
+    ch->loop = eventLoop;
+    ch->proc = proc;
+    ch->clientData = clientData;
+    return ANET_OK;
+}
+
+static void shm_ring_peer(ez_shm_chan_t* ch)
+{
+    uint64_t one = 1;
+    // 计数溢出前对端一定会读, 写失败(EAGAIN)也说明对端已经有待处理的通知.
+    if (write(ch->efd[1 - ch->side], &one, sizeof(one)) == -1 && errno != EAGAIN)
+        log_warn("shm chan doorbell: %s", strerror(errno));
+}
+
+/* *waiting 为 1 时清掉并敲门 */
+static void shm_wake_peer(ez_shm_chan_t* ch, uint32_t* waiting)
+{
+    // 与等待方的 "置位 -> 再检查" 配对, 保证不会漏掉通知.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(waiting, __ATOMIC_RELAXED) && __atomic_exchange_n(waiting, 0, __ATOMIC_RELAXED))
+        shm_ring_peer(ch);
+}
+
+/* 读写都按 [pos & mask, size) + [0, ...) 两段拷贝 */
+static size_t shm_ring_read(ez_shm_chan_t* ch, uint8_t* p, size_t len)
+{
+    shm_ring_t* r = ch->rx;
+    uint64_t tail = r->tail;
+    uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    size_t avail = (size_t)(head - tail), off, first;
+
+    if (len > avail)
+        len = avail;
+    if (len == 0)
+        return 0;
+    off = (size_t)tail & (ch->ring_size - 1);
+    first = ch->ring_size - off < len ? ch->ring_size - off : len;
+    memcpy(p, ch->rx_data + off, first);
+    memcpy(p + first, ch->rx_data, len - first);
+    __atomic_store_n(&r->tail, tail + len, __ATOMIC_RELEASE);
+    return len;
+}
+
+static size_t shm_ring_write(ez_shm_chan_t* ch, const uint8_t* p, size_t len)
+{
+    shm_ring_t* r = ch->tx;
+    uint64_t head = r->head;
+    uint64_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    size_t space = ch->ring_size - (size_t)(head - tail), off, first;
+
+    if (len > space)
+        len = space;
+    if (len == 0)
+        return 0;
+    off = (size_t)head & (ch->ring_size - 1);
+    first = ch->ring_size - off < len ? ch->ring_size - off : len;
+    memcpy(ch->tx_data + off, p, first);
+    memcpy(ch->tx_data, p + first, len - first);
+    __atomic_store_n(&r->head, head + len, __ATOMIC_RELEASE);
+    return len;
+}
+
+int shm_chan_read(ez_shm_chan_t* ch, char* buf, size_t bufsize, ssize_t* nbytes)
+{
+    shm_ring_t* r = ch->rx;
+    int polling = ch->loop == NULL;
+    size_t n;
+
+    *nbytes = 0;
+    // 返回 ANET_OK 的 0 字节是 EOF, 没地方放时不能这么返回.
+    if (bufsize == 0)
+        return ANET_EAGAIN;
+    if ((n = shm_ring_read(ch, (uint8_t*)buf, bufsize)) == 0) {
+        // 没有 attach 的一端是在轮询, 不登记等待, 对端写入时也就不会敲门.
+        // 先登记等待再检查一次, 对端在两者之间写入也不会漏掉门铃.
+        if (!polling) {
+            __atomic_store_n(&r->reader_waiting, 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        }
+        if ((n = shm_ring_read(ch, (uint8_t*)buf, bufsize)) == 0) {
+            if (!__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE))
+                return ANET_EAGAIN;
+            // 关闭前写入的数据此时一定可见, 再读一次, 仍然没有就是 EOF.
+            if ((n = shm_ring_read(ch, (uint8_t*)buf, bufsize)) == 0)
+                return ANET_OK;
+        }
+        if (!polling)
+            __atomic_store_n(&r->reader_waiting, 0, __ATOMIC_RELAXED);
+    }
+    *nbytes = (ssize_t)n;
+    shm_wake_peer(ch, &r->writer_waiting);
+    return ANET_OK;
+}
+
+int shm_chan_write(ez_shm_chan_t* ch, const char* buf, size_t bufsize, ssize_t* nbytes)
+{
+    shm_ring_t* r = ch->tx;
+    size_t n;
+
+    *nbytes = 0;
+    if (ch->closed || __atomic_load_n(&ch->rx->closed, __ATOMIC_ACQUIRE))
+        return ANET_ERR;
+    if (bufsize == 0)
+        return ANET_OK;
+    if ((n = shm_ring_write(ch, (const uint8_t*)buf, bufsize)) == 0) {
+        if (ch->loop == NULL) /* 轮询端 */
+            return ANET_EAGAIN;
+        __atomic_store_n(&r->writer_waiting, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if ((n = shm_ring_write(ch, (const uint8_t*)buf, bufsize)) == 0)
+            return ANET_EAGAIN;
+        __atomic_store_n(&r->writer_waiting, 0, __ATOMIC_RELAXED);
+    }
+    *nbytes = (ssize_t)n;
+    shm_wake_peer(ch, &r->reader_waiting);
+    return ANET_OK;
+}
+
+int shm_chan_read_bf(ez_shm_chan_t* ch, bytebuf_t* buf, ssize_t* nbytes)
+{
+    int r = shm_chan_read(ch, (char*)bytebuf_writer_pos(buf), bytebuf_writeable_size(buf), nbytes);
+    if (r == ANET_OK)
+        buf->w += *nbytes;
+    return r;
+}
+
+int shm_chan_write_bf(ez_shm_chan_t* ch, bytebuf_t* buf, ssize_t* nbytes)
+{
+    int r = shm_chan_write(ch, (const char*)bytebuf_reader_pos(buf), bytebuf_readable_size(buf), nbytes);
+    if (r == ANET_OK)
+        buf->r += *nbytes;
+    return r;
+}
+
+void shm_chan_close(ez_shm_chan_t* ch)
+{
+    if (ch->closed)
+        return;
+    ch->closed = 1;
+    __atomic_store_n(&ch->tx->closed, 1, __ATOMIC_RELEASE);
+    // 对端可能没在等, 也要敲门让它看到 EOF.
+    shm_ring_peer(ch);
+}
@@ -0,0 +1,49 @@
+#ifndef EZ_SHM_H
+#define EZ_SHM_H
+
+#include "ez_bytebuf.h"
+#include "ez_event.h"
+
+#include <sys/types.h>
+
+//
+// 同一台机器上两个进程间的共享内存通道.
+// 一个 memfd 中放两个单生产者单消费者的环形缓冲(每个方向一个), 读写只是 memcpy,
+// 不经过内核. 每一端有一个 eventfd 门铃: 只有对端在等待(读空或写满)时才敲门,
+// 所以连续收发时不产生系统调用. 要求亚微秒延迟时读端可以直接轮询 shm_chan_read.
+// memfd 和 eventfd 通过 unix socket(ez_net_send_fds) 交给对端.
+//
+typedef struct ez_shm_chan_s ez_shm_chan_t;
+
+/* 有数据可读, 有空间可写, 或对端已关闭 */
+typedef void (*ezShmChanProc)(ez_shm_chan_t* ch, void* clientData);
+
+/* 创建通道, 每个方向 ring_size 字节(向上取 2 的幂, 至少 4096) */
+ez_shm_chan_t* new_shm_chan(size_t ring_size);
+
+/* 本端还没关闭时先 shm_chan_close */
+void free_shm_chan(ez_shm_chan_t* ch);
+
+/* 把通道的 memfd/eventfd 发给对端, 返回 ANET_OK/ANET_ERR */
+int shm_chan_send(int sock, ez_shm_chan_t* ch);
+
+/* sock 可读后调用, 得到通道的另一端; 失败返回 NULL */
+ez_shm_chan_t* shm_chan_recv(int sock);
+
+/* 在事件循环中注册本端的门铃. 不 attach 的一端视为轮询, 读空/写满时不登记等待 */
+int shm_chan_attach(ez_shm_chan_t* ch, ez_event_loop_t* eventLoop, ezShmChanProc proc, void* clientData);
+
+/* 返回值同 ez_net_read/ez_net_write:
+   读: ANET_OK 且 nbytes=0 表示对端已关闭且数据已读完; 没有数据返回 ANET_EAGAIN.
+       bufsize 为 0(bytebuf 已满)也返回 ANET_EAGAIN, 不会有门铃, 腾出空间后直接再读.
+   写: 只写入放得下的部分, 一个字节都放不下返回 ANET_EAGAIN; 对端已关闭返回 ANET_ERR. */
+int shm_chan_read(ez_shm_chan_t* ch, char* buf, size_t bufsize, ssize_t* nbytes);
+int shm_chan_write(ez_shm_chan_t* ch, const char* buf, size_t bufsize, ssize_t* nbytes);
+
+int shm_chan_read_bf(ez_shm_chan_t* ch, bytebuf_t* buf, ssize_t* nbytes);
+int shm_chan_write_bf(ez_shm_chan_t* ch, bytebuf_t* buf, ssize_t* nbytes);
+
+/* 关闭本端的写方向, 对端读完剩余数据后读到 EOF */
+void shm_chan_close(ez_shm_chan_t* ch);
+
+#endif // EZ_SHM_H
@@ -0,0 +1,232 @@
+#include "ez_splice.h"
+
+#include "ez_log.h"
+#include "ez_macro.h"
+#include "ez_malloc.h"
+#include "ez_net.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SPLICE_DEFAULT_CHUNK (64 * 1024)
+
+struct ez_splice_s {
+    ez_event_loop_t* loop;
+    int in_fd;
+    int out_fd;
+    int pipe_fd[2]; /* [0] read end, [1] write end */
+    int mask_in; /* in_fd 上注册的事件 */
+    int mask_out; /* out_fd 上注册的事件 */
+    int eof;
+    int pipe_full; /* in_fd 可读但搬不进 pipe, 等写出一些后再读 */
+    size_t chunk;
+    size_t pending; /* 在 pipe 中还未写出的字节数 */
+    uint64_t transferred;
+    ezSpliceProc proc;
+    void* clientData;
+    ez_splice_t* peer; /* new_splice_duplex 的另一个方向 */
+    ez_splice_t* owner; /* 注册事件用的 clientData, 一个 fd 上两个方向必须相同 */
+};
+
+static void splice_event_proc(ez_event_loop_t* eventLoop, int fd, void* clientData, int mask);
+
+static void splice_unwatch(ez_splice_t* sp)
+{
+    if (sp->mask_in != AE_NONE)
+        ez_delete_file_event(sp->loop, sp->in_fd, AE_READABLE);
+    if (sp->mask_out != AE_NONE)
+        ez_delete_file_event(sp->loop, sp->out_fd, AE_WRITABLE);
+    sp->mask_in = sp->mask_out = AE_NONE;
+}
+
+/* 只在需要时注册事件: pipe 有空间才读, pipe 有数据才写 */
+static int splice_update_events(ez_splice_t* sp)
+{
+    int want_in = (!sp->eof && !sp->pipe_full && sp->pending < sp->chunk) ? AE_READABLE : AE_NONE;
+    int want_out = sp->pending > 0 ? AE_WRITABLE : AE_NONE;
+
+    if (want_in != sp->mask_in) {
+        if (want_in == AE_NONE)
+            ez_delete_file_event(sp->loop, sp->in_fd, AE_READABLE);
+        else if (ez_create_file_event(sp->loop, sp->in_fd, AE_READABLE, splice_event_proc, sp->owner) == AE_ERR)
+            return ANET_ERR;
+        sp->mask_in = want_in;
+    }
+    if (want_out != sp->mask_out) {
+        if (want_out == AE_NONE)
+            ez_delete_file_event(sp->loop, sp->out_fd, AE_WRITABLE);
+        else if (ez_create_file_event(sp->loop, sp->out_fd, AE_WRITABLE, splice_event_proc, sp->owner) == AE_ERR)
+            return ANET_ERR;
+        sp->mask_out = want_out;
+    }
+    return ANET_OK;
+}
+
+static void splice_finish(ez_splice_t* sp, int status)
+{
+    splice_unwatch(sp);
+    sp->proc(sp->loop, sp, status, sp->clientData);
+}
+
+static int splice_drain(ez_splice_t* sp)
+{
+    ssize_t n;
+    int r;
+
+    while (sp->pending > 0) {
+        r = ez_net_splice(sp->pipe_fd[0], sp->out_fd, sp->pending, &n);
+        if (r == ANET_EAGAIN)
+            break;
+        if (r != ANET_OK || n == 0) {
+            log_error("splice pipe => fd:%d failed: %s", sp->out_fd, strerror(errno));
+            return ANET_ERR;
+        }
+        sp->pending -= (size_t)n;
+        sp->transferred += (uint64_t)n;
+        sp->pipe_full = 0;
+    }
+    return ANET_OK;
+}
+
+/* readable: in_fd 的 AE_READABLE 触发了 */
+static int splice_fill(ez_splice_t* sp, int readable)
+{
+    ssize_t n;
+    int r;
+
+    while (!sp->eof && !sp->pipe_full && sp->pending < sp->chunk) {
+        r = ez_net_splice(sp->in_fd, sp->pipe_fd[1], sp->chunk - sp->pending, &n);
+        if (r == ANET_EAGAIN) {
+            // 小报文各占一个 pipe 槽位, pending 没到 chunk pipe 就可能满了;
+            // 这时还注册 AE_READABLE 的话 in_fd 每轮都触发, 空转.
+            if (readable && sp->pending > 0)
+                sp->pipe_full = 1;
+            break;
+        }
+        if (r != ANET_OK) {
+            log_error("splice fd:%d => pipe failed: %s", sp->in_fd, strerror(errno));
+            return ANET_ERR;
+        }
+        if (n == 0)
+            sp->eof = 1;
+        sp->pending += (size_t)n;
+    }
+    return ANET_OK;
+}
+
+static void splice_event_proc(ez_event_loop_t* eventLoop, int fd, void* clientData, int mask)
+{
+    ez_splice_t* sp = (ez_splice_t*)clientData;
+    EZ_NOTUSED(eventLoop);
+
+    // 双向转发时一个 fd 上读是一个方向, 写是另一个方向, 按 fd 和 mask 找到对应的方向.
+    if (sp->peer != NULL && fd != ((mask & AE_READABLE) ? sp->in_fd : sp->out_fd))
+        sp = sp->peer;
+
+    if (splice_fill(sp, (mask & AE_READABLE) != 0) != ANET_OK || splice_drain(sp) != ANET_OK) {
+        splice_finish(sp, ANET_ERR);
+        return;
+    }
+    if (sp->eof && sp->pending == 0) {
+        splice_finish(sp, ANET_OK);
+        return;
+    }
+    if (splice_update_events(sp) != ANET_OK)
+        splice_finish(sp, ANET_ERR);
+}
+
+static ez_splice_t* splice_alloc(ez_event_loop_t* eventLoop, int in_fd, int out_fd, size_t chunk, ezSpliceProc proc, void* clientData)
+{
+    ez_splice_t* sp = ez_malloc(sizeof(ez_splice_t));
+    int size;
+
+    if (pipe2(sp->pipe_fd, O_NONBLOCK | O_CLOEXEC) == -1) {
+        log_error("pipe2: %s", strerror(errno));
+        ez_free(sp);
+        return NULL;
+    }
+    sp->loop = eventLoop;
+    sp->in_fd = in_fd;
+    sp->out_fd = out_fd;
+    sp->mask_in = sp->mask_out = AE_NONE;
+    sp->eof = 0;
+    sp->pipe_full = 0;
+    sp->chunk = chunk > 0 ? chunk : SPLICE_DEFAULT_CHUNK;
+    sp->pending = 0;
+    sp->transferred = 0;
+    sp->proc = proc;
+    sp->clientData = clientData;
+    sp->peer = NULL;
+    sp->owner = sp;
+
+    // pipe 容量至少能容纳一个 chunk; 超过 pipe-max-size 时设置失败, chunk 缩到 pipe 的实际容量.
+    if (sp->chunk > SPLICE_DEFAULT_CHUNK)
+        fcntl(sp->pipe_fd[1], F_SETPIPE_SZ, (int)(sp->chunk > INT32_MAX ? INT32_MAX : sp->chunk));
+    size = fcntl(sp->pipe_fd[1], F_GETPIPE_SZ);
+    if (size > 0 && sp->chunk > (size_t)size)
+        sp->chunk = (size_t)size;
+    return sp;
+}
+
+ez_splice_t* new_splice(ez_event_loop_t* eventLoop, int in_fd, int out_fd, size_t chunk, ezSpliceProc proc, void* clientData)
+{
+    ez_splice_t* sp = splice_alloc(eventLoop, in_fd, out_fd, chunk, proc, clientData);
+
+    if (sp == NULL)
+        return NULL;
+    if (splice_update_events(sp) != ANET_OK) {
+        free_splice(sp);
+        return NULL;
+    }
+    return sp;
+}
+
+int new_splice_duplex(ez_event_loop_t* eventLoop, int fd_a, int fd_b, size_t chunk, ezSpliceProc proc, void* clientData,
+    ez_splice_t* sp[2])
+{
+    sp[0] = splice_alloc(eventLoop, fd_a, fd_b, chunk, proc, clientData);
+    sp[1] = sp[0] != NULL ? splice_alloc(eventLoop, fd_b, fd_a, chunk, proc, clientData) : NULL;
+    if (sp[1] == NULL) {
+        free_splice(sp[0]);
+        return ANET_ERR;
+    }
+    sp[0]->peer = sp[1];
+    sp[1]->peer = sp[0];
+    sp[1]->owner = sp[0];
+    if (splice_update_events(sp[0]) != ANET_OK || splice_update_events(sp[1]) != ANET_OK) {
+        free_splice(sp[1]);
+        free_splice(sp[0]);
+        return ANET_ERR;
+    }
+    return ANET_OK;
+}
+
+void free_splice(ez_splice_t* sp)
+{
+    ez_splice_t* peer;
+
+    if (sp == NULL)
+        return;
+    splice_unwatch(sp);
+    peer = sp->peer;
+    if (peer != NULL) {
+        // 另一个方向还在转发, 它的事件改用自己作 clientData 重新注册.
+        peer->peer = NULL;
+        if (peer->owner == sp) {
+            splice_unwatch(peer);
+            peer->owner = peer;
+            if (splice_update_events(peer) != ANET_OK)
+                log_error("splice fd:%d => fd:%d re-register events failed.", peer->in_fd, peer->out_fd);
+        }
+    }
+    close(sp->pipe_fd[0]);
+    close(sp->pipe_fd[1]);
+    ez_free(sp);
+}
+
+uint64_t splice_transferred(ez_splice_t* sp)
+{
+    return sp->transferred;
+}
@@ -0,0 +1,35 @@
+#ifndef EZ_SPLICE_H
+#define EZ_SPLICE_H
+
+#include "ez_event.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// 基于 pipe + splice 的 fd 到 fd 转发, 数据不经过用户空间.
+// in_fd/out_fd 需是非阻塞的, 转发结束后不会关闭 in_fd/out_fd.
+// 事件循环每个 fd 只有一个 clientData, 转发期间 in_fd/out_fd 不能再注册别的事件;
+// 同一对 fd 的双向转发(代理)必须用 new_splice_duplex, 不能分别 new_splice 两次.
+//
+typedef struct ez_splice_s ez_splice_t;
+
+/* status: ANET_OK 表示 in_fd 已 EOF 且数据全部写出, ANET_ERR 表示读写出错.
+   回调中可以直接 free_splice(sp). */
+typedef void (*ezSpliceProc)(ez_event_loop_t* eventLoop, ez_splice_t* sp, int status, void* clientData);
+
+/* chunk: 每次从 in_fd 搬入 pipe 的最大字节数, 0 使用默认值(64K); 不超过 pipe 能设置的容量 */
+ez_splice_t* new_splice(ez_event_loop_t* eventLoop, int in_fd, int out_fd, size_t chunk, ezSpliceProc proc, void* clientData);
+
+/* 双向转发: sp[0] 为 fd_a => fd_b, sp[1] 为 fd_b => fd_a, 两个方向共用 fd 上的事件.
+   每个方向结束时各回调一次 proc, 可以各自 free_splice, 另一个方向不受影响. 返回 ANET_OK/ANET_ERR */
+int new_splice_duplex(ez_event_loop_t* eventLoop, int fd_a, int fd_b, size_t chunk, ezSpliceProc proc, void* clientData,
+    ez_splice_t* sp[2]);
+
+/* 停止转发(撤销 in_fd/out_fd 上的事件)并释放 */
+void free_splice(ez_splice_t* sp);
+
+/* 已写到 out_fd 的字节数 */
+uint64_t splice_transferred(ez_splice_t* sp);
+
+#endif // EZ_SPLICE_H
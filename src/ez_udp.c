@@ -0,0 +1,252 @@
+#include "ez_udp.h"
+
+#include "ez_malloc.h"
+#include "ez_net.h"
+
+#include <errno.h>
+#include <netinet/udp.h>
+#include <string.h>
+
+/* 需要分段时附加 UDP_SEGMENT cmsg */
+static void udp_set_segment(struct msghdr* h, ez_udp_msg_t* m)
+{
+    struct cmsghdr* cm;
+    if (m->segsize == 0 || bytebuf_readable_size(&m->buf) <= m->segsize)
+        return;
+    h->msg_control = m->ctrl.buf;
+    h->msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+    cm = CMSG_FIRSTHDR(h);
+    cm->cmsg_level = SOL_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    memcpy(CMSG_DATA(cm), &m->segsize, sizeof(uint16_t));
+}
+
+/* 从 UDP_GRO cmsg 取合并报文的分段大小 */
+static uint16_t udp_get_segment(struct msghdr* h)
+{
+    struct cmsghdr* cm;
+    int gso_size;
+    for (cm = CMSG_FIRSTHDR(h); cm != NULL; cm = CMSG_NXTHDR(h, cm)) {
+        if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+            memcpy(&gso_size, CMSG_DATA(cm), sizeof(int));
+            return (uint16_t)gso_size;
+        }
+    }
+    return 0;
+}
+
+ez_udp_batch_t* new_udp_batch(int cap, size_t bufsize)
+{
+    int i;
+    ez_udp_batch_t* b = ez_malloc(sizeof(ez_udp_batch_t));
+
+    bufsize = EZ_ALIGN(bufsize);
+    b->cap = cap;
+    b->msgs = ez_malloc(sizeof(ez_udp_msg_t) * cap);
+    b->hdrs = ez_malloc(sizeof(struct mmsghdr) * cap);
+    b->iov = ez_malloc(sizeof(struct iovec) * cap);
+    b->data = ez_malloc(bufsize * cap);
+
+    for (i = 0; i < cap; ++i) {
+        b->msgs[i].buf.data = b->data + bufsize * i;
+        b->msgs[i].buf.cap = bufsize;
+        b->msgs[i].buf.flags = BYTEBUF_F_FIXED;
+    }
+    b->truncated = 0;
+    udp_batch_reset(b);
+    return b;
+}
+
+void free_udp_batch(ez_udp_batch_t* b)
+{
+    if (b == NULL)
+        return;
+    ez_free(b->data);
+    ez_free(b->iov);
+    ez_free(b->hdrs);
+    ez_free(b->msgs);
+    ez_free(b);
+}
+
+void udp_batch_reset(ez_udp_batch_t* b)
+{
+    b->head = b->count = 0;
+}
+
+ez_udp_msg_t* udp_batch_next(ez_udp_batch_t* b)
+{
+    if (udp_batch_is_full(b))
+        return NULL;
+    ez_udp_msg_t* m = &b->msgs[b->count++];
+    m->buf.r = m->buf.w = 0;
+    m->addrlen = 0;
+    m->segsize = 0;
+    return m;
+}
+
+int udp_batch_recv(int fd, ez_udp_batch_t* b, int* nmsgs)
+{
+    ez_udp_msg_t tmp;
+    int i, j, n;
+
+    *nmsgs = 0;
+    udp_batch_reset(b);
+    // 收到的全被丢弃时接着收, 不返回 0 个报文.
+    do {
+        for (i = 0; i < b->cap; ++i) {
+            ez_udp_msg_t* m = &b->msgs[i];
+            m->buf.r = m->buf.w = 0;
+            b->iov[i].iov_base = m->buf.data;
+            b->iov[i].iov_len = m->buf.cap;
+
+            memset(&b->hdrs[i].msg_hdr, 0, sizeof(struct msghdr));
+            b->hdrs[i].msg_hdr.msg_name = &m->addr;
+            b->hdrs[i].msg_hdr.msg_namelen = sizeof(m->addr);
+            b->hdrs[i].msg_hdr.msg_iov = &b->iov[i];
+            b->hdrs[i].msg_hdr.msg_iovlen = 1;
+            b->hdrs[i].msg_hdr.msg_control = m->ctrl.buf;
+            b->hdrs[i].msg_hdr.msg_controllen = sizeof(m->ctrl.buf);
+        }
+
+        n = recvmmsg(fd, b->hdrs, (unsigned int)b->cap, MSG_DONTWAIT, NULL);
+        if (n < 0) {
+            // linux define EWOULDBLOCK EAGAIN.
+            if (errno == EAGAIN || errno == EINTR)
+                return ANET_EAGAIN;
+            return ANET_ERR;
+        }
+
+        for (i = 0, j = 0; i < n; ++i) {
+            if (b->hdrs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                b->truncated++;
+                continue;
+            }
+            b->msgs[i].buf.w = b->hdrs[i].msg_len;
+            b->msgs[i].addrlen = b->hdrs[i].msg_hdr.msg_namelen;
+            b->msgs[i].segsize = udp_get_segment(&b->hdrs[i].msg_hdr);
+            // 完整的报文前移; 交换而不是复制, 每个消息仍各自占一块数据区.
+            if (j != i) {
+                tmp = b->msgs[j];
+                b->msgs[j] = b->msgs[i];
+                b->msgs[i] = tmp;
+            }
+            ++j;
+        }
+    } while (j == 0);
+    b->count = j;
+    *nmsgs = j;
+    return ANET_OK;
+}
+
+int udp_batch_send(int fd, ez_udp_batch_t* b, int* nmsgs)
+{
+    int i, j, n;
+
+    *nmsgs = 0;
+    if (b->head >= b->count) {
+        udp_batch_reset(b);
+        return ANET_OK;
+    }
+
+    for (i = b->head, j = 0; i < b->count; ++i, ++j) {
+        ez_udp_msg_t* m = &b->msgs[i];
+        b->iov[j].iov_base = bytebuf_reader_pos(&m->buf);
+        b->iov[j].iov_len = bytebuf_readable_size(&m->buf);
+
+        memset(&b->hdrs[j].msg_hdr, 0, sizeof(struct msghdr));
+        b->hdrs[j].msg_hdr.msg_name = m->addrlen > 0 ? &m->addr : NULL;
+        b->hdrs[j].msg_hdr.msg_namelen = m->addrlen;
+        b->hdrs[j].msg_hdr.msg_iov = &b->iov[j];
+        b->hdrs[j].msg_hdr.msg_iovlen = 1;
+        udp_set_segment(&b->hdrs[j].msg_hdr, m);
+    }
+
+    n = sendmmsg(fd, b->hdrs, (unsigned int)j, MSG_DONTWAIT);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EINTR || errno == ENOBUFS)
+            return ANET_EAGAIN;
+        return ANET_ERR;
+    }
+
+    // 报文要么整个发出, 要么没有发出.
+    for (i = 0; i < n; ++i)
+        b->msgs[b->head + i].buf.r = b->msgs[b->head + i].buf.w;
+    b->head += n;
+    *nmsgs = n;
+    if (b->head >= b->count) {
+        udp_batch_reset(b);
+        return ANET_OK;
+    }
+    return ANET_EAGAIN;
+}
+
+int udp_write_gso_bf(int fd, bytebuf_t* buf, uint16_t segsize, ssize_t* nbytes)
+{
+    ez_udp_msg_t m;
+    struct msghdr h;
+    struct iovec iov;
+    ssize_t r;
+
+    *nbytes = 0;
+    m.segsize = segsize;
+    m.buf = *buf;
+    iov.iov_base = bytebuf_reader_pos(buf);
+    iov.iov_len = bytebuf_readable_size(buf);
+    memset(&h, 0, sizeof(h));
+    h.msg_iov = &iov;
+    h.msg_iovlen = 1;
+    udp_set_segment(&h, &m);
+
+    r = sendmsg(fd, &h, MSG_DONTWAIT);
+    if (r < 0) {
+        if (errno == EAGAIN || errno == EINTR || errno == ENOBUFS)
+            return ANET_EAGAIN;
+        return ANET_ERR;
+    }
+    buf->r += r;
+    *nbytes = r;
+    return ANET_OK;
+}
+
+int udp_read_gro_bf(int fd, bytebuf_t* buf, uint16_t* segsize, ssize_t* nbytes, uint64_t* truncated)
+{
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctrl;
+    struct msghdr h;
+    struct iovec iov;
+    ssize_t r;
+
+    *nbytes = 0;
+    *segsize = 0;
+    // 合并后的报文最长 64K, 能扩容的先扩容; 一点空间都没有时不读, 否则报文只能丢弃.
+    bytebuf_ensure_writable(buf, UDP_MAX_PAYLOAD);
+    if (!bytebuf_is_writeable(buf))
+        return ANET_EAGAIN;
+    iov.iov_base = bytebuf_writer_pos(buf);
+    iov.iov_len = bytebuf_writeable_size(buf);
+    memset(&h, 0, sizeof(h));
+    h.msg_iov = &iov;
+    h.msg_iovlen = 1;
+    h.msg_control = ctrl.buf;
+    h.msg_controllen = sizeof(ctrl.buf);
+
+    r = recvmsg(fd, &h, MSG_DONTWAIT);
+    if (r < 0) {
+        if (errno == EAGAIN || errno == EINTR)
+            return ANET_EAGAIN;
+        return ANET_ERR;
+    }
+    // 截断的报文丢弃, 每次最多丢一个, 由调用方计数后接着读.
+    if (h.msg_flags & MSG_TRUNC) {
+        if (truncated != NULL)
+            (*truncated)++;
+        return ANET_OK;
+    }
+    buf->w += r;
+    *nbytes = r;
+    *segsize = udp_get_segment(&h);
+    return ANET_OK;
+}
@@ -0,0 +1,78 @@
+#ifndef EZ_UDP_H
+#define EZ_UDP_H
+
+#include "ez_bytebuf.h"
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+//
+// recvmmsg/sendmmsg 批量收发, 一次系统调用处理 cap 个报文.
+// 消息数组与数据区在 new_udp_batch 时一次分配, 收发过程中不再分配内存.
+//
+// GSO/GRO: segsize > 0 的消息是多个等长报文(最后一个可以更短)拼接在一起,
+// 发送时内核按 segsize 切分(最多 UDP_MAX_SEGMENTS 个, 总长不超过 64K),
+// 接收端 ez_net_set_udp_gro(fd, 1) 后内核合并的报文会带上 segsize.
+//
+#define UDP_MAX_SEGMENTS 64
+#define UDP_MAX_PAYLOAD 65535 /* 一个(合并后的)报文的最大长度 */
+
+typedef struct ez_udp_msg_s {
+    bytebuf_t buf; /* 数据指向 batch 的数据区(BYTEBUF_F_FIXED), 不要 free_bytebuf */
+    struct sockaddr_storage addr; /* 对端地址, addrlen=0 时使用 connect 的地址 */
+    socklen_t addrlen;
+    uint16_t segsize; /* GSO/GRO 分段大小, 0 表示单个报文 */
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctrl;
+} ez_udp_msg_t;
+
+typedef struct ez_udp_batch_s {
+    int cap;
+    int head; /* [head, count) 为待发送的消息 */
+    int count; /* 收到的/待发送的消息数 */
+    ez_udp_msg_t* msgs;
+    struct mmsghdr* hdrs;
+    struct iovec* iov;
+    uint8_t* data;
+    uint64_t truncated; /* 超过 bufsize 被截断而丢弃的报文数 */
+} ez_udp_batch_t;
+
+/* cap 个消息, 每个消息数据区 bufsize 字节 */
+ez_udp_batch_t* new_udp_batch(int cap, size_t bufsize);
+
+void free_udp_batch(ez_udp_batch_t* b);
+
+/* 清空所有消息 */
+void udp_batch_reset(ez_udp_batch_t* b);
+
+/* 取下一个空闲消息用于写入待发送的数据, 已满返回 NULL */
+ez_udp_msg_t* udp_batch_next(ez_udp_batch_t* b);
+
+#define udp_batch_msg(b, i) (&(b)->msgs[(i)])
+#define udp_msg_segments(m) ((m)->segsize == 0 ? 1 : (bytebuf_readable_size(&(m)->buf) + (m)->segsize - 1) / (m)->segsize)
+#define udp_batch_is_full(b) ((b)->count >= (b)->cap)
+
+/* NonBlock recvmmsg, 清空 batch 后接收最多 cap 个报文到 msgs[0..count).
+   超过 bufsize 的报文(包括 GRO 合并后超长的)只收到一部分, 直接丢弃并计入 b->truncated.
+   @return ANET_OK/ANET_EAGAIN/ANET_ERR 同 ez_net_read, nmsgs 为收到的完整报文数.
+ */
+int udp_batch_recv(int fd, ez_udp_batch_t* b, int* nmsgs);
+
+/* NonBlock sendmmsg, 发送 msgs[head..count), 全部发出后 batch 被清空.
+   部分发送时 head 前移并返回 ANET_EAGAIN, 再次调用继续发送剩余报文.
+   @return ANET_OK/ANET_EAGAIN/ANET_ERR 同 ez_net_write, nmsgs 为本次发出的报文数.
+ */
+int udp_batch_send(int fd, ez_udp_batch_t* b, int* nmsgs);
+
+/* 单个 bytebuf 的 GSO 发送/GRO 接收, 返回值同 ez_net_write/ez_net_read.
+   udp_write_gso_bf: 发送 buf 可读部分, 按 segsize 切成多个报文, segsize=0 不分段.
+   udp_read_gro_bf : 接收一个(可能合并的)报文到 buf, segsize 返回分段大小, 0 表示未合并.
+                     buf 先扩容到能放下 UDP_MAX_PAYLOAD; 不能扩容且没有可写空间时返回 ANET_EAGAIN.
+                     放不下被截断的报文丢弃, 返回 ANET_OK 且 nbytes=0, truncated(可以为 NULL) 加 1.
+ */
+int udp_write_gso_bf(int fd, bytebuf_t* buf, uint16_t segsize, ssize_t* nbytes);
+int udp_read_gro_bf(int fd, bytebuf_t* buf, uint16_t* segsize, ssize_t* nbytes, uint64_t* truncated);
+
+#endif // EZ_UDP_H
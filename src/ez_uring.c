@@ -0,0 +1,534 @@
+#include "ez_uring.h"
+
+#include "ez_list.h"
+#include "ez_log.h"
+#include "ez_macro.h"
+#include "ez_malloc.h"
+#include "ez_net.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define URING_BGID 0
+#define URING_BUFS_MAX 32768
+
+#define URING_OP_ACCEPT 1
+#define URING_OP_RECV 2
+#define URING_OP_SEND 3
+
+struct ez_uring_op_s {
+    list_head_t node;
+    int type;
+    int fd;
+    int cancelled;
+    int pending; /* send 链中还没完成的 sqe */
+    ssize_t sent;
+    int err;
+    union {
+        ezUringAcceptProc accept;
+        ezUringRecvProc recv;
+        ezUringSendProc send;
+    } proc;
+    void* clientData;
+    int nbufs;
+    bytebuf_t* bufs[]; /* send 链 */
+};
+
+struct ez_uring_s {
+    ez_event_loop_t* loop;
+    int fd;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_flags;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_local_tail; /* 已填写但还没交给内核的 sqe 在 sq_tail 之后 */
+    struct io_uring_sqe* sqes;
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+
+    struct io_uring_buf_ring* br;
+    size_t br_size;
+    unsigned br_mask;
+    uint16_t br_tail;
+    uint8_t* buf_base;
+    unsigned buf_size;
+
+    int in_reap; /* 处理完成事件期间的提交推迟到最后一起提交 */
+    uint64_t nobufs;
+    list_head_t ops;
+};
+
+static int uring_setup(unsigned entries, struct io_uring_params* p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static int uring_submit(ez_uring_t* u)
+{
+    unsigned n = u->sq_local_tail - *u->sq_tail;
+    int r;
+
+    if (n == 0)
+        return ANET_OK;
+    __atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+    do {
+        r = uring_enter(u->fd, n, 0, 0);
+    } while (r == -1 && errno == EINTR);
+    if (r == -1) {
+        log_error("io_uring_enter: %s", strerror(errno));
+        return ANET_ERR;
+    }
+    return ANET_OK;
+}
+
+/* 提交队列剩余的空位, 不够时先提交已填写的 sqe */
+static int uring_reserve(ez_uring_t* u, unsigned n)
+{
+    if (n > u->sq_entries)
+        return ANET_ERR;
+    if (u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) + n <= u->sq_entries)
+        return ANET_OK;
+    if (uring_submit(u) != ANET_OK)
+        return ANET_ERR;
+    return u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) + n <= u->sq_entries ? ANET_OK : ANET_ERR;
+}
+
+static struct io_uring_sqe* uring_get_sqe(ez_uring_t* u, ez_uring_op_t* op)
+{
+    struct io_uring_sqe* sqe = &u->sqes[u->sq_local_tail++ & u->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = (uint64_t)(uintptr_t)op;
+    return sqe;
+}
+
+/* 不在完成事件回调中时立即提交 */
+static int uring_flush(ez_uring_t* u)
+{
+    return u->in_reap ? ANET_OK : uring_submit(u);
+}
+
+static void uring_buf_recycle(ez_uring_t* u, uint16_t bid)
+{
+    struct io_uring_buf* b = &u->br->bufs[u->br_tail & u->br_mask];
+
+    b->addr = (uint64_t)(uintptr_t)(u->buf_base + (size_t)bid * u->buf_size);
+    b->len = u->buf_size;
+    b->bid = bid;
+    u->br_tail++;
+    __atomic_store_n(&u->br->tail, u->br_tail, __ATOMIC_RELEASE);
+}
+
+static void uring_prep_accept(ez_uring_t* u, ez_uring_op_t* op)
+{
+    struct io_uring_sqe* sqe = uring_get_sqe(u, op);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = op->fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+}
+
+static void uring_prep_recv(ez_uring_t* u, ez_uring_op_t* op)
+{
+    struct io_uring_sqe* sqe = uring_get_sqe(u, op);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = op->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+}
+
+static ez_uring_op_t* new_uring_op(ez_uring_t* u, int type, int fd, void* clientData, int nbufs)
+{
+    ez_uring_op_t* op = ez_malloc(sizeof(ez_uring_op_t) + sizeof(bytebuf_t*) * (size_t)nbufs);
+    op->type = type;
+    op->fd = fd;
+    op->cancelled = 0;
+    op->pending = 0;
+    op->sent = 0;
+    op->err = 0;
+    op->clientData = clientData;
+    op->nbufs = nbufs;
+    list_add(&op->node, &u->ops);
+    return op;
+}
+
+static void free_uring_op(ez_uring_op_t* op)
+{
+    list_del(&op->node);
+    ez_free(op);
+}
+
+static void uring_complete_accept(ez_uring_t* u, ez_uring_op_t* op, struct io_uring_cqe* cqe)
+{
+    int more = cqe->flags & IORING_CQE_F_MORE;
+
+    if (op->cancelled) {
+        if (cqe->res >= 0)
+            ez_net_close_socket(cqe->res);
+        if (!more)
+            free_uring_op(op);
+        return;
+    }
+    if (cqe->res >= 0 || !more)
+        op->proc.accept(u, op->fd, cqe->res, op->clientData);
+    if (more)
+        return;
+    // 回调中可能已经取消.
+    if (cqe->res >= 0 && !op->cancelled && uring_reserve(u, 1) == ANET_OK) {
+        uring_prep_accept(u, op);
+        return;
+    }
+    free_uring_op(op);
+}
+
+static void uring_complete_recv(ez_uring_t* u, ez_uring_op_t* op, struct io_uring_cqe* cqe)
+{
+    int more = cqe->flags & IORING_CQE_F_MORE;
+    uint16_t bid;
+    bytebuf_t in;
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        if (!op->cancelled && cqe->res > 0) {
+            in.r = 0;
+            in.w = (uint32_t)cqe->res;
+            in.cap = u->buf_size;
+            in.flags = BYTEBUF_F_FIXED;
+            in.data = u->buf_base + (size_t)bid * u->buf_size;
+            op->proc.recv(u, op->fd, &in, cqe->res, op->clientData);
+        }
+        uring_buf_recycle(u, bid);
+    }
+    if (more)
+        return;
+
+    if (!op->cancelled) {
+        // 缓冲池用完或内核因其他原因结束了 multishot, 缓冲已在上面收回, 重新提交.
+        if (cqe->res == -ENOBUFS || cqe->res > 0) {
+            if (cqe->res == -ENOBUFS)
+                u->nobufs++;
+            if (uring_reserve(u, 1) == ANET_OK) {
+                uring_prep_recv(u, op);
+                return;
+            }
+            cqe->res = -ENOMEM;
+        }
+        op->proc.recv(u, op->fd, NULL, cqe->res, op->clientData);
+    }
+    free_uring_op(op);
+}
+
+static void uring_complete_send(ez_uring_t* u, ez_uring_op_t* op, struct io_uring_cqe* cqe)
+{
+    int i;
+    size_t n;
+
+    if (cqe->res >= 0) {
+        op->sent += cqe->res;
+    } else if (op->err == 0 && cqe->res != -ECANCELED) {
+        op->err = cqe->res;
+    }
+    if (--op->pending > 0)
+        return;
+
+    // 按发出的字节数依次推进 buf->r
+    n = (size_t)op->sent;
+    for (i = 0; i < op->nbufs && n > 0; ++i) {
+        size_t len = bytebuf_readable_size(op->bufs[i]);
+        if (len > n)
+            len = n;
+        op->bufs[i]->r += (uint32_t)len;
+        n -= len;
+    }
+    if (!op->cancelled && op->proc.send != NULL)
+        op->proc.send(u, op->fd, op->err != 0 ? op->err : op->sent, op->clientData);
+    free_uring_op(op);
+}
+
+static void uring_reap(ez_uring_t* u)
+{
+    unsigned head, tail;
+    struct io_uring_cqe* cqe;
+    ez_uring_op_t* op;
+
+    u->in_reap = 1;
+    for (;;) {
+        head = *u->cq_head;
+        tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            // 完成队列满时内核把多出的完成事件暂存起来, 要 io_uring_enter 才会搬回队列.
+            if (!(__atomic_load_n(u->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW))
+                break;
+            if (uring_enter(u->fd, 0, 0, IORING_ENTER_GETEVENTS) == -1 && errno != EINTR)
+                break;
+            continue;
+        }
+        for (; head != tail; ++head) {
+            cqe = &u->cqes[head & u->cq_mask];
+            op = (ez_uring_op_t*)(uintptr_t)cqe->user_data;
+            if (op != NULL) {
+                switch (op->type) {
+                case URING_OP_ACCEPT:
+                    uring_complete_accept(u, op, cqe);
+                    break;
+                case URING_OP_RECV:
+                    uring_complete_recv(u, op, cqe);
+                    break;
+                case URING_OP_SEND:
+                    uring_complete_send(u, op, cqe);
+                    break;
+                }
+            }
+            __atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+        }
+    }
+    u->in_reap = 0;
+    uring_submit(u);
+}
+
+static void uring_event_proc(ez_event_loop_t* eventLoop, int fd, void* clientData, int mask)
+{
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(fd);
+    EZ_NOTUSED(mask);
+    uring_reap((ez_uring_t*)clientData);
+}
+
+static int uring_map(ez_uring_t* u, struct io_uring_params* p)
+{
+    u->sq_ring_size = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    u->cq_ring_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_ring_size > u->sq_ring_size)
+            u->sq_ring_size = u->cq_ring_size;
+        u->cq_ring_size = u->sq_ring_size;
+    }
+    u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if (u->sq_ring == MAP_FAILED)
+        return ANET_ERR;
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        u->cq_ring = u->sq_ring;
+    } else {
+        u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+        if (u->cq_ring == MAP_FAILED)
+            return ANET_ERR;
+    }
+    u->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        return ANET_ERR;
+    }
+
+    u->sq_head = (unsigned*)((char*)u->sq_ring + p->sq_off.head);
+    u->sq_tail = (unsigned*)((char*)u->sq_ring + p->sq_off.tail);
+    u->sq_flags = (unsigned*)((char*)u->sq_ring + p->sq_off.flags);
+    u->sq_mask = *(unsigned*)((char*)u->sq_ring + p->sq_off.ring_mask);
+    u->sq_entries = p->sq_entries;
+    u->sq_local_tail = *u->sq_tail;
+    u->cq_head = (unsigned*)((char*)u->cq_ring + p->cq_off.head);
+    u->cq_tail = (unsigned*)((char*)u->cq_ring + p->cq_off.tail);
+    u->cq_mask = *(unsigned*)((char*)u->cq_ring + p->cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*)((char*)u->cq_ring + p->cq_off.cqes);
+    return ANET_OK;
+}
+
+/* sq array 固定为 i -> i, sqe 按环形顺序使用 */
+static void uring_init_sq_array(ez_uring_t* u, struct io_uring_params* p)
+{
+    unsigned* array = (unsigned*)((char*)u->sq_ring + p->sq_off.array);
+    unsigned i;
+    for (i = 0; i < p->sq_entries; ++i)
+        array[i] = i;
+}
+
+static int uring_setup_bufs(ez_uring_t* u, unsigned nbufs, unsigned buf_size)
+{
+    struct io_uring_buf_reg reg;
+    unsigned i;
+
+    u->br_size = nbufs * sizeof(struct io_uring_buf);
+    u->br = mmap(NULL, u->br_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (u->br == MAP_FAILED) {
+        u->br = NULL;
+        return ANET_ERR;
+    }
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)u->br;
+    reg.ring_entries = nbufs;
+    reg.bgid = URING_BGID;
+    if (uring_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1) {
+        log_error("io_uring register buf ring: %s", strerror(errno));
+        return ANET_ERR;
+    }
+
+    u->br_mask = nbufs - 1;
+    u->br_tail = 0;
+    u->buf_size = buf_size;
+    u->buf_base = ez_malloc((size_t)nbufs * buf_size);
+    for (i = 0; i < nbufs; ++i)
+        uring_buf_recycle(u, (uint16_t)i);
+    return ANET_OK;
+}
+
+ez_uring_t* new_uring(ez_event_loop_t* eventLoop, unsigned entries, unsigned nbufs, unsigned buf_size)
+{
+    struct io_uring_params p;
+    ez_uring_t* u;
+
+    if (nbufs == 0 || nbufs > URING_BUFS_MAX || (nbufs & (nbufs - 1)) != 0 || buf_size == 0)
+        return NULL;
+
+    u = ez_malloc(sizeof(ez_uring_t));
+    memset(u, 0, sizeof(ez_uring_t));
+    u->loop = eventLoop;
+    init_list_head(&u->ops);
+
+    // multishot 的完成事件比提交多得多, 完成队列按缓冲个数放大.
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+    p.cq_entries = nbufs > entries * 2 ? nbufs : entries * 2;
+    if ((u->fd = uring_setup(entries, &p)) == -1) {
+        log_error("io_uring_setup: %s", strerror(errno));
+        ez_free(u);
+        return NULL;
+    }
+    if (uring_map(u, &p) != ANET_OK || uring_setup_bufs(u, nbufs, buf_size) != ANET_OK)
+        goto error;
+    uring_init_sq_array(u, &p);
+    if (ez_create_file_event(eventLoop, u->fd, AE_READABLE, uring_event_proc, u) == AE_ERR)
+        goto error;
+    return u;
+
+error:
+    u->loop = NULL;
+    free_uring(u);
+    return NULL;
+}
+
+void free_uring(ez_uring_t* u)
+{
+    if (u == NULL)
+        return;
+    if (u->loop != NULL)
+        ez_delete_file_event(u->loop, u->fd, AE_READABLE);
+    LIST_FOR(&u->ops, pos)
+    {
+        ez_uring_op_t* op = EZ_CONTAINER_OF(pos, ez_uring_op_t, node);
+        free_uring_op(op);
+    }
+    // 关闭 ring 时内核取消所有请求并注销缓冲池.
+    close(u->fd);
+    if (u->sqes != NULL)
+        munmap(u->sqes, u->sqes_size);
+    if (u->cq_ring != NULL && u->cq_ring != MAP_FAILED && u->cq_ring != u->sq_ring)
+        munmap(u->cq_ring, u->cq_ring_size);
+    if (u->sq_ring != NULL && u->sq_ring != MAP_FAILED)
+        munmap(u->sq_ring, u->sq_ring_size);
+    if (u->br != NULL)
+        munmap(u->br, u->br_size);
+    if (u->buf_base != NULL)
+        ez_free(u->buf_base);
+    ez_free(u);
+}
+
+ez_uring_op_t* uring_accept(ez_uring_t* u, int listen_fd, ezUringAcceptProc proc, void* clientData)
+{
+    ez_uring_op_t* op;
+
+    if (uring_reserve(u, 1) != ANET_OK)
+        return NULL;
+    op = new_uring_op(u, URING_OP_ACCEPT, listen_fd, clientData, 0);
+    op->proc.accept = proc;
+    uring_prep_accept(u, op);
+    uring_flush(u);
+    return op;
+}
+
+ez_uring_op_t* uring_recv(ez_uring_t* u, int fd, ezUringRecvProc proc, void* clientData)
+{
+    ez_uring_op_t* op;
+
+    if (uring_reserve(u, 1) != ANET_OK)
+        return NULL;
+    op = new_uring_op(u, URING_OP_RECV, fd, clientData, 0);
+    op->proc.recv = proc;
+    uring_prep_recv(u, op);
+    uring_flush(u);
+    return op;
+}
+
+int uring_cancel(ez_uring_t* u, ez_uring_op_t* op)
+{
+    struct io_uring_sqe* sqe;
+
+    if (op->cancelled)
+        return ANET_OK;
+    if (uring_reserve(u, 1) != ANET_OK)
+        return ANET_ERR;
+    op->cancelled = 1;
+    // 取消请求本身的完成事件 user_data 为 0, 直接忽略; op 在最后一个完成事件时释放.
+    sqe = uring_get_sqe(u, NULL);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)op;
+    return uring_flush(u);
+}
+
+int uring_send(ez_uring_t* u, int fd, bytebuf_t** bufs, int nbufs, ezUringSendProc proc, void* clientData)
+{
+    struct io_uring_sqe* sqe;
+    ez_uring_op_t* op;
+    int i;
+
+    // 一条链必须在同一次 io_uring_enter 中提交.
+    if (nbufs <= 0 || uring_reserve(u, (unsigned)nbufs) != ANET_OK)
+        return ANET_ERR;
+    op = new_uring_op(u, URING_OP_SEND, fd, clientData, nbufs);
+    op->proc.send = proc;
+    op->pending = nbufs;
+    for (i = 0; i < nbufs; ++i) {
+        op->bufs[i] = bufs[i];
+        sqe = uring_get_sqe(u, op);
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)bytebuf_reader_pos(bufs[i]);
+        sqe->len = bytebuf_readable_size(bufs[i]);
+        // MSG_WAITALL: 短写时内核继续发送, 不会打断链.
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        if (i < nbufs - 1)
+            sqe->flags = IOSQE_IO_LINK;
+    }
+    return uring_flush(u);
+}
+
+uint64_t uring_nobufs(ez_uring_t* u)
+{
+    return u->nobufs;
+}
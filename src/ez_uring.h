@@ -0,0 +1,55 @@
+#ifndef EZ_URING_H
+#define EZ_URING_H
+
+#include "ez_bytebuf.h"
+#include "ez_event.h"
+
+#include <stdint.h>
+#include <sys/types.h>
+
+//
+// 基于 io_uring 完成事件的网络收发(直接使用系统调用, 不依赖 liburing).
+// - 多次触发(multishot)的 accept: 一次提交, 每个新连接一个完成事件.
+// - 多次触发的 recv: 数据读入内核从共享缓冲池(provided buffer ring)中选出的缓冲,
+//   连接空闲时不占用任何接收缓冲, 大量空闲连接时省掉每个连接自己的输入 bytebuf.
+// - 链式 send: 多个 bytebuf 用 IOSQE_IO_LINK 串成一条链, 按顺序发出, 全部完成后回调一次.
+// ring fd 注册在事件循环中, 完成事件在循环中以回调的方式交付.
+// 需要 Linux 6.0 以上(multishot recv).
+//
+typedef struct ez_uring_s ez_uring_t;
+typedef struct ez_uring_op_s ez_uring_op_t;
+
+/* fd < 0 时为 -errno, 此后不再回调, 需要重新 uring_accept */
+typedef void (*ezUringAcceptProc)(ez_uring_t* u, int listen_fd, int fd, void* clientData);
+
+/* res > 0: in 中有 res 字节, 指向共享缓冲, 回调返回后缓冲被收回, 未处理完的数据需自行拷贝.
+   res == 0: 对端关闭; res < 0: -errno. 这两种情况 in 为 NULL, 之后不再回调, op 已失效. */
+typedef void (*ezUringRecvProc)(ez_uring_t* u, int fd, bytebuf_t* in, int res, void* clientData);
+
+/* res 为发出的总字节数, 出错为第一个错误的 -errno */
+typedef void (*ezUringSendProc)(ez_uring_t* u, int fd, ssize_t res, void* clientData);
+
+/* entries: 提交队列大小; 共享接收缓冲 nbufs 个(2 的幂, 不超过 32768), 每个 buf_size 字节 */
+ez_uring_t* new_uring(ez_event_loop_t* eventLoop, unsigned entries, unsigned nbufs, unsigned buf_size);
+
+/* 丢弃未完成的请求, 不会再回调 */
+void free_uring(ez_uring_t* u);
+
+/* 新连接为非阻塞且 close-on-exec, 失败返回 NULL */
+ez_uring_op_t* uring_accept(ez_uring_t* u, int listen_fd, ezUringAcceptProc proc, void* clientData);
+
+/* 缓冲池暂时用完时内部会重新提交, 调用方不用处理 ENOBUFS. 失败返回 NULL */
+ez_uring_op_t* uring_recv(ez_uring_t* u, int fd, ezUringRecvProc proc, void* clientData);
+
+/* 取消 accept/recv, 之后不再回调; 可以在回调中调用.
+   io_uring 持有 fd 的引用, close(fd) 之前必须先取消, 否则连接不会真正关闭. */
+int uring_cancel(ez_uring_t* u, ez_uring_op_t* op);
+
+/* 依次发送 bufs 的可读部分, 完成的部分推进 buf->r; 回调前 bufs 不能修改或释放.
+   返回 ANET_OK/ANET_ERR(提交队列放不下整条链) */
+int uring_send(ez_uring_t* u, int fd, bytebuf_t** bufs, int nbufs, ezUringSendProc proc, void* clientData);
+
+/* 共享缓冲用完的次数, 过多时应加大 nbufs */
+uint64_t uring_nobufs(ez_uring_t* u);
+
+#endif // EZ_URING_H
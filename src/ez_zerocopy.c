@@ -0,0 +1,177 @@
+#include "ez_zerocopy.h"
+
+#include "ez_log.h"
+#include "ez_macro.h"
+#include "ez_malloc.h"
+#include "ez_net.h"
+
+#include <errno.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+
+typedef struct zc_entry_s {
+    bytebuf_t* buf;
+    int last; /* buf 的最后一次发送, 确认后释放 buf */
+    int done; /* 已收到完成通知 */
+} zc_entry_t;
+
+struct ez_zerocopy_s {
+    int fd;
+    uint32_t head_seq; /* q[head] 对应的通知序号 */
+    uint32_t head;
+    uint32_t count;
+    uint32_t cap; /* power of 2 */
+    zc_entry_t* q;
+    uint64_t copied;
+    ezZeroCopyProc proc;
+    void* clientData;
+};
+
+#define ZC_INIT_CAP 64
+
+static void zerocopy_release(ez_zerocopy_t* zc, bytebuf_t* buf)
+{
+    if (zc->proc != NULL)
+        zc->proc(buf, zc->clientData);
+    else
+        free_bytebuf(buf);
+}
+
+static void zerocopy_push(ez_zerocopy_t* zc, bytebuf_t* buf, int last)
+{
+    uint32_t i;
+    if (zc->count == zc->cap) {
+        // 扩容并把环展开成从 0 开始
+        zc_entry_t* q = ez_malloc(sizeof(zc_entry_t) * zc->cap * 2);
+        for (i = 0; i < zc->count; ++i)
+            q[i] = zc->q[(zc->head + i) & (zc->cap - 1)];
+        ez_free(zc->q);
+        zc->q = q;
+        zc->head = 0;
+        zc->cap *= 2;
+    }
+    zc_entry_t* e = &zc->q[(zc->head + zc->count) & (zc->cap - 1)];
+    e->buf = buf;
+    e->last = last;
+    e->done = 0;
+    zc->count++;
+}
+
+ez_zerocopy_t* new_zerocopy(int fd, ezZeroCopyProc proc, void* clientData)
+{
+    if (ez_net_set_zerocopy(fd) != ANET_OK)
+        return NULL;
+
+    ez_zerocopy_t* zc = ez_malloc(sizeof(ez_zerocopy_t));
+    zc->fd = fd;
+    zc->head_seq = 0;
+    zc->head = 0;
+    zc->count = 0;
+    zc->cap = ZC_INIT_CAP;
+    zc->q = ez_malloc(sizeof(zc_entry_t) * zc->cap);
+    zc->copied = 0;
+    zc->proc = proc;
+    zc->clientData = clientData;
+    return zc;
+}
+
+void free_zerocopy(ez_zerocopy_t* zc)
+{
+    uint32_t i;
+    if (zc == NULL)
+        return;
+    for (i = 0; i < zc->count; ++i) {
+        zc_entry_t* e = &zc->q[(zc->head + i) & (zc->cap - 1)];
+        if (e->last)
+            zerocopy_release(zc, e->buf);
+    }
+    ez_free(zc->q);
+    ez_free(zc);
+}
+
+int zerocopy_write_bf(ez_zerocopy_t* zc, bytebuf_t* buf, ssize_t* nbytes)
+{
+    *nbytes = 0;
+    if (!bytebuf_is_readable(buf))
+        return ANET_OK;
+
+    int r = ez_net_write_zerocopy(zc->fd, (char*)bytebuf_reader_pos(buf), bytebuf_readable_size(buf), nbytes);
+    if (r == ANET_OK && *nbytes > 0) {
+        // 每次成功的 send 占用一个通知序号.
+        buf->r += *nbytes;
+        zerocopy_push(zc, buf, !bytebuf_is_readable(buf));
+    }
+    return r;
+}
+
+static void zerocopy_complete(ez_zerocopy_t* zc, uint32_t lo, uint32_t hi, int copied)
+{
+    uint32_t seq, idx;
+    for (seq = lo;; ++seq) {
+        idx = seq - zc->head_seq;
+        if (idx < zc->count)
+            zc->q[(zc->head + idx) & (zc->cap - 1)].done = 1;
+        if (copied)
+            zc->copied++;
+        if (seq == hi)
+            break;
+    }
+}
+
+int zerocopy_reap(ez_zerocopy_t* zc)
+{
+    char control[128];
+    struct msghdr msg;
+    struct cmsghdr* cm;
+    struct sock_extended_err* serr;
+    int released = 0;
+
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(zc->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+            if (errno == EAGAIN || errno == EINTR)
+                break;
+            log_error("recvmsg MSG_ERRQUEUE fd:%d: %s", zc->fd, strerror(errno));
+            return ANET_ERR;
+        }
+
+        for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                    || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+                continue;
+            serr = (struct sock_extended_err*)CMSG_DATA(cm);
+            if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+            // [ee_info, ee_data] 区间的发送已完成
+            zerocopy_complete(zc, serr->ee_info, serr->ee_data, serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+        }
+    }
+
+    // 按发送顺序出队, 保证 buf 之前的发送都已确认后才释放.
+    while (zc->count > 0 && zc->q[zc->head].done) {
+        zc_entry_t* e = &zc->q[zc->head];
+        zc->head = (zc->head + 1) & (zc->cap - 1);
+        zc->head_seq++;
+        zc->count--;
+        if (e->last) {
+            zerocopy_release(zc, e->buf);
+            released++;
+        }
+    }
+    return released;
+}
+
+uint32_t zerocopy_pending(ez_zerocopy_t* zc)
+{
+    return zc->count;
+}
+
+uint64_t zerocopy_copied(ez_zerocopy_t* zc)
+{
+    return zc->copied;
+}
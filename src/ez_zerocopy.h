@@ -0,0 +1,41 @@
+#ifndef EZ_ZEROCOPY_H
+#define EZ_ZEROCOPY_H
+
+#include "ez_bytebuf.h"
+
+#include <stdint.h>
+#include <sys/types.h>
+
+//
+// MSG_ZEROCOPY 发送: 内核直接引用用户页, buf 在完成通知(MSG_ERRQUEUE)到达前
+// 由 ez_zerocopy_t 持有, 通知到达后通过 release 回调交还.
+// 只对大块数据(64K 以上)有收益, 小包用 ez_net_write 拷贝更快, 参见 test/zerocopy_bench.c.
+//
+typedef struct ez_zerocopy_s ez_zerocopy_t;
+
+/* buf 的所有发送都已被内核确认, 可以重用或释放 */
+typedef void (*ezZeroCopyProc)(bytebuf_t* buf, void* clientData);
+
+/* fd 需已连接, 内部会调用 ez_net_set_zerocopy(fd); proc 为 NULL 时直接 free_bytebuf */
+ez_zerocopy_t* new_zerocopy(int fd, ezZeroCopyProc proc, void* clientData);
+
+/* 释放仍未确认的 buf, 需在 close(fd) 之后调用, 不能在 release 回调中调用 */
+void free_zerocopy(ez_zerocopy_t* zc);
+
+/* 发送 buf 的可读部分并推进 buf->r, 返回值同 ez_net_write.
+   成功写出后 buf 归 zc 所有, 直到 release 回调; buf 未写完时可以再次调用. */
+int zerocopy_write_bf(ez_zerocopy_t* zc, bytebuf_t* buf, ssize_t* nbytes);
+
+/* 读取 MSG_ERRQUEUE 中的完成通知, 释放已确认的 buf.
+   通知到达时 epoll 报告 EPOLLERR, 应在 fd 事件回调的 mask 带 AE_ERROR 时调用
+   (ez_conn 的连接用 conn_set_error_proc); 不读的话 EPOLLERR 一直存在, 事件循环会空转.
+   返回释放的 buf 个数, 出错返回 ANET_ERR. */
+int zerocopy_reap(ez_zerocopy_t* zc);
+
+/* 尚未确认的发送次数 */
+uint32_t zerocopy_pending(ez_zerocopy_t* zc);
+
+/* 内核回退为拷贝的发送次数(如 loopback、网卡不支持 SG), 过多时应关闭 zerocopy */
+uint64_t zerocopy_copied(ez_zerocopy_t* zc);
+
+#endif // EZ_ZEROCOPY_H
@@ -0,0 +1,714 @@
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <ez_conn.h>
+#include <ez_conn_pool.h>
+#include <ez_connect.h>
+#include <ez_event.h>
+#include <ez_macro.h>
+#include <ez_net.h>
+#include <ez_test.h>
+#include <ez_util.h>
+
+typedef struct conn_state_s {
+    int high;
+    int low;
+    int closed;
+    int reason;
+} conn_state_t;
+
+static void test_read(ez_conn_t* conn, bytebuf_t* in, void* data)
+{
+    EZ_NOTUSED(conn);
+    EZ_NOTUSED(data);
+    in->r = in->w;
+}
+
+static void test_close(ez_conn_t* conn, int reason, void* data)
+{
+    EZ_NOTUSED(conn);
+    conn_state_t* st = (conn_state_t*)data;
+    st->closed++;
+    st->reason = reason;
+}
+
+static void test_watermark(ez_conn_t* conn, int high, void* data)
+{
+    EZ_NOTUSED(conn);
+    conn_state_t* st = (conn_state_t*)data;
+    if (high)
+        st->high++;
+    else
+        st->low++;
+}
+
+static int test_stop(ez_event_loop_t* eventLoop, int64_t timeId, void* data)
+{
+    EZ_NOTUSED(timeId);
+    EZ_NOTUSED(data);
+    ez_stop_event_loop(eventLoop);
+    return AE_TIMER_END;
+}
+
+/* 跑一小段时间的事件循环 */
+static void run_loop_for(ez_event_loop_t* loop, int64_t ms)
+{
+    ez_create_time_event(loop, ms, test_stop, NULL);
+    ez_run_event_loop(loop);
+}
+
+static void drain_fd(int fd)
+{
+    char buf[64 * 1024];
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+}
+
+TEST(conn, watermark)
+{
+    int sv[2];
+    conn_state_t st = { 0, 0, 0, 0 };
+    char chunk[4096];
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    ez_net_set_non_block(sv[0]);
+    ez_net_set_non_block(sv[1]);
+
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_conn_group_t* g = new_conn_group(loop, 1024);
+    ez_conn_t* c = new_conn(g, sv[0], test_read, test_close, &st);
+    conn_set_watermark(c, 16 * 1024, 256 * 1024, test_watermark);
+
+    // 对端不读, 输出堆积到高水位后暂停读取.
+    memset(chunk, 'a', sizeof(chunk));
+    while (st.high == 0)
+        conn_write(c, chunk, sizeof(chunk));
+    ASSERT_EQ(st.high, 1);
+    ASSERT_EQ(conn_read_paused(c), CONN_PAUSE_WATERMARK);
+
+    // 对端读完后, 输出写到低水位以下恢复读取.
+    while (conn_output_size(c) > 0) {
+        drain_fd(sv[1]);
+        run_loop_for(loop, 10);
+    }
+    ASSERT_EQ(st.low, 1);
+    ASSERT_EQ(conn_read_paused(c), 0);
+
+    drain_fd(sv[1]);
+    ez_net_close_socket(sv[1]);
+    run_loop_for(loop, 10);
+    ASSERT_EQ(st.closed, 1);
+    ASSERT_EQ(st.reason, CONN_CLOSE_EOF);
+    ASSERT_EQ(conn_group_count(g), 0);
+
+    free_conn_group(g);
+    ez_delete_event_loop(loop);
+}
+
+typedef struct connect_result_s {
+    int fd;
+    int status;
+    int called;
+} connect_result_t;
+
+static void test_connect(ez_event_loop_t* eventLoop, int fd, int status, void* data)
+{
+    EZ_NOTUSED(eventLoop);
+    connect_result_t* r = (connect_result_t*)data;
+    r->fd = fd;
+    r->status = status;
+    r->called++;
+}
+
+TEST(conn, async_connect)
+{
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    int s = ez_net_tcp_server(9095, "127.0.0.1", 16);
+    ASSERT_GE(s, 0);
+
+    // localhost 可能先解析到 ::1, 失败后回退到 127.0.0.1.
+    connect_result_t ok = { -1, 0, 0 };
+    connect_result_t refused = { -1, 0, 0 };
+    connect_result_t cancelled = { -1, 0, 0 };
+    ez_net_async_connect(loop, "localhost", 9095, 1000, test_connect, &ok);
+    ez_net_async_connect(loop, "127.0.0.1", 9096, 1000, test_connect, &refused);
+    ez_net_async_connect_cancel(ez_net_async_connect(loop, "127.0.0.1", 9095, 1000, test_connect, &cancelled));
+    run_loop_for(loop, 100);
+
+    ASSERT_EQ(ok.called, 1);
+    ASSERT_EQ(ok.status, ANET_OK);
+    ASSERT_GE(ok.fd, 0);
+    ASSERT_EQ(refused.called, 1);
+    ASSERT_EQ(refused.status, ANET_ERR);
+    ASSERT_EQ(cancelled.called, 0);
+
+    ez_net_close_socket(ok.fd);
+    ez_net_close_socket(s);
+    ez_delete_event_loop(loop);
+}
+
+TEST(conn, pool)
+{
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_conn_pool_stats_t stats;
+    int s = ez_net_tcp_server(9097, "127.0.0.1", 16);
+    ASSERT_GE(s, 0);
+
+    ez_conn_pool_t* p = new_conn_pool(loop, 1, 50, 1000);
+    connect_result_t a = { -1, 0, 0 };
+    connect_result_t b = { -1, 0, 0 };
+
+    // 第一次新建连接, 第二次达到上限排队.
+    ASSERT_EQ(conn_pool_get(p, "127.0.0.1", 9097, test_connect, &a), ANET_OK);
+    ASSERT_EQ(conn_pool_get(p, "127.0.0.1", 9097, test_connect, &b), ANET_OK);
+    run_loop_for(loop, 20);
+    ASSERT_EQ(a.called, 1);
+    ASSERT_EQ(a.status, ANET_OK);
+    ASSERT_EQ(b.called, 0);
+
+    // 放回后直接交给排队的请求.
+    int peer = accept(s, NULL, NULL);
+    ASSERT_GE(peer, 0);
+    conn_pool_put(p, "127.0.0.1", 9097, a.fd);
+    ASSERT_EQ(b.called, 1);
+    ASSERT_EQ(b.fd, a.fd);
+
+    // 放回后命中空闲连接.
+    conn_pool_put(p, "127.0.0.1", 9097, b.fd);
+    ASSERT_EQ(conn_pool_idle_count(p, "127.0.0.1", 9097), 1);
+    a.called = 0;
+    conn_pool_get(p, "127.0.0.1", 9097, test_connect, &a);
+    ASSERT_EQ(a.called, 1);
+    ASSERT_EQ(a.fd, b.fd);
+
+    // 对端关闭的空闲连接被健康检查关闭.
+    conn_pool_put(p, "127.0.0.1", 9097, a.fd);
+    ez_net_close_socket(peer);
+    run_loop_for(loop, 10);
+    ASSERT_EQ(conn_pool_total_count(p, "127.0.0.1", 9097), 0);
+
+    // 空闲超时.
+    a.called = 0;
+    conn_pool_get(p, "127.0.0.1", 9097, test_connect, &a);
+    run_loop_for(loop, 20);
+    ASSERT_EQ(a.status, ANET_OK);
+    conn_pool_put(p, "127.0.0.1", 9097, a.fd);
+    run_loop_for(loop, 120);
+    ASSERT_EQ(conn_pool_idle_count(p, "127.0.0.1", 9097), 0);
+
+    conn_pool_stats(p, &stats);
+    ASSERT_EQ(stats.misses, 2);
+    ASSERT_EQ(stats.hits, 2);
+    ASSERT_EQ(stats.waits, 1);
+    ASSERT_EQ(stats.broken_closed, 1);
+    ASSERT_EQ(stats.idle_closed, 1);
+
+    free_conn_pool(p);
+    ez_net_close_socket(s);
+    ez_delete_event_loop(loop);
+}
+
+TEST(conn, fastopen)
+{
+    char buf[64];
+    ssize_t nbytes = 0;
+    int s = ez_net_tcp_fastopen_server(9098, "127.0.0.1", 16, 16);
+    ASSERT_GE(s, 0);
+
+    // 第一次没有 cookie, 数据不会随 SYN 发出; 第二次视 sysctl 而定.
+    for (int i = 0; i < 2; ++i) {
+        int c = ez_net_tcp_fastopen_connect("127.0.0.1", 9098, "ping", 4, &nbytes);
+        ASSERT_GE(c, 0);
+        ASSERT_EQ(nbytes == 0 || nbytes == 4, 1);
+
+        struct pollfd pfd = { c, POLLOUT, 0 };
+        ASSERT_EQ(poll(&pfd, 1, 1000), 1);
+        if (nbytes == 0)
+            ASSERT_EQ(write(c, "ping", 4), 4);
+
+        pfd.fd = s;
+        pfd.events = POLLIN;
+        ASSERT_EQ(poll(&pfd, 1, 1000), 1);
+        int peer = accept(s, NULL, NULL);
+        ASSERT_GE(peer, 0);
+        pfd.fd = peer;
+        ASSERT_EQ(poll(&pfd, 1, 1000), 1);
+        ASSERT_EQ(read(peer, buf, sizeof(buf)), 4);
+        ASSERT_EQ(memcmp(buf, "ping", 4), 0);
+
+        ez_net_close_socket(peer);
+        ez_net_close_socket(c);
+    }
+    ez_net_close_socket(s);
+}
+
+TEST(conn, cork)
+{
+    int sv[2];
+    char buf[64];
+    conn_state_t st = { 0, 0, 0, 0 };
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    ez_net_set_non_block(sv[0]);
+    ez_net_set_non_block(sv[1]);
+
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_conn_group_t* g = new_conn_group(loop, 1024);
+    ez_conn_t* c = new_conn(g, sv[0], test_read, test_close, &st);
+
+    // cork 期间只入队, uncork 后一次写出.
+    conn_cork(c);
+    conn_write(c, "HTTP/1.1 200 OK\r\n", 17);
+    conn_write(c, "\r\n", 2);
+    ASSERT_EQ(conn_output_size(c), 19);
+    ASSERT_EQ(read(sv[1], buf, sizeof(buf)), -1);
+    ASSERT_EQ(conn_uncork(c), ANET_OK);
+    ASSERT_EQ(conn_output_size(c), 0);
+    ASSERT_EQ(read(sv[1], buf, sizeof(buf)), 19);
+
+    conn_close(c);
+    ASSERT_EQ(st.closed, 1);
+    ez_net_close_socket(sv[1]);
+    free_conn_group(g);
+    ez_delete_event_loop(loop);
+}
+
+TEST(conn, notsent_lowat)
+{
+    static char bulk[1024 * 1024];
+    static char out[1024 * 1024 + 16];
+    conn_state_t st = { 0, 0, 0, 0 };
+    size_t total = 0;
+    ssize_t r;
+
+    int s = ez_net_tcp_server(9099, "127.0.0.1", 16);
+    ASSERT_GE(s, 0);
+    int fd = ez_net_tcp_connect("127.0.0.1", 9099);
+    ASSERT_GE(fd, 0);
+    int peer = accept(s, NULL, NULL);
+    ASSERT_GE(peer, 0);
+    ez_net_set_non_block(fd);
+    ez_net_set_non_block(peer);
+
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_conn_group_t* g = new_conn_group(loop, 4096);
+    ez_conn_t* c = new_conn(g, fd, test_read, test_close, &st);
+    ASSERT_EQ(conn_set_notsent_lowat(c, 16 * 1024), ANET_OK);
+
+    // 大部分数据留在输出队列中, 插队的数据很快就能发出.
+    memset(bulk, 'a', sizeof(bulk));
+    conn_write(c, bulk, sizeof(bulk));
+    ASSERT_GE(conn_output_size(c), sizeof(bulk) / 2);
+    conn_write_urgent(c, "URGENT", 6);
+
+    while (total < sizeof(bulk) + 6) {
+        while ((r = read(peer, out + total, sizeof(out) - total)) > 0)
+            total += (size_t)r;
+        run_loop_for(loop, 1);
+    }
+    ASSERT_EQ(total, sizeof(bulk) + 6);
+    char* u = memchr(out, 'U', total);
+    ASSERT_EQ(u != NULL, 1);
+    ASSERT_EQ(memcmp(u, "URGENT", 6), 0);
+    ASSERT_EQ((size_t)(u - out) < sizeof(bulk) / 2, 1);
+
+    // 关闭后套接字上的值回到 0, 即跟随 sysctl.
+    int lowat = -1;
+    socklen_t optlen = sizeof(lowat);
+    ASSERT_EQ(conn_set_notsent_lowat(c, 0), ANET_OK);
+    ASSERT_EQ(getsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, &optlen), 0);
+    ASSERT_EQ(lowat, 0);
+
+    conn_close(c);
+    ez_net_close_socket(peer);
+    ez_net_close_socket(s);
+    free_conn_group(g);
+    ez_delete_event_loop(loop);
+}
+
+TEST(conn, tcp_info)
+{
+    ez_tcp_info_t info;
+    conn_state_t st = { 0, 0, 0, 0 };
+    int sv[2];
+
+    int s = ez_net_tcp_server(9100, "127.0.0.1", 16);
+    ASSERT_GE(s, 0);
+    int fd = ez_net_tcp_connect("127.0.0.1", 9100);
+    ASSERT_GE(fd, 0);
+    int peer = accept(s, NULL, NULL);
+    ASSERT_GE(peer, 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+
+    ASSERT_EQ(write(fd, "ping", 4), 4);
+    ASSERT_EQ(ez_net_tcp_info(fd, &info), ANET_OK);
+    ASSERT_GE(info.snd_cwnd, 1);
+    ASSERT_GE(info.snd_mss, 1);
+    ASSERT_EQ(ez_net_tcp_info(sv[0], &info), ANET_ERR);
+
+    // unix socket 不参与采样.
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_conn_group_t* g = new_conn_group(loop, 1024);
+    ASSERT_EQ(conn_group_tcp_stats(g) == NULL, 1);
+    new_conn(g, fd, test_read, test_close, &st);
+    new_conn(g, sv[0], test_read, test_close, &st);
+    conn_group_sample_tcp_info(g, 10);
+    run_loop_for(loop, 55);
+
+    ez_conn_tcp_stats_t* ts = conn_group_tcp_stats(g);
+    ASSERT_GE(ts->samples, 3);
+    ASSERT_EQ(ts->rtt_us->count, ts->samples);
+    ASSERT_GE(histogram_percentile(ts->snd_cwnd, 50), 1);
+    conn_group_reset_tcp_stats(g);
+    ASSERT_EQ(ts->samples, 0);
+
+    free_conn_group(g);
+    ez_net_close_socket(sv[1]);
+    ez_net_close_socket(peer);
+    ez_net_close_socket(s);
+    ez_delete_event_loop(loop);
+}
+
+typedef struct drain_result_s {
+    ez_event_loop_t* loop;
+    ez_conn_drain_stats_t stats;
+    int progress;
+    int done;
+} drain_result_t;
+
+static void test_drain(ez_conn_group_t* g, const ez_conn_drain_stats_t* stats, int done, void* data)
+{
+    drain_result_t* r = (drain_result_t*)data;
+    EZ_NOTUSED(g);
+    r->stats = *stats;
+    if (done) {
+        r->done++;
+        ez_stop_event_loop(r->loop);
+    } else {
+        r->progress++;
+    }
+}
+
+static int drain_peer_later(ez_event_loop_t* eventLoop, int64_t timeId, void* data)
+{
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(timeId);
+    drain_fd(*(int*)data);
+    return AE_TIMER_NEXT;
+}
+
+TEST(conn, drain)
+{
+    conn_state_t st = { 0, 0, 0, 0 };
+    drain_result_t r;
+    int idle[2], slow[2], stuck[2], extra[2];
+    char chunk[4096];
+
+    memset(&r, 0, sizeof(r));
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, idle), 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, slow), 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, stuck), 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, extra), 0);
+    ez_net_set_non_block(idle[0]);
+    ez_net_set_non_block(slow[0]);
+    ez_net_set_non_block(slow[1]);
+    ez_net_set_non_block(stuck[0]);
+
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_conn_group_t* g = new_conn_group(loop, 1024);
+    r.loop = loop;
+    new_conn(g, idle[0], test_read, test_close, &st);
+    ez_conn_t* cs = new_conn(g, slow[0], test_read, test_close, &st);
+    ez_conn_t* ct = new_conn(g, stuck[0], test_read, test_close, &st);
+
+    // slow 和 stuck 的输出都超过 socket 缓冲, 只有 slow 的对端之后会读.
+    memset(chunk, 'a', sizeof(chunk));
+    while (conn_output_size(cs) == 0 || conn_output_size(ct) == 0) {
+        conn_write(cs, chunk, sizeof(chunk));
+        conn_write(ct, chunk, sizeof(chunk));
+    }
+
+    ASSERT_EQ(conn_group_drain(g, 500, test_drain, &r), ANET_OK);
+    ASSERT_EQ(conn_group_drain(g, 500, test_drain, &r), ANET_ERR);
+    ASSERT_EQ(conn_group_draining(g), 1);
+    ASSERT_EQ(new_conn(g, extra[0], test_read, test_close, &st) == NULL, 1);
+
+    int64_t reader = ez_create_time_event(loop, 150, drain_peer_later, &slow[1]);
+    ez_run_event_loop(loop);
+    ez_delete_time_event(loop, reader);
+
+    ASSERT_EQ(r.done, 1);
+    // 500ms 的 drain 跨了好几个 100ms 的 tick
+    ASSERT_EQ(r.progress >= 1, 1);
+    ASSERT_EQ(conn_group_draining(g), 0);
+    ASSERT_EQ(conn_group_count(g), 0);
+    ASSERT_EQ(r.stats.total, 3);
+    ASSERT_EQ(r.stats.remaining, 0);
+    ASSERT_EQ(r.stats.idle_closed, 2);
+    ASSERT_EQ(r.stats.forced, 1);
+    ASSERT_EQ(r.stats.elapsed_ms >= 500, 1);
+    ASSERT_EQ(st.closed, 3);
+
+    free_conn_group(g);
+    ez_net_close_socket(idle[1]);
+    ez_net_close_socket(slow[1]);
+    ez_net_close_socket(stuck[1]);
+    ez_net_close_socket(extra[0]);
+    ez_net_close_socket(extra[1]);
+    ez_delete_event_loop(loop);
+}
+
+typedef struct rl_state_s {
+    size_t got;
+    int paused; /* 检查时读取因限速暂停的次数 */
+    ez_conn_t* conn;
+} rl_state_t;
+
+static void rl_read(ez_conn_t* conn, bytebuf_t* in, void* data)
+{
+    rl_state_t* st = (rl_state_t*)data;
+    EZ_NOTUSED(conn);
+    st->got += bytebuf_readable_size(in);
+    in->r = in->w;
+}
+
+static int rl_check_done(ez_event_loop_t* eventLoop, int64_t timeId, void* data)
+{
+    rl_state_t* st = (rl_state_t*)data;
+    EZ_NOTUSED(timeId);
+    if (conn_read_paused(st->conn) & CONN_PAUSE_RATELIMIT)
+        st->paused++;
+    if (st->got >= 8000)
+        ez_stop_event_loop(eventLoop);
+    return AE_TIMER_NEXT;
+}
+
+TEST(conn, ratelimit)
+{
+    rl_state_t st = { 0, 0, NULL };
+    char chunk[8000];
+    int sv[2];
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    ez_net_set_non_block(sv[0]);
+
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_conn_group_t* g = new_conn_group(loop, 1024);
+    // 每秒 20000 字节, 最多攒 2000: 8000 字节大约要 300ms.
+    ez_ratelimit_t* rl = new_ratelimit(loop, 20000, 2000);
+    ez_conn_t* c = new_conn(g, sv[0], rl_read, NULL, &st);
+    st.conn = c;
+    conn_set_ratelimit(c, rl, 0);
+
+    memset(chunk, 'a', sizeof(chunk));
+    ASSERT_EQ(write(sv[1], chunk, sizeof(chunk)), (ssize_t)sizeof(chunk));
+
+    int64_t start = mstime();
+    int64_t check = ez_create_time_event(loop, 5, rl_check_done, &st);
+    ez_run_event_loop(loop);
+    int64_t elapsed = mstime() - start;
+    ez_delete_time_event(loop, check);
+
+    ASSERT_EQ(st.got, sizeof(chunk));
+    // 每 5ms 检查一次, 大约 300ms 里大部分时间读取都因限速暂停
+    ASSERT_EQ(st.paused >= 10, 1);
+    ASSERT_EQ(elapsed >= 250 && elapsed <= 450, 1);
+
+    // 取消限速后立即恢复读取.
+    conn_set_ratelimit(c, NULL, 0);
+    ASSERT_EQ(conn_read_paused(c), 0);
+
+    free_conn_group(g);
+    free_ratelimit(rl);
+    ez_net_close_socket(sv[1]);
+    ez_delete_event_loop(loop);
+}
+
+/* 关闭时顺带关掉链上的下一个连接 */
+typedef struct chain_conn_s {
+    ez_conn_t* next;
+    int* closed;
+} chain_conn_t;
+
+static void chain_close(ez_conn_t* conn, int reason, void* data)
+{
+    chain_conn_t* cc = (chain_conn_t*)data;
+    EZ_NOTUSED(conn);
+    EZ_NOTUSED(reason);
+    (*cc->closed)++;
+    if (cc->next != NULL)
+        conn_close(cc->next);
+}
+
+static void drain_free_group(ez_conn_group_t* g, const ez_conn_drain_stats_t* stats, int done, void* data)
+{
+    drain_result_t* r = (drain_result_t*)data;
+    r->stats = *stats;
+    if (done) {
+        r->done++;
+        return;
+    }
+    r->progress++;
+    free_conn_group(g);
+}
+
+TEST(conn, drain_callbacks)
+{
+    chain_conn_t cc[4];
+    ez_conn_t* conns[4];
+    drain_result_t r;
+    int sv[4][2], stuck[2];
+    int closed = 0, i;
+    char chunk[4096];
+
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_conn_group_t* g = new_conn_group(loop, 1024);
+
+    // close_proc 关闭链上的下一个连接, drain 遍历时不能走出连接链表
+    for (i = 0; i < 4; ++i) {
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv[i]), 0);
+        ez_net_set_non_block(sv[i][0]);
+        cc[i].closed = &closed;
+        conns[i] = new_conn(g, sv[i][0], test_read, chain_close, &cc[i]);
+    }
+    for (i = 0; i < 4; ++i)
+        cc[i].next = i + 1 < 4 ? conns[i + 1] : NULL;
+    memset(&r, 0, sizeof(r));
+    r.loop = loop;
+    ASSERT_EQ(conn_group_drain(g, 1000, test_drain, &r), ANET_OK);
+    ez_run_event_loop(loop);
+    ASSERT_EQ(r.done, 1);
+    ASSERT_EQ(closed, 4);
+    ASSERT_EQ(conn_group_count(g), 0);
+    free_conn_group(g);
+
+    // done=0 的回调里释放 group, 定时器不能再触发
+    g = new_conn_group(loop, 1024);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, stuck), 0);
+    ez_net_set_non_block(stuck[0]);
+    memset(&cc[0], 0, sizeof(cc[0]));
+    cc[0].closed = &closed;
+    conns[0] = new_conn(g, stuck[0], test_read, chain_close, &cc[0]);
+    memset(chunk, 'a', sizeof(chunk));
+    while (conn_output_size(conns[0]) == 0)
+        conn_write(conns[0], chunk, sizeof(chunk));
+    memset(&r, 0, sizeof(r));
+    r.loop = loop;
+    closed = 0;
+    ASSERT_EQ(conn_group_drain(g, 1000, drain_free_group, &r), ANET_OK);
+    run_loop_for(loop, 350);
+    ASSERT_EQ(r.progress, 1);
+    ASSERT_EQ(r.done, 0);
+    ASSERT_EQ(closed, 1);
+
+    for (i = 0; i < 4; ++i)
+        ez_net_close_socket(sv[i][1]);
+    ez_net_close_socket(stuck[1]);
+    ez_delete_event_loop(loop);
+}
+
+typedef struct free_in_read_s {
+    ez_conn_group_t* g;
+    int closed;
+} free_in_read_t;
+
+static void free_group_read(ez_conn_t* conn, bytebuf_t* in, void* data)
+{
+    free_in_read_t* f = (free_in_read_t*)data;
+    EZ_NOTUSED(conn);
+    in->r = in->w;
+    free_conn_group(f->g);
+}
+
+static void free_group_close(ez_conn_t* conn, int reason, void* data)
+{
+    free_in_read_t* f = (free_in_read_t*)data;
+    EZ_NOTUSED(conn);
+    EZ_NOTUSED(reason);
+    f->closed++;
+}
+
+TEST(conn, free_in_read)
+{
+    free_in_read_t f = { NULL, 0 };
+    int a[2], b[2];
+
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    f.g = new_conn_group(loop, 1024);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, a), 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, b), 0);
+    ez_net_set_non_block(a[0]);
+    ez_net_set_non_block(b[0]);
+    new_conn(f.g, a[0], free_group_read, free_group_close, &f);
+    new_conn(f.g, b[0], test_read, free_group_close, &f);
+
+    // 读回调里释放 group: 两个连接都关闭, 回调返回后 group 才释放
+    ASSERT_EQ(write(a[1], "x", 1), 1);
+    run_loop_for(loop, 20);
+    ASSERT_EQ(f.closed, 2);
+
+    ez_net_close_socket(a[1]);
+    ez_net_close_socket(b[1]);
+    ez_delete_event_loop(loop);
+}
+
+static void keep_read(ez_conn_t* conn, bytebuf_t* in, void* data)
+{
+    EZ_NOTUSED(conn);
+    EZ_NOTUSED(in);
+    EZ_NOTUSED(data);
+}
+
+TEST(conn, max_input)
+{
+    conn_state_t st = { 0, 0, 0, 0 };
+    char chunk[1024];
+    int sv[2], i;
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    ez_net_set_non_block(sv[0]);
+    ez_net_set_non_block(sv[1]);
+
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_conn_group_t* g = new_conn_group(loop, 1024);
+    conn_group_set_max_input(g, 4096);
+    new_conn(g, sv[0], keep_read, test_close, &st);
+
+    // 读回调从不消费, 输入堆到上限后按出错关闭, 而不是读 0 字节当成 EOF
+    memset(chunk, 'a', sizeof(chunk));
+    for (i = 0; i < 8 && st.closed == 0; ++i) {
+        ASSERT_EQ(write(sv[1], chunk, sizeof(chunk)), sizeof(chunk));
+        run_loop_for(loop, 5);
+    }
+    ASSERT_EQ(st.closed, 1);
+    ASSERT_EQ(st.reason, CONN_CLOSE_ERROR);
+
+    free_conn_group(g);
+    ez_net_close_socket(sv[1]);
+    ez_delete_event_loop(loop);
+}
+
+int main(int argc, char** argv)
+{
+    EZ_NOTUSED(argc);
+    EZ_NOTUSED(argv);
+    init_default_suite();
+    SUITE_ADD_TEST(conn, watermark);
+    SUITE_ADD_TEST(conn, async_connect);
+    SUITE_ADD_TEST(conn, pool);
+    SUITE_ADD_TEST(conn, fastopen);
+    SUITE_ADD_TEST(conn, cork);
+    SUITE_ADD_TEST(conn, notsent_lowat);
+    SUITE_ADD_TEST(conn, tcp_info);
+    SUITE_ADD_TEST(conn, drain);
+    SUITE_ADD_TEST(conn, drain_callbacks);
+    SUITE_ADD_TEST(conn, free_in_read);
+    SUITE_ADD_TEST(conn, max_input);
+    SUITE_ADD_TEST(conn, ratelimit);
+    run_default_suite();
+    return 0;
+}
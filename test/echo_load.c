@@ -0,0 +1,356 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <ez_bytebuf.h>
+#include <ez_conn.h>
+#include <ez_event.h>
+#include <ez_histogram.h>
+#include <ez_log.h>
+#include <ez_macro.h>
+#include <ez_malloc.h>
+#include <ez_net.h>
+#include <ez_util.h>
+
+//
+// echo_svr 的压测客户端. N 个连接分布在 M 个事件循环线程上, 每个请求 size 字节, 收齐同样多的回显算完成.
+// closed-loop(默认): 每个连接保持 depth 个请求在途, 完成一个立即发下一个, 统计服务延时.
+// open-loop(-r rate): 按固定的总速率给每个请求排定计划发送时间; 在途达到 depth 时请求积压, 计划时间不变,
+//   延时从计划时间算起, 修正 coordinated omission. 同时给出从实际发送算起的延时作对比.
+//   请求由 LOAD_TICK_MS 的定时器发出, 修正后的延时包含最多一个 tick 的发送延迟.
+//   结束时在途和还没发出的请求按 结束时间 - 计划时间 计入修正后的延时.
+// usage: echo_load [-h host] [-p port] [-c conns] [-t threads] [-d seconds] [-s size] [-P depth] [-r rate] [-b banner]
+//   -b: 连接后服务端先发的欢迎语字节数, echo_svr 为 19.
+//
+#define LOAD_TICK_MS 1
+#define LOAD_BUF_SIZE 16384
+#define LOAD_DIGITS 3 /* 延时直方图的有效数字, 分位数误差 < 0.1% */
+
+typedef struct load_thread_s load_thread_t;
+
+typedef struct load_conn_s {
+    load_thread_t* t;
+    ez_conn_t* conn;
+    int64_t* sent_us; /* 在途请求的实际发送时间, 环形, 容量 depth */
+    int64_t* intended_us; /* 在途请求的计划发送时间 */
+    int head;
+    int inflight;
+    size_t skip; /* 还要跳过的欢迎语字节 */
+    size_t partial; /* 已收到的不足一个请求的字节 */
+    int64_t next_us; /* open-loop 下一个请求的计划时间 */
+} load_conn_t;
+
+struct load_thread_s {
+    pthread_t tid;
+    ez_event_loop_t* loop;
+    ez_conn_group_t* group;
+    load_conn_t* conns;
+    int nconns;
+    int64_t end_us;
+    uint64_t requests;
+    uint64_t errors;
+    ez_histogram_t* latency; /* open-loop 为修正后的延时 */
+    ez_histogram_t* service; /* 从实际发送算起的延时 */
+};
+
+static const char* host = "127.0.0.1";
+static int port = 9090;
+static int nconns = 16;
+static int nthreads = 1;
+static int seconds = 10;
+static size_t size = 64;
+static int depth = 1;
+static int64_t rate = 0;
+static size_t banner = 19;
+
+static char* payload;
+static int64_t interval_us; /* open-loop 每个连接的请求间隔 */
+
+static void load_send(load_conn_t* lc, int64_t intended)
+{
+    int i = (lc->head + lc->inflight) % depth;
+
+    lc->sent_us[i] = ustime();
+    lc->intended_us[i] = intended;
+    lc->inflight++;
+    conn_write(lc->conn, payload, size);
+}
+
+/* open-loop: 补发计划时间已到的请求 */
+static void load_pace(load_conn_t* lc, int64_t now)
+{
+    while (lc->next_us <= now && lc->inflight < depth) {
+        load_send(lc, lc->next_us);
+        lc->next_us += interval_us;
+    }
+}
+
+static void load_read(ez_conn_t* conn, bytebuf_t* in, void* data)
+{
+    load_conn_t* lc = (load_conn_t*)data;
+    load_thread_t* t = lc->t;
+    size_t n = bytebuf_readable_size(in), k;
+    int64_t now = ustime();
+    EZ_NOTUSED(conn);
+
+    in->r += (uint32_t)n;
+    if (lc->skip > 0) {
+        k = n < lc->skip ? n : lc->skip;
+        lc->skip -= k;
+        n -= k;
+    }
+    lc->partial += n;
+    while (lc->partial >= size && lc->inflight > 0) {
+        lc->partial -= size;
+        histogram_add(t->service, (uint64_t)(now - lc->sent_us[lc->head]));
+        histogram_add(t->latency, (uint64_t)(now - lc->intended_us[lc->head]));
+        t->requests++;
+        lc->head = (lc->head + 1) % depth;
+        lc->inflight--;
+        // 回调里的写入会合并到返回后一次写出.
+        if (rate == 0)
+            load_send(lc, now);
+    }
+    if (rate > 0)
+        load_pace(lc, now);
+}
+
+static void load_close(ez_conn_t* conn, int reason, void* data)
+{
+    load_conn_t* lc = (load_conn_t*)data;
+    EZ_NOTUSED(conn);
+
+    lc->conn = NULL;
+    if (reason == CONN_CLOSE_ACTIVE)
+        return;
+    log_warn("connection closed, reason:%d, %d requests in flight.", reason, lc->inflight);
+    lc->t->errors++;
+}
+
+static int load_tick(ez_event_loop_t* eventLoop, int64_t timeId, void* clientData)
+{
+    load_thread_t* t = (load_thread_t*)clientData;
+    int64_t now = ustime();
+    int i;
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(timeId);
+
+    for (i = 0; i < t->nconns; ++i) {
+        if (t->conns[i].conn == NULL)
+            continue;
+        conn_cork(t->conns[i].conn);
+        load_pace(&t->conns[i], now);
+        conn_uncork(t->conns[i].conn);
+    }
+    return AE_TIMER_NEXT;
+}
+
+static int load_stop(ez_event_loop_t* eventLoop, int64_t timeId, void* clientData)
+{
+    EZ_NOTUSED(timeId);
+    EZ_NOTUSED(clientData);
+    ez_stop_event_loop(eventLoop);
+    return AE_TIMER_END;
+}
+
+static void* load_thread_main(void* arg)
+{
+    load_thread_t* t = (load_thread_t*)arg;
+    ez_run_event_loop(t->loop);
+    return NULL;
+}
+
+static void print_latency(const char* name, const ez_histogram_t* h)
+{
+    printf("%-16s min %6lu  p50 %6lu  p90 %6lu  p99 %6lu  p99.9 %6lu  p99.99 %6lu  max %6lu  mean %6lu\n", name,
+        h->count > 0 ? h->min : 0, histogram_percentile(h, 50), histogram_percentile(h, 90),
+        histogram_percentile(h, 99), histogram_percentile(h, 99.9), histogram_percentile(h, 99.99), h->max,
+        histogram_mean(h));
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "usage: echo_load [-h host] [-p port] [-c conns] [-t threads] [-d seconds] [-s size] [-P depth] [-r rate] "
+        "[-b banner]\n");
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    load_thread_t* threads;
+    load_thread_t* t;
+    load_conn_t* lc;
+    ez_histogram_t* latency;
+    ez_histogram_t* service;
+    uint64_t requests = 0, errors = 0, backlog = 0;
+    int64_t start_us, end_us, elapsed_us;
+    int i, j, k, fd, opt;
+
+    while ((opt = getopt(argc, argv, "h:p:c:t:d:s:P:r:b:")) != -1) {
+        switch (opt) {
+        case 'h':
+            host = optarg;
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'c':
+            nconns = atoi(optarg);
+            break;
+        case 't':
+            nthreads = atoi(optarg);
+            break;
+        case 'd':
+            seconds = atoi(optarg);
+            break;
+        case 's':
+            size = (size_t)atol(optarg);
+            break;
+        case 'P':
+            depth = atoi(optarg);
+            break;
+        case 'r':
+            rate = atol(optarg);
+            break;
+        case 'b':
+            banner = (size_t)atol(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    if (nconns <= 0 || nthreads <= 0 || seconds <= 0 || size == 0 || depth <= 0 || rate < 0)
+        usage();
+    if (nthreads > nconns)
+        nthreads = nconns;
+
+    log_init(LOG_WARN, NULL);
+    payload = ez_malloc(size);
+    memset(payload, 'x', size);
+    interval_us = rate > 0 ? (int64_t)nconns * 1000000 / rate : 0;
+    if (rate > 0 && interval_us == 0)
+        interval_us = 1;
+
+    threads = ez_malloc(sizeof(load_thread_t) * nthreads);
+    memset(threads, 0, sizeof(load_thread_t) * nthreads);
+    for (i = 0; i < nthreads; ++i) {
+        t = &threads[i];
+        // setsize 是 fd 的上限, 所有线程的连接共用一个 fd 空间.
+        t->loop = ez_create_event_loop(nconns + 1024);
+        t->group = new_conn_group(t->loop, LOAD_BUF_SIZE);
+        t->conns = ez_malloc(sizeof(load_conn_t) * (nconns / nthreads + 1));
+        t->latency = new_histogram_digits(LOAD_DIGITS);
+        t->service = new_histogram_digits(LOAD_DIGITS);
+    }
+
+    // 连接 i 分给线程 i % nthreads.
+    for (i = 0; i < nconns; ++i) {
+        t = &threads[i % nthreads];
+        fd = ez_net_tcp_connect(host, port);
+        if (fd < 0) {
+            fprintf(stderr, "connect %s:%d failed: %s\n", host, port, strerror(errno));
+            return 1;
+        }
+        ez_net_set_non_block(fd);
+        ez_net_tcp_enable_nodelay(fd);
+        lc = &t->conns[t->nconns++];
+        memset(lc, 0, sizeof(load_conn_t));
+        lc->t = t;
+        lc->skip = banner;
+        lc->sent_us = ez_malloc(sizeof(int64_t) * depth);
+        lc->intended_us = ez_malloc(sizeof(int64_t) * depth);
+        lc->conn = new_conn(t->group, fd, load_read, load_close, lc);
+        if (lc->conn == NULL) {
+            fprintf(stderr, "new_conn fd:%d failed\n", fd);
+            return 1;
+        }
+    }
+
+    start_us = ustime();
+    end_us = start_us + (int64_t)seconds * 1000000;
+    for (i = 0; i < nthreads; ++i) {
+        t = &threads[i];
+        t->end_us = end_us;
+        ez_create_time_event(t->loop, (int64_t)seconds * 1000, load_stop, t);
+        if (rate > 0)
+            ez_create_time_event(t->loop, LOAD_TICK_MS, load_tick, t);
+    }
+    // 开始: closed-loop 每个连接先发 depth 个; open-loop 的计划时间在一个间隔内均匀错开.
+    for (i = 0; i < nconns; ++i) {
+        lc = &threads[i % nthreads].conns[i / nthreads];
+        if (rate > 0) {
+            lc->next_us = start_us + interval_us * i / nconns;
+            continue;
+        }
+        conn_cork(lc->conn);
+        while (lc->inflight < depth)
+            load_send(lc, start_us);
+        conn_uncork(lc->conn);
+    }
+    for (i = 0; i < nthreads; ++i)
+        pthread_create(&threads[i].tid, NULL, load_thread_main, &threads[i]);
+
+    latency = new_histogram_digits(LOAD_DIGITS);
+    service = new_histogram_digits(LOAD_DIGITS);
+    for (i = 0; i < nthreads; ++i) {
+        t = &threads[i];
+        pthread_join(t->tid, NULL);
+        // open-loop 到结束时还没完成的请求: 服务端卡住时它们是最慢的样本, 按至少等到结束计入修正后的延时.
+        for (j = 0; rate > 0 && j < t->nconns; ++j) {
+            lc = &t->conns[j];
+            for (k = 0; k < lc->inflight; ++k)
+                histogram_add(t->latency, (uint64_t)(end_us - lc->intended_us[(lc->head + k) % depth]));
+            for (; lc->next_us < end_us; lc->next_us += interval_us) {
+                histogram_add(t->latency, (uint64_t)(end_us - lc->next_us));
+                backlog++;
+            }
+        }
+        histogram_merge(latency, t->latency);
+        histogram_merge(service, t->service);
+        requests += t->requests;
+        errors += t->errors;
+    }
+    elapsed_us = ustime() - start_us;
+
+    printf("%s:%d  conns %d  threads %d  size %zu  depth %d  %s", host, port, nconns, nthreads, size, depth,
+        rate > 0 ? "open-loop" : "closed-loop");
+    if (rate > 0)
+        printf(" %ld req/s", rate);
+    printf("  %.1fs\n", elapsed_us / 1e6);
+    printf("requests %lu  %.1f req/s  %.2f MB/s  errors %lu", requests, requests * 1e6 / elapsed_us,
+        requests * size / (double)elapsed_us, errors);
+    if (rate > 0)
+        printf("  unsent %lu", backlog);
+    printf("\n");
+    if (rate > 0) {
+        print_latency("latency(us)", latency);
+        print_latency("service(us)", service);
+    } else {
+        print_latency("latency(us)", service);
+    }
+    // 分位数是所在桶的上界, 最多偏大这么多.
+    printf("percentiles are bucket upper bounds, at most %.3f%% high\n", histogram_error(service) * 100);
+
+    for (i = 0; i < nthreads; ++i) {
+        t = &threads[i];
+        free_conn_group(t->group);
+        for (j = 0; j < t->nconns; ++j) {
+            ez_free(t->conns[j].sent_us);
+            ez_free(t->conns[j].intended_us);
+        }
+        ez_free(t->conns);
+        free_histogram(t->latency);
+        free_histogram(t->service);
+        ez_delete_event_loop(t->loop);
+    }
+    free_histogram(latency);
+    free_histogram(service);
+    ez_free(threads);
+    ez_free(payload);
+    log_release();
+    return 0;
+}
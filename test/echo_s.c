@@ -2,7 +2,9 @@
 #include <errno.h>
 
 #include <ez_bytebuf.h>
+#include <ez_conn.h>
 #include <ez_event.h>
+#include <ez_handoff.h>
 #include <ez_log.h>
 #include <ez_macro.h>
 #include <ez_malloc.h>
@@ -14,10 +16,9 @@
 
 typedef struct client_s {
     int fd;
-    int mask; // see @EVENT_MASK/**/
     uint64_t create_time;
     uint64_t last_time;
-    bytebuf_t* buf;
+    ez_conn_t* conn;
     ez_rbtree_node_t rbnode;
 } client_t;
 
@@ -26,6 +27,8 @@ typedef struct server_s {
     int port;
     int fd;
     ez_event_loop_t* ez_loop;
+    ez_conn_group_t* conns;
+    ez_handoff_t* handoff;
     ez_rbtree_t rb_clients;
     ez_rbtree_node_t rb_sentinel;
 } server_t;
@@ -50,57 +53,44 @@ void signal_quit_handler(struct ez_signal* sig)
 
 extern char welcome[];
 
-void echo_client_handler(ez_event_loop_t* eventLoop, int c, void* data, int mask)
+void echo_client_read(ez_conn_t* conn, bytebuf_t* in, void* data)
 {
-    EZ_NOTUSED(c);
     client_t* client = (client_t*)data;
-    EZ_NOTUSED(mask);
+    size_t nbytes = bytebuf_readable_size(in);
+
+    log_debug("server read client [fd:%d] %d bytes", client->fd, nbytes);
+    client->last_time = mstime();
+
+    // 写入输出队列, 未写完的部分由 conn 在 AE_WRITABLE 时继续写.
+    conn_write(conn, bytebuf_reader_pos(in), nbytes);
+    in->r += nbytes;
+}
+
+void echo_client_close(ez_conn_t* conn, int reason, void* data)
+{
+    EZ_NOTUSED(conn);
+    client_t* client = (client_t*)data;
+
+    log_info("client [%d] 已经关闭. reason:[%d] erro:[%s]", client->fd, reason, strerror(errno));
+    rbtree_delete(&server->rb_clients, &client->rbnode);
+    ez_free(client);
+}
 
-    if (mask == AE_WRITABLE) {
-        ssize_t nbytes = 0;
-        ez_net_write(
-            client->fd, welcome, sizeof(welcome[0]) * strlen(welcome), &nbytes);
-        ez_delete_file_event(eventLoop, client->fd, AE_WRITABLE);
-        client->mask = AE_READABLE;
-    } else if (mask == AE_READABLE) {
-        if (bytebuf_writeable_size(client->buf) < 512) {
-            client->buf = bytebuf_resize(client->buf, 512);
-            log_debug("client %d bytebuf resize -> %p:%d",
-                client->fd,
-                (void*)client->buf,
-                client->buf->cap);
-        }
-
-        ssize_t nbytes = 0;
-        int r = ez_net_read_bf(client->fd, client->buf, &nbytes);
-        log_debug("server read client [fd:%d] %d bytes, result: %d ",
-            client->fd,
-            nbytes,
-            r);
-
-        if (r == ANET_EAGAIN && nbytes == 0) {
-            // 继续下次读取
-        } else if (r == ANET_OK && nbytes > 0) {
-            client->last_time = mstime();
-            // 有数据可读
-            r = ez_net_write_bf(client->fd, client->buf, &nbytes);
-            log_debug("server write client [fd:%d] %d bytes, result: %d ",
-                client->fd,
-                nbytes,
-                r);
-            if (client->buf->r >= client->buf->w) {
-                bytebuf_reset(client->buf);
-            }
-        } else {
-            // socket出现问题,已经无法读取.
-            log_info("client [%d] 已经关闭. erro:[%s]", client->fd, strerror(errno));
-            ez_delete_file_event(eventLoop, client->fd, client->mask);
-            ez_net_close_socket(client->fd);
-            rbtree_delete(&server->rb_clients, &client->rbnode);
-            free_bytebuf(client->buf);
-            ez_free(client);
-        }
+static client_t* add_client(server_t* server, int c)
+{
+    client_t* client = ez_malloc(sizeof(client_t));
+    client->fd = c;
+    client->create_time = mstime();
+    client->last_time = client->create_time;
+    client->conn = new_conn(server->conns, c, &echo_client_read, &echo_client_close, (void*)client);
+    if (client->conn == NULL) {
+        log_info("server add new client [fd:%d] failed.", c);
+        ez_net_close_socket(c);
+        ez_free(client);
+        return NULL;
     }
+    rbtree_insert(&server->rb_clients, &client->rbnode);
+    return client;
 }
 
 void accept_handler(ez_event_loop_t* eventLoop, int s, void* data, int mask)
@@ -120,52 +110,12 @@ void accept_handler(ez_event_loop_t* eventLoop, int s, void* data, int mask)
     ez_net_tcp_enable_nodelay(c);
     ez_net_tcp_keepalive(c, 300);
 
-    client_t* client = ez_malloc(sizeof(client_t));
-    client->fd = c;
-    client->mask = AE_NONE;
-    client->create_time = mstime();
-    client->last_time = client->create_time;
-    client->buf = new_bytebuf(512);
-    rbtree_insert(&server->rb_clients, &client->rbnode);
-
-    if (ez_create_file_event(server->ez_loop,
-            client->fd,
-            AE_WRITABLE,
-            &echo_client_handler,
-            (void*)client)
-        == AE_ERR) {
-        log_error("server add client [fd:%d](AE_WRITABLE) failed!", c);
-        goto FAILED;
-    }
-    client->mask = client->mask | AE_WRITABLE;
-
-    if (ez_create_file_event(server->ez_loop,
-            client->fd,
-            AE_READABLE,
-            &echo_client_handler,
-            (void*)client)
-        == AE_ERR) {
-        log_error("server add client [fd:%d](AE_READABLE) failed!", c);
-        goto FAILED;
-    }
-    client->mask = client->mask | AE_READABLE;
-    goto SUCCESS;
-
-FAILED:
-    log_info("server add new client [fd:%d] failed.", c);
-    if ((client->mask & AE_WRITABLE) == AE_WRITABLE)
-        ez_delete_file_event(eventLoop, client->fd, AE_WRITABLE);
-    if ((client->mask & AE_READABLE) == AE_READABLE)
-        ez_delete_file_event(eventLoop, client->fd, AE_READABLE);
-    client->mask = AE_NONE;
-    ez_net_close_socket(client->fd);
-    rbtree_delete(&server->rb_clients, &client->rbnode);
-    free_bytebuf(client->buf);
-    ez_free(client);
+    client_t* client = add_client(server, c);
+    if (client == NULL)
+        return;
 
-SUCCESS:
+    conn_write(client->conn, welcome, sizeof(welcome[0]) * strlen(welcome));
     log_info("server add new client [fd:%d] in event_loop.", c);
-    return;
 }
 
 static void
@@ -184,6 +134,22 @@ int server_clients(ez_event_loop_t* eventLoop, int64_t timeId, void* data)
     return AE_TIMER_NEXT;
 }
 
+/* 新进程已经接管监听 socket, 把现有连接也交过去后退出 */
+void echo_handoff(ez_handoff_t* h, void* data)
+{
+    server_t* svr = (server_t*)data;
+    ez_rbtree_node_t* node;
+
+    ez_delete_file_event(svr->ez_loop, svr->fd, AE_READABLE);
+    while ((node = rbtree_min_node(&svr->rb_clients)) != NULL) {
+        client_t* c = EZ_CONTAINER_OF(node, client_t, rbnode);
+        conn_flush(c->conn);
+        handoff_send_conn(h, c->fd, "echo-client");
+        conn_close(c->conn);
+    }
+    ez_stop_event_loop(svr->ez_loop);
+}
+
 void run_echo_server(server_t* svr)
 {
     log_info(
@@ -194,6 +160,21 @@ void run_echo_server(server_t* svr)
     ez_run_event_loop(svr->ez_loop);
 }
 
+/* 退出时等待现有连接写完响应 */
+void echo_drain_progress(ez_conn_group_t* g, const ez_conn_drain_stats_t* st, int done, void* data)
+{
+    server_t* svr = (server_t*)data;
+    EZ_NOTUSED(g);
+
+    log_info("drain: %d/%d clients left, %zu bytes pending, %ldms.", st->remaining, st->total, st->pending_bytes,
+        (long)st->elapsed_ms);
+    if (done)
+        ez_stop_event_loop(svr->ez_loop);
+}
+
+#define ECHO_HANDOFF_PATH "/tmp/echo_svr.handoff"
+#define ECHO_DRAIN_TIMEOUT_MS 5000
+
 server_t* server = NULL;
 char welcome[] = "welcome to server!\n";
 
@@ -211,13 +192,41 @@ int main(int argc, char** argv)
     server->addr = addr;
     server->port = port;
     server->ez_loop = ez_create_event_loop(1024);
+    server->conns = new_conn_group(server->ez_loop, 512);
     rbtree_init(&server->rb_clients, &server->rb_sentinel, &client_compare_proc);
 
-    server->fd = ez_net_tcp_server(server->port, server->addr, 1024);
+    // 有旧进程时接管它的监听 socket 和连接, 否则新建.
+    ez_handoff_fd_t fds[256];
+    int i, n = ez_handoff_take(ECHO_HANDOFF_PATH, fds, 256);
+    server->fd = ANET_ERR;
+    for (i = 0; i < n; ++i) {
+        if (fds[i].type == HANDOFF_LISTENER && server->fd == ANET_ERR)
+            server->fd = fds[i].fd;
+        else if (fds[i].type == HANDOFF_CONN)
+            add_client(server, fds[i].fd);
+        else
+            ez_net_close_socket(fds[i].fd);
+    }
+    if (server->fd == ANET_ERR)
+        server->fd = ez_net_tcp_server(server->port, server->addr, 1024);
+
+    server->handoff = new_handoff(server->ez_loop, ECHO_HANDOFF_PATH, echo_handoff, server);
+    if (server->handoff != NULL)
+        handoff_add_listener(server->handoff, server->fd, "echo");
 
     run_echo_server(server);
 
+    // 收到退出信号: 停止 accept, 再跑一会事件循环让现有连接把输出写完.
+    // 交接给新进程时连接已经交出, 不需要 drain.
+    if (conn_group_count(server->conns) > 0) {
+        ez_delete_file_event(server->ez_loop, server->fd, AE_READABLE);
+        conn_group_drain(server->conns, ECHO_DRAIN_TIMEOUT_MS, echo_drain_progress, server);
+        ez_run_event_loop(server->ez_loop);
+    }
+
+    free_handoff(server->handoff);
     ez_net_close_socket(server->fd);
+    free_conn_group(server->conns);
     ez_delete_event_loop(server->ez_loop);
 
     ez_free(server);
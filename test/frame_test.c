@@ -0,0 +1,111 @@
+#include <errno.h>
+#include <string.h>
+
+#include <ez_bytebuf.h>
+#include <ez_frame.h>
+#include <ez_macro.h>
+#include <ez_net.h>
+#include <ez_test.h>
+
+static const int frame_types[] = { FRAME_LEN_U8, FRAME_LEN_U16_BE, FRAME_LEN_U16_LE, FRAME_LEN_U32_BE,
+    FRAME_LEN_U32_LE, FRAME_LEN_VARINT };
+
+TEST(frame, roundtrip)
+{
+    uint32_t lens[] = { 0, 1, 127, 128, 200, 255 };
+    ez_framer_t f;
+    ez_frame_t fr;
+    char payload[256];
+    size_t t, i;
+
+    memset(payload, 'x', sizeof(payload));
+    for (t = 0; t < sizeof(frame_types) / sizeof(frame_types[0]); ++t) {
+        bytebuf_t* b = new_bytebuf(64);
+        framer_init(&f, frame_types[t], 1024);
+        for (i = 0; i < sizeof(lens) / sizeof(lens[0]); ++i) {
+            payload[0] = (char)i;
+            ASSERT_EQ(framer_write(&f, b, payload, lens[i]), ANET_OK);
+        }
+        for (i = 0; i < sizeof(lens) / sizeof(lens[0]); ++i) {
+            ASSERT_EQ(framer_next(&f, b, &fr), ANET_OK);
+            ASSERT_EQ(fr.len, lens[i]);
+            if (fr.len > 0)
+                ASSERT_EQ(fr.data[0], (uint8_t)i);
+            // 帧直接指向输入缓冲.
+            ASSERT_EQ(fr.data > b->data && fr.data <= b->data + b->w, 1);
+        }
+        ASSERT_EQ(framer_next(&f, b, &fr), ANET_EAGAIN);
+        ASSERT_EQ(bytebuf_readable_size(b), 0);
+        free_bytebuf(b);
+    }
+}
+
+TEST(frame, partial)
+{
+    ez_framer_t f;
+    ez_frame_t fr;
+    uint8_t wire[512];
+    char payload[300];
+    size_t n, i;
+
+    // 每次只到一个字节, 凑齐之前不推进 r.
+    memset(payload, 'p', sizeof(payload));
+    framer_init(&f, FRAME_LEN_VARINT, 1024);
+    n = framer_encode_header(FRAME_LEN_VARINT, sizeof(payload), wire);
+    ASSERT_EQ(n, 2);
+    memcpy(wire + n, payload, sizeof(payload));
+    n += sizeof(payload);
+
+    bytebuf_t* in = new_bytebuf(1024);
+    for (i = 0; i < n - 1; ++i) {
+        in->data[in->w++] = wire[i];
+        ASSERT_EQ(framer_next(&f, in, &fr), ANET_EAGAIN);
+        ASSERT_EQ(in->r, 0);
+        ASSERT_EQ(framer_need(&f), i < 1 ? 1 : n - i - 1);
+    }
+    in->data[in->w++] = wire[n - 1];
+    ASSERT_EQ(framer_next(&f, in, &fr), ANET_OK);
+    ASSERT_EQ(fr.len, sizeof(payload));
+    ASSERT_EQ(fr.data, in->data + 2);
+    ASSERT_EQ(framer_need(&f), 0);
+    free_bytebuf(in);
+}
+
+TEST(frame, limits)
+{
+    ez_framer_t f;
+    ez_frame_t fr;
+    bytebuf_t* in = new_bytebuf(64);
+    uint8_t bad[] = { 0xff, 0xff, 0xff, 0xff, 0x7f };
+
+    // 只收到长度前缀就能发现超长.
+    framer_init(&f, FRAME_LEN_U32_BE, 100);
+    bytebuf_write_int32(in, 101);
+    ASSERT_EQ(framer_next(&f, in, &fr), ANET_ERR);
+    ASSERT_EQ(framer_write(&f, in, "x", 101), ANET_ERR);
+
+    // 超过 32 位的 varint.
+    bytebuf_reset(in);
+    framer_init(&f, FRAME_LEN_VARINT, UINT32_MAX);
+    memcpy(in->data, bad, sizeof(bad));
+    in->w = sizeof(bad);
+    ASSERT_EQ(framer_next(&f, in, &fr), ANET_ERR);
+
+    // 前缀放不下的长度.
+    ASSERT_EQ(framer_encode_header(FRAME_LEN_U8, 256, bad), 0);
+    ASSERT_EQ(framer_encode_header(FRAME_LEN_U16_LE, 65536, bad), 0);
+    ASSERT_EQ(framer_header_size(FRAME_LEN_VARINT, UINT32_MAX), 5);
+    free_bytebuf(in);
+}
+
+int main(int argc, char** argv)
+{
+    EZ_NOTUSED(argc);
+    EZ_NOTUSED(argv);
+    init_default_suite();
+    SUITE_ADD_TEST(frame, roundtrip);
+    SUITE_ADD_TEST(frame, partial);
+    SUITE_ADD_TEST(frame, limits);
+    run_default_suite();
+    return 0;
+}
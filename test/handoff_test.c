@@ -0,0 +1,133 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <ez_event.h>
+#include <ez_handoff.h>
+#include <ez_macro.h>
+#include <ez_net.h>
+#include <ez_test.h>
+
+#define TEST_HANDOFF_PATH "/tmp/ez_handoff_test.sock"
+
+TEST(handoff, send_fds)
+{
+    int sv[2], pv[2], fds[4], nfds = 4;
+    char buf[8];
+    ssize_t nbytes;
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    ASSERT_EQ(pipe(pv), 0);
+
+    ASSERT_EQ(ez_net_send_fds(sv[0], pv, 2, "x", 1, &nbytes), ANET_OK);
+    ASSERT_EQ(ez_net_recv_fds(sv[1], fds, &nfds, buf, sizeof(buf), &nbytes), ANET_OK);
+    ASSERT_EQ(nbytes, 1);
+    ASSERT_EQ(nfds, 2);
+
+    // 收到的是同一个 pipe.
+    ASSERT_EQ(write(fds[1], "abc", 3), 3);
+    ASSERT_EQ(read(pv[0], buf, sizeof(buf)), 3);
+
+    close(fds[0]);
+    close(fds[1]);
+    close(pv[0]);
+    close(pv[1]);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+typedef struct handoff_state_s {
+    int conn_fd;
+    int called;
+} handoff_state_t;
+
+static void test_handoff(ez_handoff_t* h, void* data)
+{
+    handoff_state_t* st = (handoff_state_t*)data;
+    st->called++;
+    handoff_send_conn(h, st->conn_fd, "conn");
+}
+
+static int test_stop(ez_event_loop_t* eventLoop, int64_t timeId, void* data)
+{
+    EZ_NOTUSED(timeId);
+    handoff_state_t* st = (handoff_state_t*)data;
+    if (st->called > 0)
+        ez_stop_event_loop(eventLoop);
+    return AE_TIMER_NEXT;
+}
+
+/* 新进程: 接管监听 socket, 并能 accept 交接前就在 backlog 中的连接 */
+static int take_over(void)
+{
+    ez_handoff_fd_t fds[4];
+    int n = ez_handoff_take(TEST_HANDOFF_PATH, fds, 4);
+
+    if (n != 2 || fds[0].type != HANDOFF_LISTENER || strcmp(fds[0].name, "tcp") != 0 || fds[1].type != HANDOFF_CONN)
+        return 1;
+    ez_net_set_non_block(fds[0].fd);
+    int c = accept(fds[0].fd, NULL, NULL);
+    if (c < 0)
+        return 2;
+    if (write(fds[1].fd, "hi", 2) != 2 || write(c, "hi", 2) != 2)
+        return 3;
+    return 0;
+}
+
+TEST(handoff, restart)
+{
+    handoff_state_t st = { -1, 0 };
+    int status;
+
+    ASSERT_EQ(ez_handoff_take(TEST_HANDOFF_PATH "-none", NULL, 0), ANET_ERR);
+
+    int s = ez_net_tcp_server(9101, "127.0.0.1", 16);
+    ASSERT_GE(s, 0);
+    // 一个已经 accept 的连接和一个还在 backlog 中的连接.
+    int c1 = ez_net_tcp_connect("127.0.0.1", 9101);
+    ASSERT_GE(c1, 0);
+    st.conn_fd = accept(s, NULL, NULL);
+    ASSERT_GE(st.conn_fd, 0);
+    int c2 = ez_net_tcp_connect("127.0.0.1", 9101);
+    ASSERT_GE(c2, 0);
+
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_handoff_t* h = new_handoff(loop, TEST_HANDOFF_PATH, test_handoff, &st);
+    ASSERT_EQ(h != NULL, 1);
+    ASSERT_EQ(handoff_add_listener(h, s, "tcp"), ANET_OK);
+
+    pid_t pid = fork();
+    if (pid == 0)
+        _exit(take_over());
+
+    ez_create_time_event(loop, 10, test_stop, &st);
+    ez_run_event_loop(loop);
+    ASSERT_EQ(st.called, 1);
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_EQ(WIFEXITED(status) && WEXITSTATUS(status) == 0, 1);
+
+    // 两个客户端都由新进程接手.
+    char buf[8];
+    ASSERT_EQ(read(c1, buf, sizeof(buf)), 2);
+    ASSERT_EQ(read(c2, buf, sizeof(buf)), 2);
+
+    free_handoff(h);
+    unlink(TEST_HANDOFF_PATH);
+    ez_net_close_socket(c1);
+    ez_net_close_socket(c2);
+    ez_net_close_socket(st.conn_fd);
+    ez_net_close_socket(s);
+    ez_delete_event_loop(loop);
+}
+
+int main(int argc, char** argv)
+{
+    EZ_NOTUSED(argc);
+    EZ_NOTUSED(argv);
+    init_default_suite();
+    SUITE_ADD_TEST(handoff, send_fds);
+    SUITE_ADD_TEST(handoff, restart);
+    run_default_suite();
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <ez_histogram.h>
+#include <ez_macro.h>
+#include <ez_test.h>
+
+TEST(histogram, percentile)
+{
+    ez_histogram_t* h = new_histogram();
+    uint64_t v;
+
+    ASSERT_EQ(histogram_percentile(h, 50), 0);
+    for (v = 1; v <= 10000; ++v)
+        histogram_add(h, v);
+
+    ASSERT_EQ(h->count, 10000);
+    ASSERT_EQ(h->min, 1);
+    ASSERT_EQ(h->max, 10000);
+    ASSERT_EQ(histogram_mean(h), 5000);
+    ASSERT_EQ(histogram_percentile(h, 100), 10000);
+
+    // 桶的上界, 误差不超过 12.5%.
+    v = histogram_percentile(h, 50);
+    ASSERT_EQ(v >= 5000 && v <= 5000 * 1125 / 1000, 1);
+    v = histogram_percentile(h, 99);
+    ASSERT_EQ(v >= 9900 && v <= 10000, 1);
+
+    free_histogram(h);
+}
+
+TEST(histogram, merge)
+{
+    ez_histogram_t* a = new_histogram();
+    ez_histogram_t* b = new_histogram();
+
+    histogram_add(a, 3);
+    histogram_add(b, 7);
+    histogram_add(b, UINT64_MAX);
+    histogram_merge(a, b);
+
+    ASSERT_EQ(a->count, 3);
+    ASSERT_EQ(a->min, 3);
+    ASSERT_EQ(a->max, UINT64_MAX);
+    ASSERT_EQ(histogram_percentile(a, 30), 3);
+    ASSERT_EQ(histogram_percentile(a, 60), 7);
+    ASSERT_EQ(histogram_percentile(a, 99), UINT64_MAX);
+
+    histogram_reset(a);
+    ASSERT_EQ(a->count, 0);
+    free_histogram(a);
+    free_histogram(b);
+}
+
+TEST(histogram, digits)
+{
+    ez_histogram_t* h = new_histogram_digits(3);
+    ez_histogram_t* d = new_histogram();
+    uint64_t v;
+
+    ASSERT_EQ(histogram_error(h) <= 0.001, 1);
+    for (v = 1; v <= 1000000; ++v)
+        histogram_add(h, v);
+
+    // 误差 < 0.1%, 只会偏大
+    v = histogram_percentile(h, 50);
+    ASSERT_EQ(v >= 500000 && v <= 500000 + 500, 1);
+    v = histogram_percentile(h, 99.9);
+    ASSERT_EQ(v >= 999000 && v <= 999000 + 999, 1);
+    ASSERT_EQ(histogram_percentile(h, 100), 1000000);
+
+    // 精度不同不能合并
+    ASSERT_EQ(histogram_merge(d, h), -1);
+    ASSERT_EQ(d->count, 0);
+
+    histogram_add(h, UINT64_MAX);
+    ASSERT_EQ(histogram_percentile(h, 100), UINT64_MAX);
+
+    free_histogram(h);
+    free_histogram(d);
+}
+
+int main(int argc, char** argv)
+{
+    EZ_NOTUSED(argc);
+    EZ_NOTUSED(argv);
+    init_default_suite();
+    SUITE_ADD_TEST(histogram, percentile);
+    SUITE_ADD_TEST(histogram, merge);
+    SUITE_ADD_TEST(histogram, digits);
+    run_default_suite();
+    return 0;
+}
@@ -0,0 +1,261 @@
+#include <errno.h>
+#include <string.h>
+
+#include <ez_bytebuf.h>
+#include <ez_http.h>
+#include <ez_macro.h>
+#include <ez_net.h>
+#include <ez_test.h>
+
+/* 模拟一次 read: 丢弃已读的字节后追加 */
+static void feed(bytebuf_t* b, const void* data, size_t n)
+{
+    bytebuf_discard_read_bytes(b);
+    bytebuf_write_bytes(b, data, n);
+}
+
+static int slice_eq(const char* s, size_t len, const char* str)
+{
+    return len == strlen(str) && memcmp(s, str, len) == 0;
+}
+
+/* 取完 body 拼到 out, 返回 body 长度; 出错返回 -1 */
+static int read_body(ez_http_body_t* body, bytebuf_t* in, char* out)
+{
+    ez_http_slice_t s;
+    int n = 0, ret;
+
+    while ((ret = http_body_next(body, in, &s)) == ANET_OK) {
+        memcpy(out + n, s.data, s.len);
+        n += (int)s.len;
+    }
+    return ret == HTTP_BODY_END ? n : -1;
+}
+
+TEST(http, request)
+{
+    const char* wire = "GET /metrics?x=1 HTTP/1.1\r\n"
+                       "Host: localhost\r\n"
+                       "X-Empty:\r\n"
+                       "User-Agent:  curl/8.0 \r\n"
+                       "\r\n"
+                       "POST /set HTTP/1.1\r\n"
+                       "Content-Length: 5\r\n"
+                       "\r\n"
+                       "hello"
+                       "\r\n" // 消息之间多余的空行
+                       "GET / HTTP/1.0\r\n"
+                       "\r\n";
+    size_t len = strlen(wire), i;
+    ez_http_parser_t p;
+    ez_http_msg_t msg;
+    ez_http_body_t body;
+    bytebuf_t* b = new_bytebuf(1024);
+    char out[64];
+    const ez_http_header_t* h;
+
+    http_parser_init(&p, 8192);
+    feed(b, wire, len);
+
+    ASSERT_EQ(http_parse_request(&p, b, &msg), ANET_OK);
+    ASSERT_EQ(slice_eq(msg.method, msg.method_len, "GET"), 1);
+    ASSERT_EQ(slice_eq(msg.path, msg.path_len, "/metrics?x=1"), 1);
+    ASSERT_EQ(msg.minor_version, 1);
+    ASSERT_EQ(msg.num_headers, 3);
+    ASSERT_EQ(msg.keep_alive, 1);
+    h = http_find_header(&msg, "user-agent");
+    ASSERT_EQ(h != NULL && slice_eq(h->value, h->value_len, "curl/8.0"), 1);
+    h = http_find_header(&msg, "x-empty");
+    ASSERT_EQ(h != NULL && h->value_len == 0, 1);
+    http_body_init(&body, &msg, 1);
+    ASSERT_EQ(read_body(&body, b, out), 0);
+
+    ASSERT_EQ(http_parse_request(&p, b, &msg), ANET_OK);
+    ASSERT_EQ(msg.content_length, 5);
+    http_body_init(&body, &msg, 1);
+    ASSERT_EQ(read_body(&body, b, out), 5);
+    ASSERT_EQ(memcmp(out, "hello", 5), 0);
+
+    ASSERT_EQ(http_parse_request(&p, b, &msg), ANET_OK);
+    ASSERT_EQ(msg.minor_version, 0);
+    ASSERT_EQ(msg.keep_alive, 0);
+    ASSERT_EQ(http_parse_request(&p, b, &msg), ANET_EAGAIN);
+    ASSERT_EQ(bytebuf_readable_size(b), 0);
+
+    // 每次到达一个字节
+    bytebuf_reset(b);
+    for (i = 0; i < len; ++i) {
+        feed(b, wire + i, 1);
+        if (http_parse_request(&p, b, &msg) == ANET_OK)
+            break;
+    }
+    ASSERT_EQ(msg.header_len, i + 1);
+    ASSERT_EQ(msg.num_headers, 3);
+    ASSERT_EQ(slice_eq(msg.path, msg.path_len, "/metrics?x=1"), 1);
+
+    free_bytebuf(b);
+}
+
+TEST(http, chunked)
+{
+    const char* wire = "POST /upload HTTP/1.1\r\n"
+                       "Transfer-Encoding: gzip, chunked\r\n"
+                       "Content-Length: 100\r\n"
+                       "\r\n"
+                       "5;name=v\r\nhello\r\n"
+                       "B\r\n, world 123\r\n"
+                       "0\r\n"
+                       "X-Trailer: 1\r\n"
+                       "\r\n"
+                       "GET /next HTTP/1.1\r\n\r\n";
+    size_t len = strlen(wire), i;
+    ez_http_parser_t p;
+    ez_http_msg_t msg;
+    ez_http_body_t body;
+    ez_http_slice_t s;
+    bytebuf_t* b = new_bytebuf(16);
+    char out[64];
+    int n = 0, ret, state = 0;
+
+    // 逐字节到达, body 分段取出
+    http_parser_init(&p, 8192);
+    for (i = 0; i < len; ++i) {
+        feed(b, wire + i, 1);
+        for (;;) {
+            if (state == 0) {
+                ret = http_parse_request(&p, b, &msg);
+                if (ret != ANET_OK)
+                    break;
+                ASSERT_EQ(msg.chunked, 1);
+                ASSERT_EQ(msg.content_length, -1);
+                http_body_init(&body, &msg, 1);
+                state = 1;
+            } else if (state == 1) {
+                ret = http_body_next(&body, b, &s);
+                if (ret == ANET_OK) {
+                    memcpy(out + n, s.data, s.len);
+                    n += (int)s.len;
+                    continue;
+                }
+                if (ret != HTTP_BODY_END)
+                    break;
+                state = 2;
+            } else {
+                ret = http_parse_request(&p, b, &msg);
+                if (ret == ANET_OK)
+                    state = 3;
+                break;
+            }
+        }
+        ASSERT_EQ(ret == ANET_ERR, 0);
+    }
+    ASSERT_EQ(state, 3);
+    ASSERT_EQ(n, 16);
+    ASSERT_EQ(memcmp(out, "hello, world 123", 16), 0);
+    ASSERT_EQ(slice_eq(msg.path, msg.path_len, "/next"), 1);
+
+    free_bytebuf(b);
+}
+
+TEST(http, response)
+{
+    ez_http_parser_t p;
+    ez_http_msg_t msg;
+    ez_http_body_t body;
+    bytebuf_t* b = new_bytebuf(64);
+    char out[64];
+
+    http_parser_init(&p, 8192);
+    http_write_response(b, 200, "OK", "text/plain", "up 1\n", 5, 1);
+    feed(b, "HTTP/1.1 204\r\n\r\n", 16);
+    feed(b, "HTTP/1.1 200 OK\r\n\r\nuntil close", 30);
+
+    ASSERT_EQ(http_parse_response(&p, b, &msg), ANET_OK);
+    ASSERT_EQ(msg.status, 200);
+    ASSERT_EQ(slice_eq(msg.reason, msg.reason_len, "OK"), 1);
+    ASSERT_EQ(msg.content_length, 5);
+    ASSERT_EQ(msg.keep_alive, 1);
+    http_body_init(&body, &msg, 0);
+    ASSERT_EQ(read_body(&body, b, out), 5);
+
+    ASSERT_EQ(http_parse_response(&p, b, &msg), ANET_OK);
+    ASSERT_EQ(msg.status, 204);
+    ASSERT_EQ(msg.reason_len, 0);
+    ASSERT_EQ(msg.keep_alive, 1);
+    http_body_init(&body, &msg, 0);
+    ASSERT_EQ(read_body(&body, b, out), 0);
+
+    // 没有长度, 读到连接关闭
+    ASSERT_EQ(http_parse_response(&p, b, &msg), ANET_OK);
+    ASSERT_EQ(msg.keep_alive, 0);
+    http_body_init(&body, &msg, 0);
+    ASSERT_EQ(read_body(&body, b, out), -1);
+    ASSERT_EQ(memcmp(out, "until close", 11), 0);
+
+    free_bytebuf(b);
+}
+
+TEST(http, errors)
+{
+    const char* bad[] = {
+        "GET  / HTTP/1.1\r\n\r\n",
+        "GET / HTTP/2.0\r\n\r\n",
+        "GET / HTTP/1.1\r\nBad Name: x\r\n\r\n",
+        "GET / HTTP/1.1\r\nX: a\x01\r\n\r\n",
+        "GET / HTTP/1.1\r\n folded\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n",
+    };
+    ez_http_parser_t p;
+    ez_http_msg_t msg;
+    ez_http_body_t body;
+    ez_http_slice_t s;
+    bytebuf_t* b = new_bytebuf(64);
+    size_t i;
+
+    for (i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        http_parser_init(&p, 8192);
+        bytebuf_reset(b);
+        feed(b, bad[i], strlen(bad[i]));
+        ASSERT_EQ(http_parse_request(&p, b, &msg), ANET_ERR);
+    }
+
+    // 头部超长
+    http_parser_init(&p, 32);
+    bytebuf_reset(b);
+    feed(b, "GET / HTTP/1.1\r\nHost: 0123456789abcdef", 38);
+    ASSERT_EQ(http_parse_request(&p, b, &msg), ANET_ERR);
+
+    // 非法的 chunk 长度
+    http_parser_init(&p, 8192);
+    bytebuf_reset(b);
+    feed(b, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n", 51);
+    ASSERT_EQ(http_parse_request(&p, b, &msg), ANET_OK);
+    http_body_init(&body, &msg, 1);
+    ASSERT_EQ(http_body_next(&body, b, &s), ANET_ERR);
+
+    // Content-Length 和 chunked 同时出现: 按 chunked 解析, 处理完关闭连接
+    http_parser_init(&p, 8192);
+    bytebuf_reset(b);
+    feed(b, "POST / HTTP/1.1\r\nContent-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n", 66);
+    ASSERT_EQ(http_parse_request(&p, b, &msg), ANET_OK);
+    ASSERT_EQ(msg.chunked, 1);
+    ASSERT_EQ(msg.content_length, -1);
+    ASSERT_EQ(msg.keep_alive, 0);
+
+    free_bytebuf(b);
+}
+
+int main(int argc, char** argv)
+{
+    EZ_NOTUSED(argc);
+    EZ_NOTUSED(argv);
+    init_default_suite();
+    SUITE_ADD_TEST(http, request);
+    SUITE_ADD_TEST(http, chunked);
+    SUITE_ADD_TEST(http, response);
+    SUITE_ADD_TEST(http, errors);
+    run_default_suite();
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+
+#include <ez_macro.h>
+#include <ez_ratelimit.h>
+#include <ez_test.h>
+#include <ez_util.h>
+
+TEST(ratelimit, bucket)
+{
+    // 不带事件循环, 每秒 1000 个, 最多 100 个.
+    ez_ratelimit_t* rl = new_ratelimit(NULL, 1000, 100);
+    ez_token_bucket_t b;
+    int64_t wait;
+
+    ratelimit_init_bucket(rl, &b);
+    ASSERT_EQ(ratelimit_take(rl, &b, 60), 0);
+    ASSERT_EQ(ratelimit_take(rl, &b, 40), 0);
+    ASSERT_EQ(ratelimit_take(rl, &b, 101), -1);
+
+    // 空桶取 10 个大约要等 10ms, 不够时不扣除.
+    wait = ratelimit_take(rl, &b, 10);
+    ASSERT_EQ(wait >= 8 && wait <= 10, 1);
+    wait = ratelimit_take(rl, &b, 10);
+    ASSERT_EQ(wait >= 7 && wait <= 10, 1);
+
+    // 事后扣除可以欠账, 欠 50 个大约要等 60ms.
+    wait = ratelimit_charge(rl, &b, 50);
+    ASSERT_EQ(wait >= 45 && wait <= 50, 1);
+    ASSERT_EQ(b.tokens < 0, 1);
+
+    // 欠账还清后恢复.
+    int64_t start = mstime();
+    while (ratelimit_take(rl, &b, 1) != 0)
+        ;
+    wait = mstime() - start;
+    ASSERT_EQ(wait >= 40 && wait <= 70, 1);
+
+    free_ratelimit(rl);
+}
+
+TEST(ratelimit, keys)
+{
+    // 每秒 100 个, 补满 10 个要 100ms, 比插入 10 万个 key 的时间长得多.
+    ez_ratelimit_t* rl = new_ratelimit(NULL, 100, 10);
+    uint64_t key;
+
+    // 每个 key 独立计数, 第一次出现时桶为满.
+    for (key = 1; key <= 100000; ++key)
+        ASSERT_EQ(ratelimit_take_key(rl, key, 10), 0);
+    ASSERT_EQ(ratelimit_key_count(rl), 100000);
+    ASSERT_EQ(ratelimit_take_key(rl, 100000, 1) > 0, 1);
+
+    // 还没补满的 key 不清除.
+    ASSERT_EQ(ratelimit_expire(rl), 0);
+    ASSERT_EQ(ratelimit_key_count(rl), 100000);
+
+    // 补满的和不存在一样, 全部清除.
+    int64_t start = mstime();
+    while (mstime() - start < 150)
+        ;
+    ASSERT_EQ(ratelimit_expire(rl), 100000);
+    ASSERT_EQ(ratelimit_key_count(rl), 0);
+    ASSERT_EQ(ratelimit_take_key(rl, 777, 10), 0);
+
+    free_ratelimit(rl);
+}
+
+int main(int argc, char** argv)
+{
+    EZ_NOTUSED(argc);
+    EZ_NOTUSED(argv);
+    init_default_suite();
+    SUITE_ADD_TEST(ratelimit, bucket);
+    SUITE_ADD_TEST(ratelimit, keys);
+    run_default_suite();
+    return 0;
+}
@@ -1,5 +1,11 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include <ez_test.h>
 #include <ez_bytebuf.h>
+#include <ez_net.h>
 
 TEST(test, bg_rw)
 {
@@ -59,11 +65,309 @@ TEST(test, le_rw)
     free_bytebuf(buf);
 }
 
+TEST(test, grow)
+{
+    bytebuf_t* buf = new_bytebuf(8);
+    bytebuf_t fixed;
+    uint8_t mem[8], out[16];
+    int i;
+
+    // 写满后自动扩容, 容量按 2 的幂增长.
+    for (i = 0; i < 1000; ++i)
+        ASSERT_EQ(bytebuf_write_int32(buf, i), 0);
+    ASSERT_EQ(buf->cap, 4096);
+    for (i = 0; i < 1000; ++i) {
+        int32_t v = -1;
+        ASSERT_EQ(bytebuf_read_int32(buf, &v), 0);
+        ASSERT_EQ(v, i);
+    }
+    ASSERT_EQ(bytebuf_write_bytes(buf, "0123456789", 10), 0);
+    ASSERT_EQ(bytebuf_read_bytes(buf, out, 10), 0);
+    ASSERT_EQ(memcmp(out, "0123456789", 10), 0);
+
+    // 超过 BYTEBUF_GROW_MAX 后按固定增量.
+    ASSERT_EQ(bytebuf_ensure_writable(buf, BYTEBUF_GROW_MAX), 0);
+    ASSERT_EQ(buf->cap, 2 * BYTEBUF_GROW_MAX);
+    ASSERT_EQ(bytebuf_ensure_writable(buf, 2 * BYTEBUF_GROW_MAX), 0);
+    ASSERT_EQ(buf->cap, 3 * BYTEBUF_GROW_MAX);
+    // 超过 32 位能表示的容量直接失败, 不扩容.
+    ASSERT_EQ(bytebuf_grow(buf, UINT32_MAX), -1);
+    ASSERT_EQ(buf->cap, 3 * BYTEBUF_GROW_MAX);
+    free_bytebuf(buf);
+
+    // 不归 bytebuf 所有的内存不会扩容, 写不下时什么都不写.
+    fixed.r = fixed.w = 0;
+    fixed.cap = sizeof(mem);
+    fixed.data = mem;
+    fixed.flags = BYTEBUF_F_FIXED;
+    ASSERT_EQ(bytebuf_write_int32(&fixed, 1), 0);
+    ASSERT_EQ(bytebuf_write_int64(&fixed, 2), -1);
+    ASSERT_EQ(bytebuf_write_int32_le(&fixed, 3), 0);
+    ASSERT_EQ(bytebuf_write_int8(&fixed, 4), -1);
+    ASSERT_EQ(fixed.w, 8);
+    ASSERT_EQ(fixed.data, mem);
+}
+
+TEST(test, short_read)
+{
+    bytebuf_t* buf = new_bytebuf(64);
+    int64_t d = 0;
+    int32_t c = 0;
+    int16_t b = 0;
+    int8_t a = 0;
+    char out[8];
+
+    // 数据不够时返回 -1, 不移动 r.
+    ASSERT_EQ(bytebuf_read_int8(buf, &a), -1);
+    bytebuf_write_int16(buf, 0x1234);
+    bytebuf_write_int8(buf, 0x56);
+    ASSERT_EQ(bytebuf_read_int32(buf, &c), -1);
+    ASSERT_EQ(bytebuf_read_int64_le(buf, &d), -1);
+    ASSERT_EQ(bytebuf_read_bytes(buf, out, 4), -1);
+    ASSERT_EQ(buf->r, 0);
+    ASSERT_EQ(bytebuf_read_int16(buf, &b), 0);
+    ASSERT_EQ(b, 0x1234);
+    ASSERT_EQ(bytebuf_read_int16_le(buf, &b), -1);
+    ASSERT_EQ(bytebuf_read_int8(buf, &a), 0);
+    ASSERT_EQ(a, 0x56);
+    ASSERT_EQ(bytebuf_readable_size(buf), 0);
+
+    free_bytebuf(buf);
+}
+
+TEST(test, discard)
+{
+    bytebuf_t* buf = new_bytebuf(64);
+    char out[8];
+
+    bytebuf_write_bytes(buf, "0123456789", 10);
+    bytebuf_read_bytes(buf, out, 4);
+    // 已读的不到阈值, 不前移
+    bytebuf_discard_some_read_bytes(buf, 8);
+    ASSERT_EQ(buf->r, 4);
+    bytebuf_discard_some_read_bytes(buf, 4);
+    ASSERT_EQ(buf->r, 0);
+    ASSERT_EQ(buf->w, 6);
+    ASSERT_EQ(memcmp(bytebuf_reader_pos(buf), "456789", 6), 0);
+    // 读空后直接复位
+    bytebuf_read_bytes(buf, out, 6);
+    bytebuf_discard_some_read_bytes(buf, 64);
+    ASSERT_EQ(buf->r, 0);
+    ASSERT_EQ(buf->w, 0);
+
+    free_bytebuf(buf);
+}
+
+TEST(test, ring)
+{
+    bytebuf_t* buf = new_bytebuf_ring(16);
+    struct iovec iov[2];
+    char out[16];
+    int i;
+
+    ASSERT_EQ(bytebuf_ring_readable_iov(buf, iov), 0);
+    ASSERT_EQ(bytebuf_ring_writeable_iov(buf, iov), 1);
+    ASSERT_EQ(bytebuf_grow(buf, 1), -1);
+
+    // 每次写 6 读 6, 下标不断回绕
+    for (i = 0; i < 10; ++i) {
+        ASSERT_EQ(bytebuf_ring_write(buf, "abcdefghij", 10), 0);
+        ASSERT_EQ(bytebuf_ring_read(buf, out, 6), 0);
+        ASSERT_EQ(memcmp(out, "abcdef", 6), 0);
+        ASSERT_EQ(bytebuf_ring_read(buf, out, 4), 0);
+        ASSERT_EQ(memcmp(out, "ghij", 4), 0);
+        ASSERT_EQ(bytebuf_ring_write(buf, "012345", 6), 0);
+        ASSERT_EQ(bytebuf_ring_read(buf, out, 6), 0);
+        ASSERT_EQ(memcmp(out, "012345", 6), 0);
+    }
+
+    // 数据跨过末尾时可读区分两段
+    bytebuf_ring_write(buf, "0123456789ab", 12);
+    bytebuf_ring_read(buf, out, 10);
+    ASSERT_EQ(bytebuf_ring_write(buf, "0123456789", 10), 0);
+    ASSERT_EQ(bytebuf_ring_readable_iov(buf, iov), 2);
+    ASSERT_EQ(iov[0].iov_len + iov[1].iov_len, 12);
+    ASSERT_EQ(bytebuf_ring_writeable_size(buf), 4);
+    ASSERT_EQ(bytebuf_ring_write(buf, "01234", 5), -1);
+    ASSERT_EQ(bytebuf_ring_write(buf, "cdef", 4), 0);
+    ASSERT_EQ(bytebuf_ring_writeable_iov(buf, iov), 0);
+    ASSERT_EQ(bytebuf_ring_read(buf, out, 16), 0);
+    ASSERT_EQ(memcmp(out, "ab0123456789cdef", 16), 0);
+    ASSERT_EQ(buf->r, 0);
+    ASSERT_EQ(buf->w, 0);
+
+    // w 越过 cap 后线性的读写只能用到 data + cap, 写满了不能扩容
+    ASSERT_EQ(bytebuf_ring_write(buf, "0123456789abcdef", 16), 0);
+    bytebuf_ring_consume(buf, 10);
+    ASSERT_EQ(bytebuf_ring_write(buf, "0123456789", 10), 0);
+    ASSERT_EQ(bytebuf_writeable_size(buf), 0);
+    ASSERT_EQ(bytebuf_is_writeable(buf), 0);
+    ASSERT_EQ(bytebuf_write_int32(buf, 1), -1);
+    ASSERT_EQ(bytebuf_readable_size(buf), 6);
+    ASSERT_EQ(bytebuf_read_bytes(buf, out, 8), -1);
+    bytebuf_discard_read_bytes(buf);
+    ASSERT_EQ(buf->r, 10);
+    ASSERT_EQ(bytebuf_ring_read(buf, out, 16), 0);
+    ASSERT_EQ(memcmp(out, "abcdef0123456789", 16), 0);
+    ASSERT_EQ(buf->r, 0);
+    ASSERT_EQ(buf->w, 0);
+
+    free_bytebuf(buf);
+}
+
+TEST(test, ring_io)
+{
+    bytebuf_t* src = new_bytebuf_ring(16);
+    bytebuf_t* dst = new_bytebuf_ring(16);
+    char out[16];
+    ssize_t n = 0;
+    int fds[2];
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ez_net_set_non_block(fds[0]);
+    ez_net_set_non_block(fds[1]);
+
+    // 两边都回绕到中间, readv/writev 各用两段
+    bytebuf_ring_write(src, "0123456789ab", 12);
+    bytebuf_ring_read(src, out, 11);
+    bytebuf_ring_write(dst, "0123456789", 10);
+    bytebuf_ring_read(dst, out, 9);
+
+    bytebuf_ring_write(src, "hello, ring", 11);
+    ASSERT_EQ(ez_net_write_bf(fds[0], src, &n), ANET_OK);
+    ASSERT_EQ(n, 12);
+    ASSERT_EQ(bytebuf_readable_size(src), 0);
+    ASSERT_EQ(ez_net_read_bf(fds[1], dst, &n), ANET_OK);
+    ASSERT_EQ(n, 12);
+    ASSERT_EQ(bytebuf_ring_read(dst, out, 13), 0);
+    ASSERT_EQ(memcmp(out, "9bhello, ring", 13), 0);
+    ASSERT_EQ(ez_net_read_bf(fds[1], dst, &n), ANET_EAGAIN);
+
+    // 环满时还有数据可读, 不能返回 0 字节
+    bytebuf_ring_write(dst, "0123456789abcdef", 16);
+    ASSERT_EQ(write(fds[0], "x", 1), 1);
+    ASSERT_EQ(ez_net_read_bf(fds[1], dst, &n), ANET_EAGAIN);
+    ASSERT_EQ(n, 0);
+    bytebuf_ring_consume(dst, 16);
+    ASSERT_EQ(ez_net_read_bf(fds[1], dst, &n), ANET_OK);
+    ASSERT_EQ(n, 1);
+
+    close(fds[0]);
+    close(fds[1]);
+    free_bytebuf(src);
+    free_bytebuf(dst);
+}
+
+TEST(test, readv_bf)
+{
+    bytebuf_t* bufs[2] = { new_bytebuf(8), new_bytebuf(8) };
+    ssize_t n = 0;
+    int fds[2];
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ez_net_set_non_block(fds[1]);
+
+    ASSERT_EQ(write(fds[0], "0123456789abcdefXY", 18), 18);
+    ASSERT_EQ(ez_net_readv_bf(fds[1], bufs, 2, &n), ANET_OK);
+    ASSERT_EQ(n, 16);
+    ASSERT_EQ(memcmp(bytebuf_reader_pos(bufs[1]), "89abcdef", 8), 0);
+    // 都满了, 还有数据可读也不能返回 0 字节
+    ASSERT_EQ(ez_net_readv_bf(fds[1], bufs, 2, &n), ANET_EAGAIN);
+    ASSERT_EQ(n, 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    free_bytebuf(bufs[0]);
+    free_bytebuf(bufs[1]);
+}
+
+TEST(test, mirror)
+{
+    bytebuf_t* buf = new_bytebuf_mirror(100);
+    struct iovec iov[2];
+    char msg[64], out[64];
+    int64_t d = 0;
+    int32_t c = 0;
+    ssize_t n = 0;
+    size_t cap, k;
+    int fds[2];
+
+    ASSERT_EQ(buf != NULL, 1);
+    cap = buf->cap;
+    ASSERT_EQ(cap % 4096, 0);
+    buf->data[1] = 'x';
+    ASSERT_EQ(buf->data[cap + 1], 'x');
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ez_net_set_non_block(fds[0]);
+    ez_net_set_non_block(fds[1]);
+
+    // 可读区停在末尾前 10 字节, 再读入的数据跨过末尾, 仍是连续一段
+    memset(msg, 'm', sizeof(msg));
+    buf->r = buf->w = (uint32_t)(cap - 10);
+    ASSERT_EQ(bytebuf_ring_writeable_iov(buf, iov), 1);
+    ASSERT_EQ(iov[0].iov_len, cap);
+    memcpy(msg, "across the end of the ring", 26);
+    ASSERT_EQ(write(fds[0], msg, sizeof(msg)), (ssize_t)sizeof(msg));
+    ASSERT_EQ(ez_net_read_bf(fds[1], buf, &n), ANET_OK);
+    ASSERT_EQ(n, (ssize_t)sizeof(msg));
+    ASSERT_EQ(bytebuf_readable_size(buf), sizeof(msg));
+    ASSERT_EQ(memcmp(bytebuf_reader_pos(buf), msg, sizeof(msg)), 0);
+    ASSERT_EQ(bytebuf_ring_readable_iov(buf, iov), 1);
+
+    // 像解析器一样直接推进 r, 越过 cap 后下次读入时折回
+    buf->r += 30;
+    ASSERT_EQ(buf->r > cap, 1);
+    ASSERT_EQ(ez_net_read_bf(fds[1], buf, &n), ANET_EAGAIN);
+    ASSERT_EQ(buf->r, 20);
+    ASSERT_EQ(bytebuf_ring_read(buf, out, 34), 0);
+    ASSERT_EQ(memcmp(out, msg + 30, 34), 0);
+
+    // 下标没折回时线性写入也只写到 2 * cap 为止, 写不下时折回再写
+    buf->r = buf->w = (uint32_t)(2 * cap - 6);
+    ASSERT_EQ(bytebuf_writeable_size(buf), 6);
+    ASSERT_EQ(bytebuf_write_int32(buf, 0x01020304), 0);
+    ASSERT_EQ(bytebuf_write_int64(buf, 0x0506070809101112), 0);
+    ASSERT_EQ(buf->r, cap - 6);
+    ASSERT_EQ(bytebuf_readable_size(buf), 12);
+    ASSERT_EQ(bytebuf_read_int32(buf, &c), 0);
+    ASSERT_EQ(c, 0x01020304);
+    ASSERT_EQ(bytebuf_read_int64(buf, &d), 0);
+    ASSERT_EQ(d, 0x0506070809101112);
+    for (k = 0; k < cap; k += sizeof(out)) {
+        ASSERT_EQ(bytebuf_write_bytes(buf, out, sizeof(out)), 0);
+    }
+    ASSERT_EQ(bytebuf_write_int8(buf, 1), -1);
+    ASSERT_EQ(bytebuf_readable_size(buf), cap);
+    ASSERT_EQ(buf->w <= 2 * cap, 1);
+    bytebuf_ring_consume(buf, cap);
+
+    // 写满整个容量
+    memset(out, 'z', sizeof(out));
+    buf->r = buf->w = (uint32_t)(cap - 1);
+    while (bytebuf_ring_writeable_size(buf) >= sizeof(out))
+        bytebuf_ring_write(buf, out, sizeof(out));
+    ASSERT_EQ(bytebuf_ring_write(buf, out, bytebuf_ring_writeable_size(buf)), 0);
+    ASSERT_EQ(bytebuf_readable_size(buf), cap);
+    ASSERT_EQ(bytebuf_ring_writeable_iov(buf, iov), 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    free_bytebuf(buf);
+}
+
 int main(int argc, char** argv)
 {
     init_default_suite();
     SUITE_ADD_TEST(test, bg_rw);
     SUITE_ADD_TEST(test, le_rw);
+    SUITE_ADD_TEST(test, grow);
+    SUITE_ADD_TEST(test, short_read);
+    SUITE_ADD_TEST(test, discard);
+    SUITE_ADD_TEST(test, ring);
+    SUITE_ADD_TEST(test, ring_io);
+    SUITE_ADD_TEST(test, readv_bf);
+    SUITE_ADD_TEST(test, mirror);
     run_default_suite();
     return 0;
 }
\ No newline at end of file
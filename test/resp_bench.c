@@ -0,0 +1,119 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ez_bytebuf.h>
+#include <ez_net.h>
+#include <ez_resp.h>
+#include <ez_util.h>
+
+//
+// 流水线解析吞吐: 把大量命令/回复编码到一块内存, 按 read_size 分块喂给解析器,
+// 模拟每次 read 之后解析到 EAGAIN, 命令跨块时从断点继续.
+// usage: resp_bench [count] [read_size]
+// 和 hiredis 对比时, 用同样的输入循环调用 redisReaderFeed/redisReaderGetReply 即可.
+//
+#define BENCH_COUNT 1000000
+#define BENCH_READ_SIZE 16384
+
+/* 模拟一次 read: 丢弃已读的字节后追加 */
+static void feed(bytebuf_t* in, const uint8_t* data, size_t n)
+{
+    bytebuf_discard_read_bytes(in);
+    bytebuf_write_bytes(in, data, n);
+}
+
+static void report(const char* name, size_t count, size_t bytes, int64_t us)
+{
+    printf("%-10s %9zu msgs  %8.1f ns/msg  %8.1f MB/s  %6.2f M msgs/s\n", name, count, us * 1000.0 / count,
+        bytes / (double)us, count / (double)us);
+}
+
+static void bench_command(size_t count, size_t read_size)
+{
+    ez_resp_parser_t* p = new_resp_parser(1024, 512 * 1024 * 1024);
+    bytebuf_t* wire = new_bytebuf(4096);
+    bytebuf_t* in = new_bytebuf(read_size);
+    ez_resp_arg_t argv[3];
+    char key[32];
+    size_t i, off, n, parsed = 0;
+    int64_t t0;
+
+    argv[0].data = (const uint8_t*)"SET";
+    argv[0].len = 3;
+    argv[2].data = (const uint8_t*)"value-0123456789";
+    argv[2].len = 16;
+    for (i = 0; i < count; ++i) {
+        argv[1].len = (uint32_t)snprintf(key, sizeof(key), "key:%zu", i);
+        argv[1].data = (const uint8_t*)key;
+        resp_write_command(wire, 3, argv);
+    }
+
+    t0 = ustime();
+    for (off = 0; off < wire->w; off += n) {
+        n = wire->w - off < read_size ? wire->w - off : read_size;
+        feed(in, wire->data + off, n);
+        while (resp_parse_command(p, in) == ANET_OK)
+            parsed++;
+    }
+    report("command", parsed, wire->w, ustime() - t0);
+
+    free_bytebuf(in);
+    free_bytebuf(wire);
+    free_resp_parser(p);
+}
+
+static void bench_reply(size_t count, size_t read_size)
+{
+    ez_resp_parser_t* p = new_resp_parser(1024, 512 * 1024 * 1024);
+    bytebuf_t* wire = new_bytebuf(4096);
+    bytebuf_t* in = new_bytebuf(read_size);
+    ez_resp_reply_t r;
+    size_t i, off, n, parsed = 0;
+    int64_t t0;
+
+    // GET/INCR/LRANGE 混合的回复
+    for (i = 0; i < count; ++i) {
+        switch (i % 4) {
+        case 0:
+            resp_write_simple(wire, "OK");
+            break;
+        case 1:
+            resp_write_bulk(wire, "value-0123456789", 16);
+            break;
+        case 2:
+            resp_write_integer(wire, (int64_t)i);
+            break;
+        default:
+            resp_write_array(wire, 3);
+            resp_write_bulk(wire, "a", 1);
+            resp_write_bulk(wire, "bb", 2);
+            resp_write_null(wire);
+            break;
+        }
+    }
+
+    t0 = ustime();
+    for (off = 0; off < wire->w; off += n) {
+        n = wire->w - off < read_size ? wire->w - off : read_size;
+        feed(in, wire->data + off, n);
+        while (resp_parse_reply(p, in, &r) == ANET_OK)
+            parsed++;
+    }
+    report("reply", parsed, wire->w, ustime() - t0);
+
+    free_bytebuf(in);
+    free_bytebuf(wire);
+    free_resp_parser(p);
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = argc > 1 ? (size_t)atol(argv[1]) : BENCH_COUNT;
+    size_t read_size = argc > 2 ? (size_t)atol(argv[2]) : BENCH_READ_SIZE;
+
+    bench_command(count, read_size);
+    bench_reply(count, read_size);
+    return 0;
+}
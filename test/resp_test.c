@@ -0,0 +1,266 @@
+#include <errno.h>
+#include <string.h>
+
+#include <ez_bytebuf.h>
+#include <ez_macro.h>
+#include <ez_net.h>
+#include <ez_resp.h>
+#include <ez_test.h>
+
+/* 模拟一次 read: 丢弃已读的字节后追加 */
+static void feed(bytebuf_t* b, const void* data, size_t n)
+{
+    bytebuf_discard_read_bytes(b);
+    bytebuf_write_bytes(b, data, n);
+}
+
+static int arg_eq(const ez_resp_arg_t* a, const char* s)
+{
+    return a->len == strlen(s) && memcmp(a->data, s, a->len) == 0;
+}
+
+TEST(resp, command)
+{
+    ez_resp_parser_t* p = new_resp_parser(16, 1024);
+    bytebuf_t* b = new_bytebuf(16);
+    ez_resp_arg_t args[3] = { { (const uint8_t*)"SET", 3 }, { (const uint8_t*)"k", 1 }, { (const uint8_t*)"", 0 } };
+    const ez_resp_arg_t* argv;
+    int i;
+
+    // 流水线: 编码 3 条命令, 一次读完
+    for (i = 0; i < 3; ++i)
+        resp_write_command(b, 3, args);
+    feed(b, "PING  hello\r\n\r\n", 15);
+    for (i = 0; i < 3; ++i) {
+        ASSERT_EQ(resp_parse_command(p, b), ANET_OK);
+        ASSERT_EQ(resp_argc(p), 3);
+        argv = resp_argv(p);
+        ASSERT_EQ(arg_eq(&argv[0], "SET") && arg_eq(&argv[1], "k") && arg_eq(&argv[2], ""), 1);
+    }
+    // inline 命令, 空行被跳过
+    ASSERT_EQ(resp_parse_command(p, b), ANET_OK);
+    ASSERT_EQ(resp_argc(p), 2);
+    ASSERT_EQ(arg_eq(&resp_argv(p)[0], "PING") && arg_eq(&resp_argv(p)[1], "hello"), 1);
+    ASSERT_EQ(resp_parse_command(p, b), ANET_EAGAIN);
+    ASSERT_EQ(bytebuf_readable_size(b), 0);
+
+    free_bytebuf(b);
+    free_resp_parser(p);
+}
+
+TEST(resp, blank_lines)
+{
+    ez_resp_parser_t* p = new_resp_parser(16, 1024);
+    bytebuf_t* b = new_bytebuf(16);
+    int i;
+
+    // 大量连续的空行逐个跳过, 不能每行递归一层把栈用光
+    for (i = 0; i < 4 * 1024 * 1024; ++i)
+        bytebuf_write_bytes(b, "\r\n", 2);
+    feed(b, "PING\r\n", 6);
+    ASSERT_EQ(resp_parse_command(p, b), ANET_OK);
+    ASSERT_EQ(resp_argc(p), 1);
+    ASSERT_EQ(arg_eq(&resp_argv(p)[0], "PING"), 1);
+    ASSERT_EQ(bytebuf_readable_size(b), 0);
+
+    free_bytebuf(b);
+    free_resp_parser(p);
+}
+
+TEST(resp, partial)
+{
+    const char* cmd = "*3\r\n$3\r\nSET\r\n$5\r\nmykey\r\n$10\r\n0123456789\r\n*1\r\n$4\r\nPING\r\n";
+    size_t len = strlen(cmd), i;
+    ez_resp_parser_t* p = new_resp_parser(16, 1024);
+    bytebuf_t* b = new_bytebuf(8);
+    int ok = 0, ret;
+
+    // 每次只到达一个字节, 缓冲在命令中间前移和扩容
+    for (i = 0; i < len; ++i) {
+        feed(b, cmd + i, 1);
+        ret = resp_parse_command(p, b);
+        if (ret == ANET_OK) {
+            ok++;
+            if (ok == 1) {
+                ASSERT_EQ(arg_eq(&resp_argv(p)[1], "mykey") && arg_eq(&resp_argv(p)[2], "0123456789"), 1);
+            } else {
+                ASSERT_EQ(resp_argc(p) == 1 && arg_eq(&resp_argv(p)[0], "PING"), 1);
+            }
+        } else {
+            ASSERT_EQ(ret, ANET_EAGAIN);
+        }
+    }
+    ASSERT_EQ(ok, 2);
+
+    free_bytebuf(b);
+    free_resp_parser(p);
+}
+
+TEST(resp, errors)
+{
+    const char* bad[] = { "*2\r\n+OK\r\n", "*2\r\n$3\r\nabcd\r\n", "*x\r\n", "*17\r\n", "*1\r\n$2000\r\n", "*1\r\n$-5\r\n" };
+    ez_resp_parser_t* p;
+    bytebuf_t* b;
+    size_t i;
+
+    for (i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        p = new_resp_parser(16, 1024);
+        b = new_bytebuf(64);
+        feed(b, bad[i], strlen(bad[i]));
+        ASSERT_EQ(resp_parse_command(p, b), ANET_ERR);
+        free_bytebuf(b);
+        free_resp_parser(p);
+    }
+}
+
+TEST(resp, reply)
+{
+    // RESP3: map 里嵌套 array/set/null, 前面有 attribute, 后面跟 push 和 RESP2 的 null bulk
+    const char* replies = "+OK\r\n"
+                          "-ERR bad\r\n"
+                          ":-9223372036854775808\r\n"
+                          "$5\r\nhello\r\n"
+                          "$-1\r\n"
+                          "%2\r\n+a\r\n*2\r\n:1\r\n#t\r\n+b\r\n~1\r\n_\r\n"
+                          "|1\r\n+ttl\r\n:10\r\n,3.14\r\n"
+                          ">2\r\n+message\r\n=7\r\ntxt:abc\r\n"
+                          "*0\r\n";
+    size_t len = strlen(replies), i;
+    ez_resp_parser_t* p = new_resp_parser(16, 1024);
+    bytebuf_t* b = new_bytebuf(8);
+    ez_resp_reply_t r[16];
+    int n = 0, ret;
+
+    for (i = 0; i < len; ++i) {
+        feed(b, replies + i, 1);
+        ret = resp_parse_reply(p, b, &r[n]);
+        if (ret == ANET_OK) {
+            n++;
+        } else {
+            ASSERT_EQ(ret, ANET_EAGAIN);
+        }
+    }
+    ASSERT_EQ(n, 9);
+    ASSERT_EQ(r[0].type == RESP_SIMPLE && r[0].len == 2, 1);
+    ASSERT_EQ(r[1].type == RESP_ERROR && r[1].len == 7, 1);
+    ASSERT_EQ(r[2].type == RESP_INTEGER && r[2].integer == INT64_MIN, 1);
+    ASSERT_EQ(r[3].type, RESP_BULK);
+    ASSERT_EQ(r[3].len, 5);
+    ASSERT_EQ(r[4].type == RESP_BULK && r[4].str == NULL && r[4].integer == -1, 1);
+    ASSERT_EQ(r[5].type == RESP_MAP && r[5].integer == 2, 1);
+    ASSERT_EQ(r[5].raw_len, 31);
+    ASSERT_EQ(r[6].type == RESP_ATTR && r[6].raw_len == 22, 1);
+    ASSERT_EQ(r[7].type == RESP_PUSH && r[7].integer == 2, 1);
+    ASSERT_EQ(r[8].type == RESP_ARRAY && r[8].integer == 0, 1);
+
+    // 嵌套超过 RESP_DEPTH_MAX
+    resp_parser_reset(p);
+    bytebuf_reset(b);
+    for (i = 0; i <= RESP_DEPTH_MAX; ++i)
+        feed(b, "*1\r\n", 4);
+    ASSERT_EQ(resp_parse_reply(p, b, &r[0]), ANET_ERR);
+
+    free_bytebuf(b);
+    free_resp_parser(p);
+}
+
+TEST(resp, encode)
+{
+    ez_resp_parser_t* p = new_resp_parser(16, 1024);
+    bytebuf_t* b = new_bytebuf(4);
+    ez_resp_reply_t r;
+
+    resp_write_simple(b, "OK");
+    resp_write_error(b, "ERR x");
+    resp_write_integer(b, 0);
+    resp_write_integer(b, -42);
+    resp_write_bulk(b, "abc", 3);
+    resp_write_null(b);
+    resp_write_array(b, 2);
+    resp_write_integer(b, INT64_MAX);
+    resp_write_bulk(b, "", 0);
+    ASSERT_EQ(bytebuf_readable_size(b), 69);
+    ASSERT_EQ(memcmp(bytebuf_reader_pos(b), "+OK\r\n-ERR x\r\n:0\r\n:-42\r\n$3\r\nabc\r\n$-1\r\n*2\r\n", 41), 0);
+
+    ASSERT_EQ(resp_parse_reply(p, b, &r), ANET_OK);
+    ASSERT_EQ(resp_parse_reply(p, b, &r), ANET_OK);
+    ASSERT_EQ(resp_parse_reply(p, b, &r), ANET_OK);
+    ASSERT_EQ(resp_parse_reply(p, b, &r), ANET_OK);
+    ASSERT_EQ(r.integer, -42);
+    ASSERT_EQ(resp_parse_reply(p, b, &r), ANET_OK);
+    ASSERT_EQ(r.len == 3 && memcmp(r.str, "abc", 3) == 0, 1);
+    ASSERT_EQ(resp_parse_reply(p, b, &r), ANET_OK);
+    ASSERT_EQ(resp_parse_reply(p, b, &r), ANET_OK);
+    ASSERT_EQ(r.type == RESP_ARRAY && r.integer == 2, 1);
+    ASSERT_EQ(bytebuf_readable_size(b), 0);
+
+    free_bytebuf(b);
+    free_resp_parser(p);
+}
+
+TEST(resp, mirror)
+{
+    ez_resp_parser_t* p = new_resp_parser(16, 1024);
+    bytebuf_t* wire = new_bytebuf(64);
+    bytebuf_t* ring = new_bytebuf_mirror(4096);
+    ez_resp_arg_t args[2] = { { (const uint8_t*)"GET", 3 }, { (const uint8_t*)"key:0123456789", 14 } };
+    size_t off, n;
+    int i, parsed = 0;
+
+    // 镜像环形上命令跨过末尾也能原地解析, 不用前移
+    for (i = 0; i < 1000; ++i)
+        resp_write_command(wire, 2, args);
+    for (off = 0; off < wire->w; off += n) {
+        n = wire->w - off < 100 ? wire->w - off : 100;
+        ASSERT_EQ(bytebuf_ring_write(ring, wire->data + off, n), 0);
+        while (resp_parse_command(p, ring) == ANET_OK) {
+            ASSERT_EQ(resp_argc(p) == 2 && arg_eq(&resp_argv(p)[1], "key:0123456789"), 1);
+            parsed++;
+        }
+    }
+    ASSERT_EQ(parsed, 1000);
+    ASSERT_EQ(bytebuf_readable_size(ring), 0);
+
+    // 编码器直接写到环上: 下标越过 cap 以后照样写在映射内, 写满了返回 -1 而不是越界
+    parsed = 0;
+    for (i = 0; i < 1000; ++i) {
+        ASSERT_EQ(resp_write_command(ring, 2, args), 0);
+        ASSERT_EQ(resp_write_integer(ring, i), 0);
+        ASSERT_EQ(resp_parse_command(p, ring), ANET_OK);
+        ASSERT_EQ(arg_eq(&resp_argv(p)[0], "GET"), 1);
+        parsed++;
+        // 整数回复让每轮的长度不同, 像解析器一样直接推进 r 跳过它
+        ASSERT_EQ(ring->w <= 2 * ring->cap, 1);
+        ring->r = ring->w;
+    }
+    ASSERT_EQ(parsed, 1000);
+    ASSERT_EQ(ring->r < 2 * ring->cap, 1);
+    while (resp_write_command(ring, 2, args) == 0)
+        ;
+    ASSERT_EQ(bytebuf_readable_size(ring) <= ring->cap, 1);
+    ASSERT_EQ(bytebuf_readable_size(ring) > ring->cap - 64, 1);
+    for (n = 0; bytebuf_readable_size(ring) > 0; n++) {
+        ASSERT_EQ(resp_parse_command(p, ring), ANET_OK);
+    }
+    ASSERT_EQ(n > 100, 1);
+
+    free_bytebuf(ring);
+    free_bytebuf(wire);
+    free_resp_parser(p);
+}
+
+int main(int argc, char** argv)
+{
+    EZ_NOTUSED(argc);
+    EZ_NOTUSED(argv);
+    init_default_suite();
+    SUITE_ADD_TEST(resp, command);
+    SUITE_ADD_TEST(resp, blank_lines);
+    SUITE_ADD_TEST(resp, partial);
+    SUITE_ADD_TEST(resp, errors);
+    SUITE_ADD_TEST(resp, reply);
+    SUITE_ADD_TEST(resp, encode);
+    SUITE_ADD_TEST(resp, mirror);
+    run_default_suite();
+    return 0;
+}
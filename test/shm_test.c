@@ -0,0 +1,196 @@
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <ez_event.h>
+#include <ez_macro.h>
+#include <ez_net.h>
+#include <ez_shm.h>
+#include <ez_test.h>
+#include <ez_util.h>
+
+/* 通过 socketpair 建立通道的两端 */
+static int shm_pair(ez_shm_chan_t** a, ez_shm_chan_t** b, size_t size)
+{
+    int sv[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+        return ANET_ERR;
+    *a = new_shm_chan(size);
+    if (*a == NULL || shm_chan_send(sv[0], *a) != ANET_OK)
+        return ANET_ERR;
+    *b = shm_chan_recv(sv[1]);
+    close(sv[0]);
+    close(sv[1]);
+    return *b == NULL ? ANET_ERR : ANET_OK;
+}
+
+TEST(shm, ring)
+{
+    ez_shm_chan_t *a, *b;
+    char out[3000], in[8192];
+    bytebuf_t* full;
+    ssize_t nbytes;
+    int i, j;
+
+    ASSERT_EQ(shm_pair(&a, &b, 4096), ANET_OK);
+
+    // 反复写满读空, 覆盖回绕.
+    for (i = 0; i < 10; ++i) {
+        for (j = 0; j < (int)sizeof(out); ++j)
+            out[j] = (char)(i + j);
+        ASSERT_EQ(shm_chan_write(a, out, sizeof(out), &nbytes), ANET_OK);
+        ASSERT_EQ(nbytes, sizeof(out));
+        ASSERT_EQ(shm_chan_read(b, in, sizeof(in), &nbytes), ANET_OK);
+        ASSERT_EQ(nbytes, sizeof(out));
+        ASSERT_EQ(memcmp(in, out, sizeof(out)), 0);
+    }
+    ASSERT_EQ(shm_chan_read(b, in, sizeof(in), &nbytes), ANET_EAGAIN);
+
+    // 写满后 EAGAIN, 反方向互不影响.
+    ASSERT_EQ(shm_chan_write(a, in, sizeof(in), &nbytes), ANET_OK);
+    ASSERT_EQ(nbytes, 4096);
+    ASSERT_EQ(shm_chan_write(a, in, 1, &nbytes), ANET_EAGAIN);
+    ASSERT_EQ(shm_chan_write(b, "pong", 4, &nbytes), ANET_OK);
+    ASSERT_EQ(shm_chan_read(a, in, sizeof(in), &nbytes), ANET_OK);
+    ASSERT_EQ(nbytes, 4);
+
+    // 关闭后对端先读完剩余数据, 再读到 EOF.
+    shm_chan_close(a);
+    ASSERT_EQ(shm_chan_write(b, "x", 1, &nbytes), ANET_ERR);
+    // 缓冲满了读不进来, 不是 EOF
+    full = new_bytebuf(64);
+    full->w = (uint32_t)full->cap;
+    ASSERT_EQ(shm_chan_read_bf(b, full, &nbytes), ANET_EAGAIN);
+    ASSERT_EQ(nbytes, 0);
+    free_bytebuf(full);
+    ASSERT_EQ(shm_chan_read(b, in, sizeof(in), &nbytes), ANET_OK);
+    ASSERT_EQ(nbytes, 4096);
+    ASSERT_EQ(shm_chan_read(b, in, sizeof(in), &nbytes), ANET_OK);
+    ASSERT_EQ(nbytes, 0);
+
+    free_shm_chan(a);
+    free_shm_chan(b);
+}
+
+typedef struct doorbell_s {
+    int rounds;
+    int wakeups;
+    ez_event_loop_t* loop;
+} doorbell_t;
+
+/* b 端收到什么就回什么, a 端收到后再发下一轮 */
+static void echo_proc(ez_shm_chan_t* ch, void* data)
+{
+    char buf[64];
+    ssize_t nbytes;
+    doorbell_t* d = (doorbell_t*)data;
+
+    d->wakeups++;
+    while (shm_chan_read(ch, buf, sizeof(buf), &nbytes) == ANET_OK && nbytes > 0)
+        shm_chan_write(ch, buf, (size_t)nbytes, &nbytes);
+}
+
+static void ping_proc(ez_shm_chan_t* ch, void* data)
+{
+    char buf[64];
+    ssize_t nbytes;
+    doorbell_t* d = (doorbell_t*)data;
+
+    d->wakeups++;
+    while (shm_chan_read(ch, buf, sizeof(buf), &nbytes) == ANET_OK && nbytes > 0) {
+        if (--d->rounds == 0) {
+            ez_stop_event_loop(d->loop);
+            return;
+        }
+        shm_chan_write(ch, "ping", 4, &nbytes);
+    }
+}
+
+TEST(shm, doorbell)
+{
+    ez_shm_chan_t *a, *b;
+    ssize_t nbytes;
+    char buf[8];
+
+    ASSERT_EQ(shm_pair(&a, &b, 4096), ANET_OK);
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    doorbell_t pa = { 1000, 0, loop }, pb = { 0, 0, loop };
+    ASSERT_EQ(shm_chan_attach(a, loop, ping_proc, &pa), ANET_OK);
+    ASSERT_EQ(shm_chan_attach(b, loop, echo_proc, &pb), ANET_OK);
+
+    // b 还没开始读, 先主动读一次登记等待.
+    ASSERT_EQ(shm_chan_read(b, buf, sizeof(buf), &nbytes), ANET_EAGAIN);
+    ASSERT_EQ(shm_chan_read(a, buf, sizeof(buf), &nbytes), ANET_EAGAIN);
+    int64_t start = ustime();
+    shm_chan_write(a, "ping", 4, &nbytes);
+    ez_run_event_loop(loop);
+    printf("shm doorbell round trip: %.2f us\n", (double)(ustime() - start) / 1000);
+
+    ASSERT_EQ(pa.rounds, 0);
+    ASSERT_EQ(pb.wakeups, 1000);
+
+    free_shm_chan(a);
+    free_shm_chan(b);
+    ez_delete_event_loop(loop);
+}
+
+#define PINGPONG_ROUNDS 10000
+
+static void* pingpong_echo(void* arg)
+{
+    ez_shm_chan_t* ch = (ez_shm_chan_t*)arg;
+    char buf[64];
+    ssize_t nbytes;
+    int r;
+
+    // 轮询, 不等门铃; 单核机器上要让出 cpu 给对端.
+    while ((r = shm_chan_read(ch, buf, sizeof(buf), &nbytes)) != ANET_OK || nbytes > 0) {
+        if (r == ANET_OK)
+            shm_chan_write(ch, buf, (size_t)nbytes, &nbytes);
+        else
+            sched_yield();
+    }
+    return NULL;
+}
+
+TEST(shm, pingpong)
+{
+    ez_shm_chan_t *a, *b;
+    pthread_t tid;
+    char buf[64];
+    ssize_t nbytes;
+    int i;
+
+    ASSERT_EQ(shm_pair(&a, &b, 4096), ANET_OK);
+    ASSERT_EQ(pthread_create(&tid, NULL, pingpong_echo, b), 0);
+
+    int64_t start = ustime();
+    for (i = 0; i < PINGPONG_ROUNDS; ++i) {
+        shm_chan_write(a, "ping", 4, &nbytes);
+        while (shm_chan_read(a, buf, sizeof(buf), &nbytes) != ANET_OK)
+            sched_yield();
+        ASSERT_EQ(nbytes, 4);
+    }
+    printf("shm busy-poll round trip: %.3f us\n", (double)(ustime() - start) / PINGPONG_ROUNDS);
+
+    shm_chan_close(a);
+    pthread_join(tid, NULL);
+    free_shm_chan(a);
+    free_shm_chan(b);
+}
+
+int main(int argc, char** argv)
+{
+    EZ_NOTUSED(argc);
+    EZ_NOTUSED(argv);
+    init_default_suite();
+    SUITE_ADD_TEST(shm, ring);
+    SUITE_ADD_TEST(shm, doorbell);
+    SUITE_ADD_TEST(shm, pingpong);
+    run_default_suite();
+    return 0;
+}
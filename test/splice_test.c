@@ -0,0 +1,318 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <ez_event.h>
+#include <ez_macro.h>
+#include <ez_net.h>
+#include <ez_splice.h>
+#include <ez_test.h>
+
+#define DATA_SIZE (256 * 1024)
+
+typedef struct splice_state_s {
+    int done;
+    int status;
+} splice_state_t;
+
+static int test_stop(ez_event_loop_t* eventLoop, int64_t timeId, void* data)
+{
+    EZ_NOTUSED(timeId);
+    EZ_NOTUSED(data);
+    ez_stop_event_loop(eventLoop);
+    return AE_TIMER_END;
+}
+
+/* 跑一小段时间的事件循环 */
+static void run_loop_for(ez_event_loop_t* loop, int64_t ms)
+{
+    ez_create_time_event(loop, ms, test_stop, NULL);
+    ez_run_event_loop(loop);
+}
+
+/* 非阻塞地读出 fd 里现有的数据, 追加到 out */
+static size_t read_all(int fd, char* out, size_t off, size_t cap)
+{
+    ssize_t n;
+
+    while (off < cap && (n = read(fd, out + off, cap - off)) > 0)
+        off += (size_t)n;
+    return off;
+}
+
+static void fill_pattern(char* p, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i)
+        p[i] = (char)(i * 7 + i / 251);
+}
+
+static void splice_done(ez_event_loop_t* eventLoop, ez_splice_t* sp, int status, void* clientData)
+{
+    splice_state_t* st = (splice_state_t*)clientData;
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(sp);
+
+    st->done++;
+    st->status = status;
+}
+
+TEST(splice, sendfile)
+{
+    char path[] = "/tmp/ez_splice_test_XXXXXX";
+    char* data = malloc(DATA_SIZE);
+    char* out = malloc(DATA_SIZE);
+    size_t got = 0;
+    off_t offset = 0;
+    ssize_t n = 0;
+    int sv[2], fd, r;
+
+    fill_pattern(data, DATA_SIZE);
+    fd = mkstemp(path);
+    ASSERT_EQ(fd >= 0, 1);
+    unlink(path);
+    ASSERT_EQ(write(fd, data, DATA_SIZE), DATA_SIZE);
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    ez_net_set_non_block(sv[0]);
+    ez_net_set_non_block(sv[1]);
+
+    // 发送端写满就 EAGAIN, 接收端读走后继续, offset 跟着推进
+    while (offset < DATA_SIZE) {
+        r = ez_net_sendfile(sv[0], fd, &offset, DATA_SIZE - (size_t)offset, &n);
+        ASSERT_EQ(r == ANET_ERR, 0);
+        if (r == ANET_ERR)
+            break;
+        got = read_all(sv[1], out, got, DATA_SIZE);
+    }
+    got = read_all(sv[1], out, got, DATA_SIZE);
+    ASSERT_EQ(offset, DATA_SIZE);
+    ASSERT_EQ(got, DATA_SIZE);
+    ASSERT_EQ(memcmp(data, out, DATA_SIZE), 0);
+
+    // 文件末尾再发返回 0 字节
+    ASSERT_EQ(ez_net_sendfile(sv[0], fd, &offset, 16, &n), ANET_OK);
+    ASSERT_EQ(n, 0);
+
+    close(fd);
+    close(sv[0]);
+    close(sv[1]);
+    free(data);
+    free(out);
+}
+
+TEST(splice, socket_pipe_socket)
+{
+    char* data = malloc(DATA_SIZE);
+    char* out = malloc(DATA_SIZE);
+    size_t sent = 0, got = 0, pending = 0;
+    ssize_t n = 0;
+    int src[2], dst[2], pfd[2], r;
+
+    fill_pattern(data, DATA_SIZE);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, src), 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, dst), 0);
+    ASSERT_EQ(pipe2(pfd, O_NONBLOCK), 0);
+    ez_net_set_non_block(src[0]);
+    ez_net_set_non_block(src[1]);
+    ez_net_set_non_block(dst[0]);
+    ez_net_set_non_block(dst[1]);
+
+    // src[0] => src[1] => pipe => dst[0] => dst[1]
+    while (got < DATA_SIZE) {
+        if (sent < DATA_SIZE && ez_net_write(src[0], data + sent, DATA_SIZE - sent, &n) == ANET_OK)
+            sent += (size_t)n;
+        r = ez_net_splice(src[1], pfd[1], 64 * 1024, &n);
+        ASSERT_EQ(r == ANET_ERR, 0);
+        if (r == ANET_OK)
+            pending += (size_t)n;
+        if (pending > 0) {
+            r = ez_net_splice(pfd[0], dst[0], pending, &n);
+            ASSERT_EQ(r == ANET_ERR, 0);
+            if (r == ANET_OK)
+                pending -= (size_t)n;
+        }
+        got = read_all(dst[1], out, got, DATA_SIZE);
+        if (r == ANET_ERR)
+            break;
+    }
+    ASSERT_EQ(got, DATA_SIZE);
+    ASSERT_EQ(memcmp(data, out, DATA_SIZE), 0);
+
+    // 没有数据时返回 ANET_EAGAIN
+    ASSERT_EQ(ez_net_splice(src[1], pfd[1], 1024, &n), ANET_EAGAIN);
+
+    close(src[0]);
+    close(src[1]);
+    close(dst[0]);
+    close(dst[1]);
+    close(pfd[0]);
+    close(pfd[1]);
+    free(data);
+    free(out);
+}
+
+TEST(splice, forward)
+{
+    char* data = malloc(DATA_SIZE);
+    char* out = malloc(DATA_SIZE);
+    splice_state_t st = { 0, 0 };
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_splice_t* sp;
+    size_t sent = 0, got = 0;
+    ssize_t n = 0;
+    int src[2], dst[2], i;
+
+    fill_pattern(data, DATA_SIZE);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, src), 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, dst), 0);
+    ez_net_set_non_block(src[0]);
+    ez_net_set_non_block(src[1]);
+    ez_net_set_non_block(dst[0]);
+    ez_net_set_non_block(dst[1]);
+
+    sp = new_splice(loop, src[1], dst[0], 16 * 1024, splice_done, &st);
+    ASSERT_EQ(sp != NULL, 1);
+    for (i = 0; i < 100 && got < DATA_SIZE; ++i) {
+        if (sent < DATA_SIZE && ez_net_write(src[0], data + sent, DATA_SIZE - sent, &n) == ANET_OK)
+            sent += (size_t)n;
+        if (sent == DATA_SIZE)
+            shutdown(src[0], SHUT_WR);
+        run_loop_for(loop, 5);
+        got = read_all(dst[1], out, got, DATA_SIZE);
+    }
+    run_loop_for(loop, 5);
+    ASSERT_EQ(got, DATA_SIZE);
+    ASSERT_EQ(memcmp(data, out, DATA_SIZE), 0);
+    ASSERT_EQ(st.done, 1);
+    ASSERT_EQ(st.status, ANET_OK);
+    ASSERT_EQ(splice_transferred(sp), DATA_SIZE);
+    free_splice(sp);
+
+    close(src[0]);
+    close(src[1]);
+    close(dst[0]);
+    close(dst[1]);
+    ez_delete_event_loop(loop);
+    free(data);
+    free(out);
+}
+
+TEST(splice, duplex)
+{
+    splice_state_t st = { 0, 0 };
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_splice_t* sp[2];
+    char out[64];
+    size_t got;
+    int cli[2], svr[2];
+
+    // cli[0] <=> cli[1] == proxy == svr[0] <=> svr[1]
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, cli), 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, svr), 0);
+    ez_net_set_non_block(cli[0]);
+    ez_net_set_non_block(cli[1]);
+    ez_net_set_non_block(svr[0]);
+    ez_net_set_non_block(svr[1]);
+
+    ASSERT_EQ(new_splice_duplex(loop, cli[1], svr[0], 0, splice_done, &st, sp), ANET_OK);
+    ASSERT_EQ(write(cli[0], "ping", 4), 4);
+    ASSERT_EQ(write(svr[1], "pong", 4), 4);
+    run_loop_for(loop, 20);
+    got = read_all(svr[1], out, 0, sizeof(out));
+    ASSERT_EQ(got == 4 && memcmp(out, "ping", 4) == 0, 1);
+    got = read_all(cli[0], out, 0, sizeof(out));
+    ASSERT_EQ(got == 4 && memcmp(out, "pong", 4) == 0, 1);
+
+    // 客户端半关闭, 只结束 cli => svr 方向; 释放它之后反方向照常转发
+    shutdown(cli[0], SHUT_WR);
+    run_loop_for(loop, 20);
+    ASSERT_EQ(st.done, 1);
+    ASSERT_EQ(st.status, ANET_OK);
+    ASSERT_EQ(splice_transferred(sp[0]), 4);
+    free_splice(sp[0]);
+    ASSERT_EQ(write(svr[1], "more", 4), 4);
+    run_loop_for(loop, 20);
+    got = read_all(cli[0], out, 0, sizeof(out));
+    ASSERT_EQ(got == 4 && memcmp(out, "more", 4) == 0, 1);
+
+    shutdown(svr[1], SHUT_WR);
+    run_loop_for(loop, 20);
+    ASSERT_EQ(st.done, 2);
+    ASSERT_EQ(splice_transferred(sp[1]), 8);
+    free_splice(sp[1]);
+
+    close(cli[0]);
+    close(cli[1]);
+    close(svr[0]);
+    close(svr[1]);
+    ez_delete_event_loop(loop);
+}
+
+TEST(splice, pipe_full)
+{
+    splice_state_t st = { 0, 0 };
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_splice_t* sp;
+    char buf[4096];
+    clock_t cpu;
+    int src[2], dst[2], i;
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, src), 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, dst), 0);
+    ez_net_set_non_block(src[0]);
+    ez_net_set_non_block(src[1]);
+    ez_net_set_non_block(dst[0]);
+    ez_net_set_non_block(dst[1]);
+
+    // 目的端写满, 源端是很多 1 字节的小报文: pipe 槽位用完时 pending 远小于 chunk
+    memset(buf, 'a', sizeof(buf));
+    while (write(dst[0], buf, sizeof(buf)) > 0)
+        ;
+    for (i = 0; i < 256; ++i)
+        ASSERT_EQ(write(src[0], "x", 1), 1);
+
+    // chunk 超过 pipe-max-size, F_SETPIPE_SZ 失败也不能一直读
+    sp = new_splice(loop, src[1], dst[0], 1024 * 1024 * 1024, splice_done, &st);
+    ASSERT_EQ(sp != NULL, 1);
+    cpu = clock();
+    run_loop_for(loop, 200);
+    cpu = clock() - cpu;
+    ASSERT_EQ(cpu < CLOCKS_PER_SEC / 20, 1);
+
+    // 对端读走后继续转发
+    for (i = 0; i < 50 && splice_transferred(sp) < 256; ++i) {
+        while (read(dst[1], buf, sizeof(buf)) > 0)
+            ;
+        run_loop_for(loop, 5);
+    }
+    ASSERT_EQ(splice_transferred(sp), 256);
+    ASSERT_EQ(st.done, 0);
+    free_splice(sp);
+
+    close(src[0]);
+    close(src[1]);
+    close(dst[0]);
+    close(dst[1]);
+    ez_delete_event_loop(loop);
+}
+
+int main(int argc, char** argv)
+{
+    EZ_NOTUSED(argc);
+    EZ_NOTUSED(argv);
+    init_default_suite();
+    SUITE_ADD_TEST(splice, sendfile);
+    SUITE_ADD_TEST(splice, socket_pipe_socket);
+    SUITE_ADD_TEST(splice, forward);
+    SUITE_ADD_TEST(splice, duplex);
+    SUITE_ADD_TEST(splice, pipe_full);
+    run_default_suite();
+    return 0;
+}
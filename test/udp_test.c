@@ -0,0 +1,234 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <ez_event.h>
+#include <ez_macro.h>
+#include <ez_net.h>
+#include <ez_test.h>
+#include <ez_udp.h>
+
+#define UDP_TEST_PORT 9092
+#define UDP_TEST_MSGS 200
+
+typedef struct udp_echo_s {
+    ez_udp_batch_t* batch;
+    int received;
+    int64_t sum;
+} udp_echo_t;
+
+static void udp_echo_handler(ez_event_loop_t* eventLoop, int fd, void* data, int mask)
+{
+    EZ_NOTUSED(eventLoop);
+    EZ_NOTUSED(mask);
+    udp_echo_t* e = (udp_echo_t*)data;
+    int n, sent;
+
+    // 读到 EAGAIN 为止, 收到的报文按原地址整批回送.
+    while (udp_batch_recv(fd, e->batch, &n) == ANET_OK && n > 0) {
+        e->received += n;
+        while (udp_batch_send(fd, e->batch, &sent) == ANET_EAGAIN && sent > 0)
+            ;
+    }
+}
+
+static void udp_client_handler(ez_event_loop_t* eventLoop, int fd, void* data, int mask)
+{
+    EZ_NOTUSED(mask);
+    udp_echo_t* e = (udp_echo_t*)data;
+    int n, i;
+    int32_t v = 0;
+
+    while (udp_batch_recv(fd, e->batch, &n) == ANET_OK && n > 0) {
+        e->received += n;
+        for (i = 0; i < n; ++i) {
+            bytebuf_read_int32(&udp_batch_msg(e->batch, i)->buf, &v);
+            e->sum += v;
+        }
+    }
+    if (e->received >= UDP_TEST_MSGS)
+        ez_stop_event_loop(eventLoop);
+}
+
+static int udp_timeout(ez_event_loop_t* eventLoop, int64_t timeId, void* data)
+{
+    EZ_NOTUSED(timeId);
+    EZ_NOTUSED(data);
+    ez_stop_event_loop(eventLoop);
+    return AE_TIMER_END;
+}
+
+TEST(udp, batch_echo)
+{
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    int s = ez_net_udp_server(UDP_TEST_PORT, "127.0.0.1");
+    int c = ez_net_udp_connect("127.0.0.1", UDP_TEST_PORT);
+    ASSERT_GE(s, 0);
+    ASSERT_GE(c, 0);
+
+    udp_echo_t svr = { new_udp_batch(32, 2048), 0, 0 };
+    udp_echo_t cli = { new_udp_batch(32, 2048), 0, 0 };
+    ez_udp_batch_t* out = new_udp_batch(UDP_TEST_MSGS, 64);
+
+    for (int i = 0; i < UDP_TEST_MSGS; ++i) {
+        ez_udp_msg_t* m = udp_batch_next(out);
+        bytebuf_write_int32(&m->buf, i);
+    }
+    ASSERT_EQ(udp_batch_is_full(out), 1);
+
+    int n, total = 0;
+    while (total < UDP_TEST_MSGS && udp_batch_send(c, out, &n) != ANET_ERR)
+        total += n;
+    ASSERT_EQ(total, UDP_TEST_MSGS);
+    ASSERT_EQ(out->count, 0);
+
+    ez_create_file_event(loop, s, AE_READABLE, udp_echo_handler, &svr);
+    ez_create_file_event(loop, c, AE_READABLE, udp_client_handler, &cli);
+    ez_create_time_event(loop, 3000, udp_timeout, NULL);
+    ez_run_event_loop(loop);
+
+    ASSERT_EQ(svr.received, UDP_TEST_MSGS);
+    ASSERT_EQ(cli.received, UDP_TEST_MSGS);
+    ASSERT_EQ(cli.sum, UDP_TEST_MSGS * (UDP_TEST_MSGS - 1) / 2);
+
+    free_udp_batch(out);
+    free_udp_batch(svr.batch);
+    free_udp_batch(cli.batch);
+    ez_net_close_socket(c);
+    ez_net_close_socket(s);
+    ez_delete_event_loop(loop);
+}
+
+TEST(udp, gso_gro)
+{
+    int s = ez_net_udp_server(UDP_TEST_PORT + 1, "127.0.0.1");
+    int c = ez_net_udp_connect("127.0.0.1", UDP_TEST_PORT + 1);
+    ASSERT_GE(s, 0);
+    ASSERT_GE(c, 0);
+    ASSERT_EQ(ez_net_set_udp_gro(s, 1), ANET_OK);
+
+    // 16 x 1000 字节的报文一次发出.
+    bytebuf_t* out = new_bytebuf(16 * 1000);
+    for (int i = 0; i < 16 * 1000; ++i)
+        bytebuf_write_int8(out, (int8_t)(i / 1000));
+    ssize_t n = 0;
+    ASSERT_EQ(udp_write_gso_bf(c, out, 1000, &n), ANET_OK);
+    ASSERT_EQ(n, 16 * 1000);
+
+    // 同样的数据通过 batch 再发一次.
+    ez_udp_batch_t* b = new_udp_batch(1, 16 * 1000);
+    ez_udp_msg_t* m = udp_batch_next(b);
+    bytebuf_reset_reader_index(out);
+    memcpy(bytebuf_writer_pos(&m->buf), bytebuf_reader_pos(out), bytebuf_readable_size(out));
+    m->buf.w += bytebuf_readable_size(out);
+    m->segsize = 1000;
+    ASSERT_EQ(udp_msg_segments(m), 16);
+    int sent = 0;
+    ASSERT_EQ(udp_batch_send(c, b, &sent), ANET_OK);
+    ASSERT_EQ(sent, 1);
+
+    // 接收端: 合并的报文带 segsize, 未合并的报文 segsize=0.
+    bytebuf_t* in = new_bytebuf(64 * 1024);
+    size_t total = 0;
+    int segments = 0;
+    while (total < 2 * 16 * 1000) {
+        struct pollfd p = { .fd = s, .events = POLLIN };
+        if (poll(&p, 1, 1000) <= 0)
+            break;
+        uint16_t segsize = 0;
+        bytebuf_reset(in);
+        if (udp_read_gro_bf(s, in, &segsize, &n, NULL) != ANET_OK)
+            continue;
+        total += (size_t)n;
+        segments += segsize == 0 ? 1 : (int)((n + segsize - 1) / segsize);
+        if (segsize != 0)
+            ASSERT_EQ(segsize, 1000);
+    }
+    ASSERT_EQ(total, 2 * 16 * 1000);
+    ASSERT_EQ(segments, 2 * 16);
+
+    free_bytebuf(in);
+    free_bytebuf(out);
+    free_udp_batch(b);
+    ez_net_close_socket(c);
+    ez_net_close_socket(s);
+}
+
+TEST(udp, truncated)
+{
+    int s = ez_net_udp_server(UDP_TEST_PORT + 2, "127.0.0.1");
+    int c = ez_net_udp_connect("127.0.0.1", UDP_TEST_PORT + 2);
+    ez_udp_batch_t* b = new_udp_batch(8, 64);
+    uint8_t data[64];
+    bytebuf_t fixed = { 0, 0, sizeof(data), data, BYTEBUF_F_FIXED };
+    bytebuf_t* buf = new_bytebuf(64);
+    char big[200], small[16];
+    uint64_t truncated = 0;
+    uint16_t segsize = 0;
+    ssize_t nbytes = 0;
+    int n = 0;
+
+    ASSERT_GE(s, 0);
+    ASSERT_GE(c, 0);
+    memset(big, 'b', sizeof(big));
+    memset(small, 's', sizeof(small));
+
+    // 放不下的报文丢弃, 不能当成完整报文交出去
+    ASSERT_EQ(write(c, small, 10), 10);
+    ASSERT_EQ(write(c, big, sizeof(big)), (ssize_t)sizeof(big));
+    ASSERT_EQ(write(c, small, 12), 12);
+    ASSERT_EQ(udp_batch_recv(s, b, &n), ANET_OK);
+    ASSERT_EQ(n, 2);
+    ASSERT_EQ(b->truncated, 1);
+    ASSERT_EQ(bytebuf_readable_size(&udp_batch_msg(b, 0)->buf), 10);
+    ASSERT_EQ(bytebuf_readable_size(&udp_batch_msg(b, 1)->buf), 12);
+    ASSERT_EQ(udp_batch_msg(b, 0)->buf.data != udp_batch_msg(b, 1)->buf.data, 1);
+    ASSERT_EQ(udp_batch_msg(b, 2)->buf.data != udp_batch_msg(b, 1)->buf.data, 1);
+    // 只有超长的报文时接着收, 不返回 0 个
+    ASSERT_EQ(write(c, big, sizeof(big)), (ssize_t)sizeof(big));
+    ASSERT_EQ(udp_batch_recv(s, b, &n), ANET_EAGAIN);
+    ASSERT_EQ(b->truncated, 2);
+
+    // 不能扩容的 buf: 截断的丢一个就返回, 计入 truncated
+    ASSERT_EQ(write(c, big, sizeof(big)), (ssize_t)sizeof(big));
+    ASSERT_EQ(write(c, small, sizeof(small)), (ssize_t)sizeof(small));
+    ASSERT_EQ(udp_read_gro_bf(s, &fixed, &segsize, &nbytes, &truncated), ANET_OK);
+    ASSERT_EQ(nbytes, 0);
+    ASSERT_EQ(truncated, 1);
+    ASSERT_EQ(udp_read_gro_bf(s, &fixed, &segsize, &nbytes, &truncated), ANET_OK);
+    ASSERT_EQ(nbytes, sizeof(small));
+    ASSERT_EQ(udp_read_gro_bf(s, &fixed, &segsize, &nbytes, &truncated), ANET_EAGAIN);
+
+    // 写满了不读, 报文留在 socket 里
+    fixed.w = fixed.cap;
+    ASSERT_EQ(write(c, small, sizeof(small)), (ssize_t)sizeof(small));
+    ASSERT_EQ(udp_read_gro_bf(s, &fixed, &segsize, &nbytes, &truncated), ANET_EAGAIN);
+    bytebuf_reset(&fixed);
+    ASSERT_EQ(udp_read_gro_bf(s, &fixed, &segsize, &nbytes, &truncated), ANET_OK);
+    ASSERT_EQ(nbytes, sizeof(small));
+
+    // 能扩容的 buf 先扩到 64K, 不会截断
+    ASSERT_EQ(write(c, big, sizeof(big)), (ssize_t)sizeof(big));
+    ASSERT_EQ(udp_read_gro_bf(s, buf, &segsize, &nbytes, &truncated), ANET_OK);
+    ASSERT_EQ(nbytes, sizeof(big));
+    ASSERT_EQ(truncated, 1);
+
+    free_bytebuf(buf);
+    free_udp_batch(b);
+    ez_net_close_socket(c);
+    ez_net_close_socket(s);
+}
+
+int main(int argc, char** argv)
+{
+    EZ_NOTUSED(argc);
+    EZ_NOTUSED(argv);
+    init_default_suite();
+    SUITE_ADD_TEST(udp, batch_echo);
+    SUITE_ADD_TEST(udp, gso_gro);
+    SUITE_ADD_TEST(udp, truncated);
+    run_default_suite();
+    return 0;
+}
@@ -0,0 +1,217 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <ez_bytebuf.h>
+#include <ez_event.h>
+#include <ez_macro.h>
+#include <ez_malloc.h>
+#include <ez_net.h>
+#include <ez_test.h>
+#include <ez_uring.h>
+
+#define URING_PORT 9102
+#define URING_CLIENTS 200
+
+typedef struct echo_state_s {
+    int accepted;
+    int closed;
+    int recv_called;
+} echo_state_t;
+
+static int test_stop(ez_event_loop_t* eventLoop, int64_t timeId, void* data)
+{
+    EZ_NOTUSED(timeId);
+    EZ_NOTUSED(data);
+    ez_stop_event_loop(eventLoop);
+    return AE_TIMER_END;
+}
+
+static void run_loop_for(ez_event_loop_t* loop, int64_t ms)
+{
+    ez_create_time_event(loop, ms, test_stop, NULL);
+    ez_run_event_loop(loop);
+}
+
+static void echo_sent(ez_uring_t* u, int fd, ssize_t res, void* data)
+{
+    bytebuf_t* out = (bytebuf_t*)data;
+    EZ_NOTUSED(u);
+    EZ_NOTUSED(fd);
+    EZ_NOTUSED(res);
+    free_bytebuf(out);
+}
+
+static void echo_recv(ez_uring_t* u, int fd, bytebuf_t* in, int res, void* data)
+{
+    echo_state_t* st = (echo_state_t*)data;
+    bytebuf_t* out;
+
+    if (res <= 0) {
+        st->closed++;
+        ez_net_close_socket(fd);
+        return;
+    }
+    // 共享缓冲在回调返回后收回, 要发送的数据先拷贝出来.
+    out = new_bytebuf(bytebuf_readable_size(in));
+    memcpy(bytebuf_writer_pos(out), bytebuf_reader_pos(in), bytebuf_readable_size(in));
+    out->w += bytebuf_readable_size(in);
+    uring_send(u, fd, &out, 1, echo_sent, out);
+}
+
+static void echo_accept(ez_uring_t* u, int listen_fd, int fd, void* data)
+{
+    echo_state_t* st = (echo_state_t*)data;
+    EZ_NOTUSED(listen_fd);
+
+    if (fd < 0)
+        return;
+    st->accepted++;
+    uring_recv(u, fd, echo_recv, st);
+}
+
+TEST(uring, echo)
+{
+    echo_state_t st = { 0, 0, 0 };
+    int clients[URING_CLIENTS];
+    char msg[32], buf[32];
+    int s, i, n;
+
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    // 缓冲池比连接少得多, 同时到达的数据会把池子用完.
+    ez_uring_t* u = new_uring(loop, 64, 16, 64);
+    ASSERT_EQ(u != NULL, 1);
+
+    s = ez_net_tcp_server(URING_PORT, "127.0.0.1", URING_CLIENTS);
+    ASSERT_EQ(s > 0, 1);
+    ASSERT_EQ(uring_accept(u, s, echo_accept, &st) != NULL, 1);
+
+    for (i = 0; i < URING_CLIENTS; ++i) {
+        clients[i] = ez_net_tcp_connect("127.0.0.1", URING_PORT);
+        ASSERT_EQ(clients[i] > 0, 1);
+        n = snprintf(msg, sizeof(msg), "hello %d", i);
+        ASSERT_EQ(write(clients[i], msg, n), n);
+    }
+    run_loop_for(loop, 200);
+    ASSERT_EQ(st.accepted, URING_CLIENTS);
+
+    for (i = 0; i < URING_CLIENTS; ++i) {
+        n = snprintf(msg, sizeof(msg), "hello %d", i);
+        ASSERT_EQ(read(clients[i], buf, sizeof(buf)), n);
+        ASSERT_EQ(memcmp(buf, msg, n), 0);
+        ez_net_close_socket(clients[i]);
+    }
+    printf("uring echo: %d clients, buffer ring exhausted %lu times\n", URING_CLIENTS,
+        (unsigned long)uring_nobufs(u));
+
+    run_loop_for(loop, 50);
+    ASSERT_EQ(st.closed, URING_CLIENTS);
+
+    free_uring(u);
+    ez_net_close_socket(s);
+    ez_delete_event_loop(loop);
+}
+
+typedef struct send_result_s {
+    ssize_t res;
+    int called;
+} send_result_t;
+
+static void chain_sent(ez_uring_t* u, int fd, ssize_t res, void* data)
+{
+    send_result_t* r = (send_result_t*)data;
+    EZ_NOTUSED(u);
+    EZ_NOTUSED(fd);
+    r->res = res;
+    r->called++;
+}
+
+TEST(uring, send_chain)
+{
+    send_result_t r = { 0, 0 };
+    bytebuf_t* bufs[3];
+    const char* parts[3] = { "first,", "second,", "third" };
+    char buf[64];
+    int sv[2], i;
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_uring_t* u = new_uring(loop, 8, 4, 64);
+    ASSERT_EQ(u != NULL, 1);
+
+    for (i = 0; i < 3; ++i) {
+        bufs[i] = new_bytebuf(16);
+        memcpy(bytebuf_writer_pos(bufs[i]), parts[i], strlen(parts[i]));
+        bufs[i]->w += strlen(parts[i]);
+    }
+    ASSERT_EQ(uring_send(u, sv[0], bufs, 3, chain_sent, &r), ANET_OK);
+    run_loop_for(loop, 20);
+
+    // 一条链只回调一次, 按顺序发出.
+    ASSERT_EQ(r.called, 1);
+    ASSERT_EQ(r.res, 18);
+    for (i = 0; i < 3; ++i) {
+        ASSERT_EQ(bytebuf_readable_size(bufs[i]), 0);
+        free_bytebuf(bufs[i]);
+    }
+    ASSERT_EQ(read(sv[1], buf, sizeof(buf)), 18);
+    ASSERT_EQ(memcmp(buf, "first,second,third", 18), 0);
+
+    free_uring(u);
+    ez_net_close_socket(sv[0]);
+    ez_net_close_socket(sv[1]);
+    ez_delete_event_loop(loop);
+}
+
+static void counting_recv(ez_uring_t* u, int fd, bytebuf_t* in, int res, void* data)
+{
+    echo_state_t* st = (echo_state_t*)data;
+    EZ_NOTUSED(u);
+    EZ_NOTUSED(fd);
+    EZ_NOTUSED(in);
+    EZ_NOTUSED(res);
+    st->recv_called++;
+}
+
+TEST(uring, cancel)
+{
+    echo_state_t st = { 0, 0, 0 };
+    char buf[16];
+    int sv[2];
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_uring_t* u = new_uring(loop, 8, 4, 64);
+    ASSERT_EQ(u != NULL, 1);
+
+    ez_uring_op_t* op = uring_recv(u, sv[0], counting_recv, &st);
+    ASSERT_EQ(write(sv[1], "x", 1), 1);
+    run_loop_for(loop, 20);
+    ASSERT_EQ(st.recv_called, 1);
+
+    // 取消后不再回调, 数据留在 socket 中.
+    ASSERT_EQ(uring_cancel(u, op), ANET_OK);
+    run_loop_for(loop, 20);
+    ASSERT_EQ(write(sv[1], "y", 1), 1);
+    run_loop_for(loop, 20);
+    ASSERT_EQ(st.recv_called, 1);
+    ASSERT_EQ(read(sv[0], buf, sizeof(buf)), 1);
+
+    free_uring(u);
+    ez_net_close_socket(sv[0]);
+    ez_net_close_socket(sv[1]);
+    ez_delete_event_loop(loop);
+}
+
+int main(int argc, char** argv)
+{
+    EZ_NOTUSED(argc);
+    EZ_NOTUSED(argv);
+    init_default_suite();
+    SUITE_ADD_TEST(uring, echo);
+    SUITE_ADD_TEST(uring, send_chain);
+    SUITE_ADD_TEST(uring, cancel);
+    run_default_suite();
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include <errno.h>
+#include <pthread.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <ez_bytebuf.h>
+#include <ez_log.h>
+#include <ez_macro.h>
+#include <ez_net.h>
+#include <ez_util.h>
+#include <ez_zerocopy.h>
+
+//
+// 比较 ez_net_write(拷贝) 与 MSG_ZEROCOPY 在不同块大小下的 CPU 开销.
+// usage: zerocopy_bench [host port]
+//   不带参数时发往本机 sink 线程; loopback 上内核总是回退为拷贝(copied 列),
+//   要看到真实的阈值需指向另一台机器上的丢弃服务, 例如: nc -l 9091 > /dev/null
+//
+#define BENCH_TOTAL (512L * 1024 * 1024)
+#define BENCH_BUFS 64
+
+static void* sink_thread(void* arg)
+{
+    int s = *(int*)arg;
+    char buf[256 * 1024];
+    for (;;) {
+        struct pollfd ps = { .fd = s, .events = POLLIN };
+        poll(&ps, 1, -1);
+        int c = ez_net_tcp_accept(s);
+        if (c < 0)
+            continue;
+        ez_net_set_non_block(c);
+        for (;;) {
+            ssize_t n = read(c, buf, sizeof(buf));
+            if (n == 0 || (n < 0 && errno != EAGAIN))
+                break;
+            if (n < 0) {
+                struct pollfd p = { .fd = c, .events = POLLIN };
+                poll(&p, 1, -1);
+            }
+        }
+        close(c);
+    }
+    return NULL;
+}
+
+typedef struct pool_s {
+    bytebuf_t* free[BENCH_BUFS];
+    int n;
+} pool_t;
+
+static void pool_put(bytebuf_t* buf, void* clientData)
+{
+    pool_t* pool = (pool_t*)clientData;
+    bytebuf_reset_reader_index(buf);
+    pool->free[pool->n++] = buf;
+}
+
+static int64_t cpu_us(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru); // 只统计发送线程
+    return (int64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+static void wait_fd(int fd, short events)
+{
+    struct pollfd p = { .fd = fd, .events = events };
+    poll(&p, 1, 100);
+}
+
+static void bench_copy(const char* host, int port, size_t size)
+{
+    int c = ez_net_tcp_connect(host, port);
+    bytebuf_t* buf = new_bytebuf(size);
+    buf->w = (uint32_t)size;
+    ez_net_set_non_block(c);
+
+    int64_t t0 = ustime(), c0 = cpu_us();
+    long sent = 0;
+    while (sent < BENCH_TOTAL) {
+        ssize_t n = 0;
+        int r = ez_net_write_bf(c, buf, &n);
+        if (r == ANET_ERR)
+            break;
+        if (r == ANET_EAGAIN)
+            wait_fd(c, POLLOUT);
+        sent += n;
+        if (!bytebuf_is_readable(buf))
+            bytebuf_reset_reader_index(buf);
+    }
+    int64_t t1 = ustime(), c1 = cpu_us();
+    printf("%8zu  copy      %8.1f MB/s  %6.2f cpu-ms/MB\n", size, sent / (double)(t1 - t0),
+        (c1 - c0) / 1000.0 / (sent / 1048576.0));
+    close(c);
+    free_bytebuf(buf);
+}
+
+static void bench_zerocopy(const char* host, int port, size_t size)
+{
+    pool_t pool;
+    int c = ez_net_tcp_connect(host, port);
+    ez_net_set_non_block(c);
+    ez_zerocopy_t* zc = new_zerocopy(c, pool_put, &pool);
+    if (zc == NULL) {
+        printf("%8zu  zerocopy  unsupported\n", size);
+        close(c);
+        return;
+    }
+    pool.n = 0;
+    for (int i = 0; i < BENCH_BUFS; ++i) {
+        bytebuf_t* b = new_bytebuf(size);
+        b->w = (uint32_t)size;
+        pool_put(b, &pool);
+    }
+
+    int64_t t0 = ustime(), c0 = cpu_us();
+    long sent = 0;
+    bytebuf_t* cur = NULL;
+    while (sent < BENCH_TOTAL) {
+        if (cur == NULL) {
+            if (pool.n == 0) {
+                // 所有 buf 都还在内核中, 等待完成通知.
+                if (zerocopy_reap(zc) == 0)
+                    wait_fd(c, 0);
+                continue;
+            }
+            cur = pool.free[--pool.n];
+        }
+        ssize_t n = 0;
+        int r = zerocopy_write_bf(zc, cur, &n);
+        if (r == ANET_ERR)
+            break;
+        if (r == ANET_EAGAIN) {
+            zerocopy_reap(zc);
+            wait_fd(c, POLLOUT);
+        }
+        sent += n;
+        if (!bytebuf_is_readable(cur))
+            cur = NULL;
+    }
+    while (zerocopy_pending(zc) > 0) {
+        if (zerocopy_reap(zc) == 0)
+            wait_fd(c, 0);
+    }
+    int64_t t1 = ustime(), c1 = cpu_us();
+    printf("%8zu  zerocopy  %8.1f MB/s  %6.2f cpu-ms/MB  copied:%lu\n", size, sent / (double)(t1 - t0),
+        (c1 - c0) / 1000.0 / (sent / 1048576.0), zerocopy_copied(zc));
+
+    close(c);
+    free_zerocopy(zc);
+    while (pool.n > 0)
+        free_bytebuf(pool.free[--pool.n]);
+}
+
+int main(int argc, char** argv)
+{
+    const char* host = "127.0.0.1";
+    int port = 9091;
+    pthread_t tid;
+    size_t sizes[] = { 4096, 16384, 65536, 262144, 1048576 };
+
+    log_init(LOG_WARN, NULL);
+    if (argc > 2) {
+        host = argv[1];
+        port = atoi(argv[2]);
+    } else {
+        static int s;
+        s = ez_net_tcp_server(port, (char*)host, 128);
+        if (s < 0)
+            return 1;
+        pthread_create(&tid, NULL, sink_thread, &s);
+    }
+
+    printf("    size  mode         throughput      cpu\n");
+    for (size_t i = 0; i < EZ_NELEMS(sizes); ++i) {
+        bench_copy(host, port, sizes[i]);
+        bench_zerocopy(host, port, sizes[i]);
+    }
+    log_release();
+    return 0;
+}
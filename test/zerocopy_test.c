@@ -0,0 +1,155 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <ez_bytebuf.h>
+#include <ez_conn.h>
+#include <ez_event.h>
+#include <ez_macro.h>
+#include <ez_net.h>
+#include <ez_test.h>
+#include <ez_zerocopy.h>
+
+#define ZC_BUF_SIZE (64 * 1024)
+#define ZC_BUFS 8
+
+typedef struct zc_state_s {
+    int released;
+    int reaped; /* error_proc 回调次数 */
+    int peer;
+    size_t got;
+    ez_zerocopy_t* zc;
+} zc_state_t;
+
+static void zc_release(bytebuf_t* buf, void* clientData)
+{
+    zc_state_t* st = (zc_state_t*)clientData;
+    st->released++;
+    free_bytebuf(buf);
+}
+
+static void zc_read(ez_conn_t* conn, bytebuf_t* in, void* data)
+{
+    EZ_NOTUSED(conn);
+    EZ_NOTUSED(data);
+    in->r = in->w;
+}
+
+static void zc_close(ez_conn_t* conn, int reason, void* data)
+{
+    EZ_NOTUSED(conn);
+    EZ_NOTUSED(reason);
+    EZ_NOTUSED(data);
+}
+
+/* 错误队列有完成通知 */
+static void zc_error(ez_conn_t* conn, void* data)
+{
+    zc_state_t* st = (zc_state_t*)data;
+    EZ_NOTUSED(conn);
+    st->reaped++;
+    zerocopy_reap(st->zc);
+}
+
+/* 对端读走数据, 全部确认后停止 */
+static int zc_tick(ez_event_loop_t* eventLoop, int64_t timeId, void* clientData)
+{
+    zc_state_t* st = (zc_state_t*)clientData;
+    char buf[64 * 1024];
+    ssize_t n;
+    EZ_NOTUSED(timeId);
+
+    while ((n = read(st->peer, buf, sizeof(buf))) > 0)
+        st->got += (size_t)n;
+    if (st->released == ZC_BUFS && st->got == ZC_BUF_SIZE * ZC_BUFS)
+        ez_stop_event_loop(eventLoop);
+    return AE_TIMER_NEXT;
+}
+
+static int zc_timeout(ez_event_loop_t* eventLoop, int64_t timeId, void* clientData)
+{
+    EZ_NOTUSED(timeId);
+    EZ_NOTUSED(clientData);
+    ez_stop_event_loop(eventLoop);
+    return AE_TIMER_END;
+}
+
+TEST(zerocopy, error_reap)
+{
+    zc_state_t st = { 0, 0, -1, 0, NULL };
+    ez_event_loop_t* loop = ez_create_event_loop(64);
+    ez_conn_group_t* g = new_conn_group(loop, 1024);
+    ez_conn_t* conn;
+    ez_zerocopy_t* zc;
+    bytebuf_t* buf;
+    int64_t tick, timeout;
+    ssize_t n = 0;
+    int s, c, i, r;
+
+    s = ez_net_tcp_server(9101, "127.0.0.1", 16);
+    ASSERT_EQ(s >= 0, 1);
+    c = ez_net_tcp_connect("127.0.0.1", 9101);
+    ASSERT_EQ(c >= 0, 1);
+    st.peer = ez_net_tcp_accept(s);
+    ASSERT_EQ(st.peer >= 0, 1);
+    ez_net_set_non_block(c);
+    ez_net_set_non_block(st.peer);
+
+    zc = new_zerocopy(c, zc_release, &st);
+    if (zc == NULL) {
+        // 内核不支持 SO_ZEROCOPY
+        ez_net_close_socket(c);
+        ez_net_close_socket(st.peer);
+        ez_net_close_socket(s);
+        free_conn_group(g);
+        ez_delete_event_loop(loop);
+        return;
+    }
+    st.zc = zc;
+    conn = new_conn(g, c, zc_read, zc_close, &st);
+    ASSERT_EQ(conn != NULL, 1);
+    conn_set_error_proc(conn, zc_error);
+
+    // 发送时不手动 zerocopy_reap, 完成通知到达时 EPOLLERR 传给连接的 error_proc
+    for (i = 0; i < ZC_BUFS; ++i) {
+        buf = new_bytebuf(ZC_BUF_SIZE);
+        memset(buf->data, 'a' + i, ZC_BUF_SIZE);
+        buf->w = ZC_BUF_SIZE;
+        while (bytebuf_is_readable(buf)) {
+            r = zerocopy_write_bf(zc, buf, &n);
+            ASSERT_EQ(r == ANET_ERR, 0);
+            if (r == ANET_ERR)
+                break;
+            if (r == ANET_EAGAIN)
+                zc_tick(loop, 0, &st);
+        }
+    }
+    ASSERT_EQ(zerocopy_pending(zc) > 0 || st.released == ZC_BUFS, 1);
+
+    tick = ez_create_time_event(loop, 1, zc_tick, &st);
+    timeout = ez_create_time_event(loop, 2000, zc_timeout, NULL);
+    ez_run_event_loop(loop);
+    ez_delete_time_event(loop, tick);
+    ez_delete_time_event(loop, timeout);
+
+    ASSERT_EQ(st.got, ZC_BUF_SIZE * ZC_BUFS);
+    ASSERT_EQ(st.released, ZC_BUFS);
+    ASSERT_EQ(st.reaped > 0, 1);
+    ASSERT_EQ(zerocopy_pending(zc), 0);
+
+    free_conn_group(g); // 关闭 c
+    free_zerocopy(zc);
+    ez_net_close_socket(st.peer);
+    ez_net_close_socket(s);
+    ez_delete_event_loop(loop);
+}
+
+int main(int argc, char** argv)
+{
+    EZ_NOTUSED(argc);
+    EZ_NOTUSED(argv);
+    init_default_suite();
+    SUITE_ADD_TEST(zerocopy, error_reap);
+    run_default_suite();
+    return 0;
+}